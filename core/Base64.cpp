@@ -0,0 +1,239 @@
+/*
+* Base64 decoder
+*
+* Decodes base64 text (e.g. glTF data URIs) with SSSE3 or AVX2 when the CPU supports it and a scalar fallback otherwise
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "Base64.h"
+
+#include <assert.h>
+
+#include "CpuFeatures.h"
+
+namespace vks
+{
+	namespace base64
+	{
+		namespace
+		{
+			const uint8_t invalid = 0xFF;
+
+			struct DecodeTable
+			{
+				uint8_t values[256];
+				DecodeTable()
+				{
+					const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+					for (uint32_t i = 0; i < 256; i++) {
+						values[i] = invalid;
+					}
+					for (uint8_t i = 0; i < 64; i++) {
+						values[static_cast<uint8_t>(alphabet[i])] = i;
+					}
+				}
+			};
+			const DecodeTable decodeTable;
+
+			size_t stripPadding(const char *src, size_t length)
+			{
+				for (uint32_t i = 0; (i < 2) && (length > 0) && (src[length - 1] == '='); i++) {
+					length--;
+				}
+				return length;
+			}
+
+			/** @brief Decodes unpadded text, a trailing group of two or three characters yields one or two bytes */
+			bool decodeScalar(const char *src, size_t length, uint8_t *dst)
+			{
+				const uint8_t *values = decodeTable.values;
+				const uint8_t *in = reinterpret_cast<const uint8_t*>(src);
+				size_t i = 0;
+				for (; i + 4 <= length; i += 4) {
+					const uint8_t a = values[in[i]], b = values[in[i + 1]], c = values[in[i + 2]], d = values[in[i + 3]];
+					if ((a | b | c | d) == invalid) {
+						return false;
+					}
+					const uint32_t bits = (a << 18) | (b << 12) | (c << 6) | d;
+					*dst++ = static_cast<uint8_t>(bits >> 16);
+					*dst++ = static_cast<uint8_t>(bits >> 8);
+					*dst++ = static_cast<uint8_t>(bits);
+				}
+				const size_t remaining = length - i;
+				if (remaining == 1) {
+					return false;
+				}
+				if (remaining > 1) {
+					const uint8_t a = values[in[i]], b = values[in[i + 1]], c = (remaining == 3) ? values[in[i + 2]] : 0;
+					if ((a | b | c) == invalid) {
+						return false;
+					}
+					const uint32_t bits = (a << 18) | (b << 12) | (c << 6);
+					*dst++ = static_cast<uint8_t>(bits >> 16);
+					if (remaining == 3) {
+						*dst++ = static_cast<uint8_t>(bits >> 8);
+					}
+				}
+				return true;
+			}
+
+#if defined(VKS_CPU_X86)
+			/*
+				Both vector paths map characters to 6 bit values with nibble lookups: the low and high nibble of every character select
+				class bits that only overlap for characters outside of the alphabet, and the high nibble (plus one for '/') selects the
+				offset added to the character. Four 6 bit values are then merged into three bytes with two multiply-adds and a shuffle.
+				A block containing padding or an invalid character stops the vector loop and is left to the scalar path.
+			*/
+
+			/** @brief Decodes 16 character blocks as long as the output has room for a 16 byte store, returns the number of characters consumed */
+			VKS_TARGET_SSSE3 size_t decodeSSSE3(const char *src, size_t length, uint8_t *dst)
+			{
+				const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+				const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+				const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+				const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+				const __m128i slash = _mm_set1_epi8(0x2F);
+				const __m128i mergeBytes = _mm_set1_epi32(0x01400140);
+				const __m128i mergeWords = _mm_set1_epi32(0x00011000);
+				const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+				size_t consumed = 0;
+				// Padding has been stripped, so 24 remaining characters decode to 18 bytes
+				while (length - consumed >= 24) {
+					const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + consumed));
+					const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), nibbleMask);
+					const __m128i loNibbles = _mm_and_si128(in, nibbleMask);
+					const __m128i classes = _mm_and_si128(_mm_shuffle_epi8(lutLo, loNibbles), _mm_shuffle_epi8(lutHi, hiNibbles));
+					if (_mm_movemask_epi8(_mm_cmpgt_epi8(classes, _mm_setzero_si128())) != 0) {
+						break;
+					}
+					const __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(in, slash), hiNibbles));
+					const __m128i values = _mm_add_epi8(in, roll);
+					const __m128i merged = _mm_madd_epi16(_mm_maddubs_epi16(values, mergeBytes), mergeWords);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_shuffle_epi8(merged, pack));
+					consumed += 16;
+					dst += 12;
+				}
+				return consumed;
+			}
+
+			/** @brief Decodes 32 character blocks as long as the output has room for a 32 byte store, returns the number of characters consumed */
+			VKS_TARGET_AVX2 size_t decodeAVX2(const char *src, size_t length, uint8_t *dst)
+			{
+				// Byte shuffles work per 128 bit lane, so the lookup tables are duplicated
+				const __m256i lutLo = _mm256_setr_epi8(
+					0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+					0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+				const __m256i lutHi = _mm256_setr_epi8(
+					0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+					0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+				const __m256i lutRoll = _mm256_setr_epi8(
+					0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+					0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+				const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+				const __m256i slash = _mm256_set1_epi8(0x2F);
+				const __m256i mergeBytes = _mm256_set1_epi32(0x01400140);
+				const __m256i mergeWords = _mm256_set1_epi32(0x00011000);
+				const __m256i pack = _mm256_setr_epi8(
+					2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+					2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+				// Moves the 12 bytes of the upper lane next to the 12 bytes of the lower one
+				const __m256i packLanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+				size_t consumed = 0;
+				// Padding has been stripped, so 48 remaining characters decode to 36 bytes
+				while (length - consumed >= 48) {
+					const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + consumed));
+					const __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), nibbleMask);
+					const __m256i loNibbles = _mm256_and_si256(in, nibbleMask);
+					const __m256i classes = _mm256_and_si256(_mm256_shuffle_epi8(lutLo, loNibbles), _mm256_shuffle_epi8(lutHi, hiNibbles));
+					if (_mm256_movemask_epi8(_mm256_cmpgt_epi8(classes, _mm256_setzero_si256())) != 0) {
+						break;
+					}
+					const __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(_mm256_cmpeq_epi8(in, slash), hiNibbles));
+					const __m256i values = _mm256_add_epi8(in, roll);
+					const __m256i merged = _mm256_madd_epi16(_mm256_maddubs_epi16(values, mergeBytes), mergeWords);
+					const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(merged, pack), packLanes);
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), packed);
+					consumed += 32;
+					dst += 24;
+				}
+				return consumed;
+			}
+#endif
+		}
+
+		Implementation getBestImplementation()
+		{
+#if defined(VKS_CPU_X86)
+			if (getCpuFeatures().avx2) {
+				return Implementation::AVX2;
+			}
+			if (getCpuFeatures().ssse3) {
+				return Implementation::SSSE3;
+			}
+#endif
+			return Implementation::Scalar;
+		}
+
+		bool isSupported(Implementation implementation)
+		{
+			switch (implementation) {
+#if defined(VKS_CPU_X86)
+			case Implementation::SSSE3:
+				return getCpuFeatures().ssse3;
+			case Implementation::AVX2:
+				return getCpuFeatures().avx2;
+#endif
+			case Implementation::Scalar:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		const char* getImplementationName(Implementation implementation)
+		{
+			switch (implementation) {
+			case Implementation::Scalar:
+				return "scalar";
+			case Implementation::SSSE3:
+				return "SSSE3";
+			case Implementation::AVX2:
+				return "AVX2";
+			default:
+				return "unknown";
+			}
+		}
+
+		size_t getDecodedSize(const char *src, size_t length)
+		{
+			length = stripPadding(src, length);
+			return (length / 4) * 3 + ((length % 4) > 1 ? (length % 4) - 1 : 0);
+		}
+
+		bool decode(const char *src, size_t length, uint8_t *dst)
+		{
+			static const Implementation implementation = getBestImplementation();
+			return decode(src, length, dst, implementation);
+		}
+
+		bool decode(const char *src, size_t length, uint8_t *dst, Implementation implementation)
+		{
+			assert(isSupported(implementation));
+			length = stripPadding(src, length);
+			size_t consumed = 0;
+#if defined(VKS_CPU_X86)
+			if (implementation == Implementation::AVX2) {
+				consumed = decodeAVX2(src, length, dst);
+			}
+			if (implementation != Implementation::Scalar) {
+				// The 16 character loop also picks up what remains after the 32 character one
+				consumed += decodeSSSE3(src + consumed, length - consumed, dst + consumed / 4 * 3);
+			}
+#endif
+			return decodeScalar(src + consumed, length - consumed, dst + consumed / 4 * 3);
+		}
+	}
+}
@@ -0,0 +1,43 @@
+/*
+* Base64 decoder
+*
+* Decodes base64 text (e.g. glTF data URIs) with SSSE3 or AVX2 when the CPU supports it and a scalar fallback otherwise
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vks
+{
+	namespace base64
+	{
+		enum class Implementation
+		{
+			Scalar,
+			/** @brief 16 characters per iteration, available on all CPUs supporting SSE4 */
+			SSSE3,
+			/** @brief 32 characters per iteration */
+			AVX2
+		};
+
+		/** @brief Fastest implementation supported by the CPU */
+		Implementation getBestImplementation();
+		bool isSupported(Implementation implementation);
+		const char* getImplementationName(Implementation implementation);
+
+		/** @brief Number of bytes encoded by base64 text, the text itself isn't validated */
+		size_t getDecodedSize(const char *src, size_t length);
+		/**
+		* @brief Decodes base64 text with optional padding, whitespace and other characters are rejected
+		* @param dst Receives getDecodedSize(src, length) bytes
+		* @return False if the text isn't valid base64
+		*/
+		bool decode(const char *src, size_t length, uint8_t *dst);
+		/** @brief Decodes with the given implementation, which has to be supported by the CPU */
+		bool decode(const char *src, size_t length, uint8_t *dst, Implementation implementation);
+	}
+}
@@ -0,0 +1,50 @@
+/*
+* CPU feature detection
+*
+* Instruction set extensions that vector code paths are selected by at runtime
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "CpuFeatures.h"
+
+#if defined(VKS_CPU_X86) && defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		CpuFeatures detectCpuFeatures()
+		{
+			CpuFeatures features;
+#if defined(VKS_CPU_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+			int info[4];
+			__cpuid(info, 0);
+			const int maxLeaf = info[0];
+			__cpuid(info, 1);
+			features.ssse3 = (info[2] & (1 << 9)) != 0;
+			// AVX registers also have to be saved by the OS
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			if (osxsave && (maxLeaf >= 7) && ((_xgetbv(0) & 0x6) == 0x6)) {
+				__cpuidex(info, 7, 0);
+				features.avx2 = (info[1] & (1 << 5)) != 0;
+			}
+#else
+			__builtin_cpu_init();
+			features.ssse3 = __builtin_cpu_supports("ssse3") != 0;
+			features.avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+#endif
+			return features;
+		}
+	}
+
+	const CpuFeatures &getCpuFeatures()
+	{
+		static const CpuFeatures features = detectCpuFeatures();
+		return features;
+	}
+}
@@ -0,0 +1,34 @@
+/*
+* CPU feature detection
+*
+* Instruction set extensions that vector code paths are selected by at runtime
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+// Vector paths are compiled with per function target attributes and selected at runtime, so the build doesn't need any -m flags
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VKS_CPU_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define VKS_TARGET_SSSE3
+#define VKS_TARGET_AVX2
+#else
+#define VKS_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define VKS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace vks
+{
+	struct CpuFeatures
+	{
+		bool ssse3 = false;
+		bool avx2 = false;
+	};
+
+	/** @brief Features of the CPU the application runs on, all false on other architectures than x86 */
+	const CpuFeatures &getCpuFeatures();
+}
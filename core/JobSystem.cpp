@@ -0,0 +1,319 @@
+/*
+* Job system
+*
+* Work stealing thread pool with job dependencies and parallel-for, shared by the renderer and the asset loaders
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	namespace
+	{
+		// Job system the calling thread is a worker of (nullptr for threads outside any pool)
+		thread_local JobSystem *currentJobSystem = nullptr;
+		thread_local uint32_t currentThreadIndex = 0;
+		// Job executed by the calling thread, jobs it schedules join its group
+		thread_local Job *currentJob = nullptr;
+
+		uint32_t resolveWorkerCount(uint32_t workerCount)
+		{
+			if (workerCount == 0) {
+				uint32_t hardwareThreads = std::thread::hardware_concurrency();
+				workerCount = (hardwareThreads > 1) ? hardwareThreads - 1 : 1;
+			}
+			return workerCount;
+		}
+
+		/** @brief Removes the newest (or oldest) job of the given group (0 = any group) from a queue whose mutex is held */
+		JobHandle takeJob(std::deque<JobHandle> &jobs, uint64_t group, bool newest)
+		{
+			if (jobs.empty()) {
+				return nullptr;
+			}
+			if (group == 0) {
+				JobHandle job = newest ? jobs.back() : jobs.front();
+				newest ? jobs.pop_back() : jobs.pop_front();
+				return job;
+			}
+			const size_t count = jobs.size();
+			for (size_t i = 0; i < count; i++) {
+				const size_t index = newest ? count - 1 - i : i;
+				if (jobs[index]->group == group) {
+					JobHandle job = jobs[index];
+					jobs.erase(jobs.begin() + index);
+					return job;
+				}
+			}
+			return nullptr;
+		}
+	}
+
+	JobSystem::JobSystem(uint32_t workerCount) : queuedJobs(0), queueGeneration(0), nextGroup(1), stopping(false)
+	{
+		start(resolveWorkerCount(workerCount));
+	}
+
+	JobSystem::~JobSystem()
+	{
+		stop();
+	}
+
+	JobSystem& JobSystem::instance()
+	{
+		static JobSystem jobSystem;
+		return jobSystem;
+	}
+
+	void JobSystem::start(uint32_t workerCount)
+	{
+		stopping = false;
+		queues.clear();
+		for (uint32_t i = 0; i <= workerCount; i++) {
+			queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+		}
+		for (uint32_t i = 1; i <= workerCount; i++) {
+			workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+		}
+	}
+
+	void JobSystem::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(conditionMutex);
+			stopping = true;
+		}
+		condition.notify_all();
+		for (auto &worker : workers) {
+			worker.join();
+		}
+		workers.clear();
+	}
+
+	void JobSystem::setWorkerCount(uint32_t workerCount)
+	{
+		workerCount = resolveWorkerCount(workerCount);
+		if (workerCount == getWorkerCount()) {
+			return;
+		}
+		stop();
+		start(workerCount);
+	}
+
+	uint32_t JobSystem::getWorkerCount() const
+	{
+		return static_cast<uint32_t>(workers.size());
+	}
+
+	uint32_t JobSystem::threadIndex()
+	{
+		return currentThreadIndex;
+	}
+
+	void JobSystem::notify()
+	{
+		// Taking the lock ensures that a thread checking its wait predicate can't miss the notification
+		{
+			std::lock_guard<std::mutex> lock(conditionMutex);
+		}
+		condition.notify_all();
+	}
+
+	void JobSystem::enqueue(const JobHandle &job)
+	{
+		// Workers push onto their own queue to keep related jobs local, all other threads use the shared queue
+		JobQueue &queue = (currentJobSystem == this) ? *queues[currentThreadIndex] : *queues[0];
+		{
+			// Counted before it becomes visible, so a thread taking it right away can't decrement the counter below zero
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queuedJobs++;
+			queue.jobs.push_back(job);
+		}
+		queueGeneration++;
+		notify();
+	}
+
+	JobHandle JobSystem::fetch(uint64_t group)
+	{
+		const uint32_t ownIndex = (currentJobSystem == this) ? currentThreadIndex : 0;
+		const uint32_t queueCount = static_cast<uint32_t>(queues.size());
+		// Most recently queued job from the own queue first (LIFO for cache locality), then steal the oldest jobs from other queues
+		if (ownIndex > 0) {
+			JobQueue &queue = *queues[ownIndex];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			JobHandle job = takeJob(queue.jobs, group, true);
+			if (job) {
+				queuedJobs--;
+				return job;
+			}
+		}
+		for (uint32_t i = 0; i < queueCount; i++) {
+			const uint32_t index = (ownIndex + i) % queueCount;
+			if ((index == ownIndex) && (ownIndex > 0)) {
+				continue;
+			}
+			JobQueue &queue = *queues[index];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			JobHandle job = takeJob(queue.jobs, group, false);
+			if (job) {
+				queuedJobs--;
+				return job;
+			}
+		}
+		return nullptr;
+	}
+
+	uint64_t JobSystem::currentGroup()
+	{
+		return currentJob ? currentJob->group : nextGroup++;
+	}
+
+	void JobSystem::execute(const JobHandle &job)
+	{
+		// A job whose dependency failed is skipped and inherits the exception
+		if (!job->exception) {
+			Job *previousJob = currentJob;
+			currentJob = job.get();
+			try {
+				job->function();
+			}
+			catch (...) {
+				job->exception = std::current_exception();
+			}
+			currentJob = previousJob;
+		}
+		// Release captured resources as early as possible
+		job->function = nullptr;
+
+		std::vector<JobHandle> dependents;
+		{
+			std::lock_guard<std::mutex> lock(job->mutex);
+			job->finished = true;
+			dependents.swap(job->dependents);
+		}
+		for (auto &dependent : dependents) {
+			if (job->exception) {
+				std::lock_guard<std::mutex> lock(dependent->mutex);
+				if (!dependent->exception) {
+					dependent->exception = job->exception;
+				}
+			}
+			if (--dependent->pendingDependencies == 0) {
+				enqueue(dependent);
+			}
+		}
+		notify();
+	}
+
+	void JobSystem::workerLoop(uint32_t index)
+	{
+		currentJobSystem = this;
+		currentThreadIndex = index;
+		while (true) {
+			JobHandle job = fetch(0);
+			if (job) {
+				execute(job);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(conditionMutex);
+			condition.wait(lock, [this] { return stopping || (queuedJobs > 0); });
+			if (stopping) {
+				break;
+			}
+		}
+		currentJobSystem = nullptr;
+		currentThreadIndex = 0;
+	}
+
+	JobHandle JobSystem::schedule(std::function<void()> function, const std::vector<JobHandle> &dependencies)
+	{
+		return schedule(std::move(function), dependencies, currentGroup());
+	}
+
+	JobHandle JobSystem::schedule(std::function<void()> function, const std::vector<JobHandle> &dependencies, uint64_t group)
+	{
+		JobHandle job = std::make_shared<Job>();
+		job->function = std::move(function);
+		job->group = group;
+		// Guard reference, so the job can't be queued while dependencies are still being registered
+		job->pendingDependencies = 1;
+		for (auto &dependency : dependencies) {
+			if (!dependency) {
+				continue;
+			}
+			std::lock_guard<std::mutex> lock(dependency->mutex);
+			if (!dependency->finished) {
+				job->pendingDependencies++;
+				dependency->dependents.push_back(job);
+			}
+			else if (dependency->exception && !job->exception) {
+				job->exception = dependency->exception;
+			}
+		}
+		if (--job->pendingDependencies == 0) {
+			enqueue(job);
+		}
+		return job;
+	}
+
+	JobHandle JobSystem::parallelFor(uint32_t count, uint32_t grainSize, std::function<void(uint32_t first, uint32_t last)> function, const std::vector<JobHandle> &dependencies)
+	{
+		if (grainSize == 0) {
+			// Aim for a few chunks per thread so that stealing can balance uneven workloads
+			grainSize = std::max(count / ((getWorkerCount() + 1) * 4), 1u);
+		}
+		// The chunks and the final job form one tree, so waiting for the returned job helps with the chunks
+		const uint64_t group = currentGroup();
+		std::vector<JobHandle> chunks;
+		chunks.reserve((count + grainSize - 1) / grainSize);
+		std::shared_ptr<std::function<void(uint32_t, uint32_t)>> sharedFunction = std::make_shared<std::function<void(uint32_t, uint32_t)>>(std::move(function));
+		for (uint32_t first = 0; first < count; first += grainSize) {
+			const uint32_t last = std::min(first + grainSize, count);
+			chunks.push_back(schedule([sharedFunction, first, last] { (*sharedFunction)(first, last); }, dependencies, group));
+		}
+		if (chunks.empty()) {
+			return schedule([] {}, dependencies, group);
+		}
+		if (chunks.size() == 1) {
+			return chunks[0];
+		}
+		return schedule([] {}, chunks, group);
+	}
+
+	void JobSystem::wait(const JobHandle &job)
+	{
+		if (!job) {
+			return;
+		}
+		// Help with the awaited job's tree instead of blocking, workers also run other jobs so that waits inside jobs can't deadlock the pool
+		const bool worker = (currentJobSystem == this);
+		while (!job->finished) {
+			const uint64_t generation = queueGeneration;
+			JobHandle other = fetch(job->group);
+			if (!other && worker) {
+				other = fetch(0);
+			}
+			if (other) {
+				execute(other);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(conditionMutex);
+			condition.wait(lock, [this, &job, generation] { return job->finished || (queueGeneration != generation); });
+		}
+		std::lock_guard<std::mutex> lock(job->mutex);
+		if (job->exception) {
+			std::rethrow_exception(job->exception);
+		}
+	}
+
+	void JobSystem::wait(const std::vector<JobHandle> &jobs)
+	{
+		for (auto &job : jobs) {
+			wait(job);
+		}
+	}
+}
@@ -0,0 +1,105 @@
+/*
+* Job system
+*
+* Work stealing thread pool with job dependencies and parallel-for, shared by the renderer and the asset loaders
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vks
+{
+	/** @brief Internal state of a scheduled job */
+	struct Job
+	{
+		std::function<void()> function;
+		/** @brief Number of unfinished dependencies, the job is queued once this drops to zero */
+		std::atomic<uint32_t> pendingDependencies;
+		std::atomic<bool> finished;
+		/** @brief Job tree the job belongs to, jobs scheduled while a job runs and the chunks of a parallelFor share the group of their root */
+		uint64_t group = 0;
+		/** @brief Guards dependents and exception */
+		std::mutex mutex;
+		/** @brief Jobs waiting for this job to finish */
+		std::vector<std::shared_ptr<Job>> dependents;
+		/** @brief Exception thrown by the job (or one of its dependencies), rethrown by JobSystem::wait */
+		std::exception_ptr exception;
+		Job() : pendingDependencies(0), finished(false) {}
+	};
+
+	/** @brief Reference to a scheduled job that can be waited on or passed as a dependency */
+	typedef std::shared_ptr<Job> JobHandle;
+
+	class JobSystem
+	{
+	private:
+		/** @brief Queue of runnable jobs, the owning worker pops from the back while other threads steal from the front */
+		struct JobQueue
+		{
+			std::mutex mutex;
+			std::deque<JobHandle> jobs;
+		};
+		/** @brief Queue 0 receives jobs from threads outside the pool, queue n belongs to worker n */
+		std::vector<std::unique_ptr<JobQueue>> queues;
+		std::vector<std::thread> workers;
+		/** @brief Number of queued jobs, incremented before a job is queued so that it never drops below the actual count */
+		std::atomic<uint32_t> queuedJobs;
+		/** @brief Incremented after each enqueue, lets waiting threads detect new jobs of their group without spinning on unrelated ones */
+		std::atomic<uint64_t> queueGeneration;
+		std::atomic<uint64_t> nextGroup;
+		std::atomic<bool> stopping;
+		/** @brief Signaled when a job has been queued or has finished */
+		std::mutex conditionMutex;
+		std::condition_variable condition;
+
+		void start(uint32_t workerCount);
+		void stop();
+		void workerLoop(uint32_t index);
+		void enqueue(const JobHandle &job);
+		/** @brief Takes a queued job of the given group (0 = any group) */
+		JobHandle fetch(uint64_t group);
+		/** @brief Group of the job running on the calling thread, or a new group outside of jobs */
+		uint64_t currentGroup();
+		JobHandle schedule(std::function<void()> function, const std::vector<JobHandle> &dependencies, uint64_t group);
+		void execute(const JobHandle &job);
+		void notify();
+	public:
+		/** @brief Creates a job system with the given number of worker threads (0 = one per hardware thread, minus the calling thread) */
+		explicit JobSystem(uint32_t workerCount = 0);
+		~JobSystem();
+
+		/** @brief Shared job system used by the base library and the examples */
+		static JobSystem& instance();
+
+		/** @brief Restarts the pool with a different number of worker threads (0 = automatic), must only be called while no jobs are pending */
+		void setWorkerCount(uint32_t workerCount);
+		uint32_t getWorkerCount() const;
+		/** @brief Index of the calling thread: 0 for threads outside the pool, 1 .. getWorkerCount() for worker threads */
+		static uint32_t threadIndex();
+
+		/** @brief Schedules a function that is executed once all dependencies have finished */
+		JobHandle schedule(std::function<void()> function, const std::vector<JobHandle> &dependencies = std::vector<JobHandle>());
+		/** @brief Splits the range [0, count) into chunks of grainSize elements (0 = automatic) that are processed in parallel, the returned job finishes with the last chunk */
+		JobHandle parallelFor(uint32_t count, uint32_t grainSize, std::function<void(uint32_t first, uint32_t last)> function, const std::vector<JobHandle> &dependencies = std::vector<JobHandle>());
+		/**
+		* @brief Waits for a job to finish and rethrows its exception (if any)
+		*
+		* The calling thread executes queued jobs of the awaited job's tree in the meantime, so a wait never picks up unrelated (and possibly
+		* long running) work. Worker threads fall back to other jobs once the tree has nothing left to run, which keeps waits inside jobs from
+		* deadlocking the pool.
+		*/
+		void wait(const JobHandle &job);
+		void wait(const std::vector<JobHandle> &jobs);
+	};
+}
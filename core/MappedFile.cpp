@@ -0,0 +1,128 @@
+/*
+* Memory mapped file
+*
+* Read-only view of a file's contents without copying it into process memory first
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "MappedFile.h"
+
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vks
+{
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile::MappedFile(MappedFile &&other)
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile &&other)
+	{
+		if (this != &other) {
+			close();
+			std::swap(mapped, other.mapped);
+			std::swap(mappedSize, other.mappedSize);
+			std::swap(opened, other.opened);
+#if defined(_WIN32)
+			std::swap(fileHandle, other.fileHandle);
+			std::swap(mappingHandle, other.mappingHandle);
+#endif
+		}
+		return *this;
+	}
+
+	bool MappedFile::open(const std::string &fileName)
+	{
+		close();
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			CloseHandle(file);
+			return false;
+		}
+		fileHandle = file;
+		opened = true;
+		mappedSize = static_cast<size_t>(fileSize.QuadPart);
+		// Empty files can't be mapped
+		if (mappedSize == 0) {
+			return true;
+		}
+		mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle) {
+			mapped = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		}
+		if (!mapped) {
+			close();
+			return false;
+		}
+#else
+		int fd = ::open(fileName.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat info;
+		if ((fstat(fd, &info) != 0) || !S_ISREG(info.st_mode)) {
+			::close(fd);
+			return false;
+		}
+		opened = true;
+		mappedSize = static_cast<size_t>(info.st_size);
+		if (mappedSize > 0) {
+			void *address = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (address == MAP_FAILED) {
+				::close(fd);
+				opened = false;
+				mappedSize = 0;
+				return false;
+			}
+			mapped = static_cast<const uint8_t*>(address);
+		}
+		// The mapping stays valid after the descriptor has been closed
+		::close(fd);
+#endif
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+#if defined(_WIN32)
+		if (mapped) {
+			UnmapViewOfFile(mapped);
+		}
+		if (mappingHandle) {
+			CloseHandle(mappingHandle);
+		}
+		if (fileHandle) {
+			CloseHandle(fileHandle);
+		}
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+#else
+		if (mapped) {
+			munmap(const_cast<uint8_t*>(mapped), mappedSize);
+		}
+#endif
+		mapped = nullptr;
+		mappedSize = 0;
+		opened = false;
+	}
+}
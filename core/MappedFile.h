@@ -0,0 +1,43 @@
+/*
+* Memory mapped file
+*
+* Read-only view of a file's contents without copying it into process memory first
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace vks
+{
+	class MappedFile
+	{
+	private:
+		const uint8_t *mapped = nullptr;
+		size_t mappedSize = 0;
+		bool opened = false;
+#if defined(_WIN32)
+		void *fileHandle = nullptr;
+		void *mappingHandle = nullptr;
+#endif
+	public:
+		MappedFile() = default;
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile &&other);
+		MappedFile& operator=(MappedFile &&other);
+
+		/** @brief Maps the whole file read-only, returns false if it can't be opened */
+		bool open(const std::string &fileName);
+		/** @brief Unmaps the file, pointers returned by data() become invalid */
+		void close();
+		bool isOpen() const { return opened; }
+		const uint8_t* data() const { return mapped; }
+		size_t size() const { return mappedSize; }
+	};
+}
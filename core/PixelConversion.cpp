@@ -0,0 +1,90 @@
+/*
+* Pixel conversion
+*
+* Converts 8 bit pixel data between channel layouts with SSSE3 or AVX2 when the CPU supports it and a scalar fallback otherwise
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "PixelConversion.h"
+
+#include "CpuFeatures.h"
+
+namespace vks
+{
+	namespace pixels
+	{
+		namespace
+		{
+			void expandRGBToRGBAScalar(const uint8_t *rgb, uint8_t *rgba, size_t pixelCount)
+			{
+				for (size_t i = 0; i < pixelCount; i++) {
+					rgba[0] = rgb[0];
+					rgba[1] = rgb[1];
+					rgba[2] = rgb[2];
+					rgba[3] = 0xFF;
+					rgb += 3;
+					rgba += 4;
+				}
+			}
+
+#if defined(VKS_CPU_X86)
+			/*
+				Both vector paths load more bytes than they consume, so they stop as long as the load would read past the input and leave
+				the remaining pixels to the scalar path
+			*/
+
+			/** @brief Expands 4 pixels per iteration, returns the number of pixels expanded */
+			VKS_TARGET_SSSE3 size_t expandRGBToRGBASSSE3(const uint8_t *rgb, uint8_t *rgba, size_t pixelCount)
+			{
+				const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+				const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+				size_t expanded = 0;
+				// A 16 byte load covers 5 and a third pixels
+				while (pixelCount - expanded >= 6) {
+					const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + expanded * 3));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + expanded * 4), _mm_or_si128(_mm_shuffle_epi8(in, expand), alpha));
+					expanded += 4;
+				}
+				return expanded;
+			}
+
+			/** @brief Expands 8 pixels per iteration, returns the number of pixels expanded */
+			VKS_TARGET_AVX2 size_t expandRGBToRGBAAVX2(const uint8_t *rgb, uint8_t *rgba, size_t pixelCount)
+			{
+				// Byte shuffles work per 128 bit lane, so the 12 bytes of the upper 4 pixels are moved into the upper lane first
+				const __m256i spreadLanes = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+				const __m256i expand = _mm256_setr_epi8(
+					0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+					0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+				const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+				size_t expanded = 0;
+				// A 32 byte load covers 10 and two thirds pixels
+				while (pixelCount - expanded >= 11) {
+					const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgb + expanded * 3));
+					const __m256i spread = _mm256_permutevar8x32_epi32(in, spreadLanes);
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + expanded * 4), _mm256_or_si256(_mm256_shuffle_epi8(spread, expand), alpha));
+					expanded += 8;
+				}
+				return expanded;
+			}
+#endif
+		}
+
+		void expandRGBToRGBA(const uint8_t *rgb, uint8_t *rgba, size_t pixelCount)
+		{
+			size_t expanded = 0;
+#if defined(VKS_CPU_X86)
+			const CpuFeatures &features = getCpuFeatures();
+			if (features.avx2) {
+				expanded = expandRGBToRGBAAVX2(rgb, rgba, pixelCount);
+			}
+			if (features.ssse3) {
+				// The 4 pixel loop also picks up what remains after the 8 pixel one
+				expanded += expandRGBToRGBASSSE3(rgb + expanded * 3, rgba + expanded * 4, pixelCount - expanded);
+			}
+#endif
+			expandRGBToRGBAScalar(rgb + expanded * 3, rgba + expanded * 4, pixelCount - expanded);
+		}
+	}
+}
@@ -0,0 +1,24 @@
+/*
+* Pixel conversion
+*
+* Converts 8 bit pixel data between channel layouts with SSSE3 or AVX2 when the CPU supports it and a scalar fallback otherwise
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vks
+{
+	namespace pixels
+	{
+		/**
+		* @brief Expands RGB pixels to RGBA with an opaque alpha channel
+		* @param rgba Receives pixelCount * 4 bytes, may be write combined memory (e.g. mapped staging buffers) as it is written sequentially and never read
+		*/
+		void expandRGBToRGBA(const uint8_t *rgb, uint8_t *rgba, size_t pixelCount);
+	}
+}
@@ -0,0 +1,241 @@
+/*
+* Vulkan async transfer
+*
+* Streams buffer and image uploads through the dedicated transfer queue, completion is tracked with a timeline semaphore and ownership is handed over to the graphics queue
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanAsyncTransfer.h"
+
+#include <assert.h>
+#include <string.h>
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	AsyncTransfer::~AsyncTransfer()
+	{
+		destroy();
+	}
+
+	void AsyncTransfer::create(VulkanDevice *device, VkQueue transferQueue, VkQueue graphicsQueue, VkDeviceSize stagingSize)
+	{
+		assert(this->device == nullptr);
+		this->device = device;
+		this->transferQueue = transferQueue;
+		this->graphicsQueue = graphicsQueue;
+		transferQueueFamilyIndex = device->queueFamilyIndices.transfer;
+		graphicsQueueFamilyIndex = device->queueFamilyIndices.graphics;
+		async = device->timelineSemaphores && (transferQueueFamilyIndex != graphicsQueueFamilyIndex);
+		if (!async) {
+			return;
+		}
+
+		ring.create(device, stagingSize, transferQueueFamilyIndex);
+
+		VkSemaphoreTypeCreateInfoKHR semaphoreTypeInfo{};
+		semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		semaphoreTypeInfo.initialValue = 0;
+		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+		semaphoreCreateInfo.pNext = &semaphoreTypeInfo;
+		VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCreateInfo, nullptr, &timeline));
+
+		getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetSemaphoreCounterValueKHR"));
+		assert(getSemaphoreCounterValue);
+	}
+
+	void AsyncTransfer::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		if (async) {
+			VK_CHECK_RESULT(vkQueueWaitIdle(transferQueue));
+			ring.destroy();
+			vkDestroySemaphore(device->logicalDevice, timeline, nullptr);
+			timeline = VK_NULL_HANDLE;
+		}
+		// Uploads that haven't been acquired yet are dropped along with the resources they were meant for
+		pendingAcquires.clear();
+		inFlight.clear();
+		submittedValue = completedValue = 0;
+		async = false;
+		device = nullptr;
+	}
+
+	void AsyncTransfer::addAcquire(Acquire &acquire)
+	{
+		pendingAcquires.push_back(std::move(acquire));
+	}
+
+	uint64_t AsyncTransfer::uploadBuffer(VkBuffer buffer, VkDeviceSize bufferOffset, const void *data, VkDeviceSize size, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+	{
+		assert(device);
+		StagingRing &stagingRing = async ? ring : device->stagingRing;
+		VkQueue queue = async ? transferQueue : graphicsQueue;
+
+		StagingRegion staging = stagingRing.upload(queue, data, size);
+		VkCommandBuffer copyCmd = stagingRing.getCommandBuffer(queue);
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = staging.offset;
+		copyRegion.dstOffset = bufferOffset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(copyCmd, staging.buffer, buffer, 1, &copyRegion);
+
+		VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.buffer = buffer;
+		barrier.offset = bufferOffset;
+		barrier.size = size;
+		if (!async) {
+			barrier.dstAccessMask = dstAccessMask;
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+			return completedValue;
+		}
+
+		// Release the buffer to the graphics queue family, the acquire is recorded once the transfer has finished
+		barrier.srcQueueFamilyIndex = transferQueueFamilyIndex;
+		barrier.dstQueueFamilyIndex = graphicsQueueFamilyIndex;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		Acquire acquire;
+		acquire.bufferBarrier = barrier;
+		acquire.bufferBarrier.srcAccessMask = 0;
+		acquire.bufferBarrier.dstAccessMask = dstAccessMask;
+		acquire.dstStageMask = dstStageMask;
+		addAcquire(acquire);
+		return submittedValue + 1;
+	}
+
+	uint64_t AsyncTransfer::uploadImage(VkImage image, const void *data, VkDeviceSize size, std::vector<VkBufferImageCopy> regions, const VkImageSubresourceRange &subresourceRange, VkImageLayout finalLayout, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask, std::function<void(VkCommandBuffer)> onAcquire)
+	{
+		return uploadImage(image, size, 16, [data, size](void *mapped) { memcpy(mapped, data, size); }, regions, subresourceRange, finalLayout, dstStageMask, dstAccessMask, onAcquire);
+	}
+
+	uint64_t AsyncTransfer::uploadImage(VkImage image, VkDeviceSize size, VkDeviceSize alignment, const std::function<void(void *mapped)> &fill, std::vector<VkBufferImageCopy> regions, const VkImageSubresourceRange &subresourceRange, VkImageLayout finalLayout, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask, std::function<void(VkCommandBuffer)> onAcquire)
+	{
+		assert(device);
+		StagingRing &stagingRing = async ? ring : device->stagingRing;
+		VkQueue queue = async ? transferQueue : graphicsQueue;
+
+		StagingRegion staging = stagingRing.allocate(queue, size, alignment);
+		fill(staging.mapped);
+		for (auto &region : regions) {
+			region.bufferOffset += staging.offset;
+		}
+		VkCommandBuffer copyCmd = stagingRing.getCommandBuffer(queue);
+
+		VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.image = image;
+		barrier.subresourceRange = subresourceRange;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = finalLayout;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		if (!async) {
+			barrier.dstAccessMask = dstAccessMask;
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			if (onAcquire) {
+				onAcquire(copyCmd);
+			}
+			return completedValue;
+		}
+
+		// Release the image to the graphics queue family, the layout transition is part of the release and the acquire
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = transferQueueFamilyIndex;
+		barrier.dstQueueFamilyIndex = graphicsQueueFamilyIndex;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		Acquire acquire;
+		acquire.image = true;
+		acquire.imageBarrier = barrier;
+		acquire.imageBarrier.srcAccessMask = 0;
+		acquire.imageBarrier.dstAccessMask = dstAccessMask;
+		acquire.dstStageMask = dstStageMask;
+		acquire.onAcquire = onAcquire;
+		addAcquire(acquire);
+		return submittedValue + 1;
+	}
+
+	void AsyncTransfer::acquireCompleted(uint64_t counterValue)
+	{
+		uint64_t acquiredValue = 0;
+		while (!inFlight.empty() && (inFlight.front().value <= counterValue)) {
+			Submission &submission = inFlight.front();
+			VkCommandBuffer cmdBuffer = device->stagingRing.getCommandBuffer(graphicsQueue);
+			for (auto &acquire : submission.acquires) {
+				if (acquire.image) {
+					vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, acquire.dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &acquire.imageBarrier);
+				}
+				else {
+					vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, acquire.dstStageMask, 0, 0, nullptr, 1, &acquire.bufferBarrier, 0, nullptr);
+				}
+				if (acquire.onAcquire) {
+					acquire.onAcquire(cmdBuffer);
+				}
+			}
+			acquiredValue = submission.value;
+			inFlight.pop_front();
+		}
+		if (acquiredValue > 0) {
+			// The semaphore has already been reached, waiting on it orders the acquires after the releases on the transfer queue
+			device->stagingRing.addWaitSemaphore(timeline, acquiredValue, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+			completedValue = acquiredValue;
+		}
+	}
+
+	void AsyncTransfer::update()
+	{
+		if (!async) {
+			return;
+		}
+		if (!pendingAcquires.empty()) {
+			const uint64_t value = submittedValue + 1;
+			if (!ring.submit(timeline, value)) {
+				// The uploads have already been submitted when the ring ran full, so only the semaphore has to be signaled
+				VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+				timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+				timelineInfo.signalSemaphoreValueCount = 1;
+				timelineInfo.pSignalSemaphoreValues = &value;
+				VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+				submitInfo.pNext = &timelineInfo;
+				submitInfo.signalSemaphoreCount = 1;
+				submitInfo.pSignalSemaphores = &timeline;
+				VK_CHECK_RESULT(vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+			}
+			submittedValue = value;
+			Submission submission;
+			submission.value = value;
+			submission.acquires.swap(pendingAcquires);
+			inFlight.push_back(std::move(submission));
+		}
+		if (inFlight.empty()) {
+			return;
+		}
+		uint64_t counterValue;
+		VK_CHECK_RESULT(getSemaphoreCounterValue(device->logicalDevice, timeline, &counterValue));
+		acquireCompleted(counterValue);
+	}
+
+	void AsyncTransfer::waitIdle()
+	{
+		if (!async) {
+			return;
+		}
+		update();
+		VK_CHECK_RESULT(vkQueueWaitIdle(transferQueue));
+		uint64_t counterValue;
+		VK_CHECK_RESULT(getSemaphoreCounterValue(device->logicalDevice, timeline, &counterValue));
+		acquireCompleted(counterValue);
+	}
+}
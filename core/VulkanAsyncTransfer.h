@@ -0,0 +1,108 @@
+/*
+* Vulkan async transfer
+*
+* Streams buffer and image uploads through the dedicated transfer queue, completion is tracked with a timeline semaphore and ownership is handed over to the graphics queue
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanStagingRing.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* @brief Uploads that don't block the render loop
+	*
+	* Copies are recorded for the transfer queue and submitted by update() (called once per frame), which signals a timeline semaphore.
+	* Once the semaphore has been reached, the matching queue family ownership acquires are recorded into the device's staging ring, so the
+	* next graphics submission picks them up. Uploads return a ticket that can be checked with isReady() before using the resource.
+	* Without a separate transfer queue family or timeline semaphore support, uploads go through the device's staging ring on the graphics queue and are ready right away.
+	* @note Not thread safe, uploads and update() have to be called from the thread that submits the frames
+	*/
+	class AsyncTransfer
+	{
+	private:
+		/** @brief Ownership acquire to be recorded on the graphics queue once the release has finished */
+		struct Acquire
+		{
+			bool image = false;
+			VkBufferMemoryBarrier bufferBarrier{};
+			VkImageMemoryBarrier imageBarrier{};
+			VkPipelineStageFlags dstStageMask = 0;
+			/** @brief Graphics queue commands to record after the acquire, e.g. generating the mip chain of an image */
+			std::function<void(VkCommandBuffer)> onAcquire;
+		};
+		struct Submission
+		{
+			uint64_t value = 0;
+			std::vector<Acquire> acquires;
+		};
+
+		VulkanDevice *device = nullptr;
+		VkQueue transferQueue = VK_NULL_HANDLE;
+		VkQueue graphicsQueue = VK_NULL_HANDLE;
+		uint32_t transferQueueFamilyIndex = 0;
+		uint32_t graphicsQueueFamilyIndex = 0;
+		bool async = false;
+		StagingRing ring;
+		VkSemaphore timeline = VK_NULL_HANDLE;
+		PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue = nullptr;
+		/** @brief Last timeline value signaled by a transfer submission */
+		uint64_t submittedValue = 0;
+		/** @brief Last timeline value whose uploads have been acquired by the graphics queue */
+		uint64_t completedValue = 0;
+		/** @brief Acquires for the uploads recorded since the last submission */
+		std::vector<Acquire> pendingAcquires;
+		std::deque<Submission> inFlight;
+
+		void addAcquire(Acquire &acquire);
+		void acquireCompleted(uint64_t counterValue);
+	public:
+		AsyncTransfer() = default;
+		~AsyncTransfer();
+		AsyncTransfer(const AsyncTransfer&) = delete;
+		AsyncTransfer& operator=(const AsyncTransfer&) = delete;
+
+		/** @brief Sets up the transfer path, uploads only run asynchronously if the queues belong to different families and timeline semaphores are enabled */
+		void create(VulkanDevice *device, VkQueue transferQueue, VkQueue graphicsQueue, VkDeviceSize stagingSize);
+		void destroy();
+		bool isAsync() const { return async; }
+
+		/**
+		* @brief Uploads data into a buffer
+		* @param dstStageMask Stages of the graphics queue that access the buffer after the upload
+		* @param dstAccessMask Access types of the graphics queue to the buffer after the upload
+		* @return Ticket to pass to isReady()
+		*/
+		uint64_t uploadBuffer(VkBuffer buffer, VkDeviceSize bufferOffset, const void *data, VkDeviceSize size, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+		/**
+		* @brief Uploads data into an image that is in VK_IMAGE_LAYOUT_UNDEFINED and transitions it to finalLayout
+		* @param regions Copy regions, the buffer offsets are relative to data
+		* @param onAcquire (Optional) Commands recorded on the graphics queue after the image has been acquired with finalLayout
+		* @return Ticket to pass to isReady()
+		*/
+		uint64_t uploadImage(VkImage image, const void *data, VkDeviceSize size, std::vector<VkBufferImageCopy> regions, const VkImageSubresourceRange &subresourceRange, VkImageLayout finalLayout, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask, std::function<void(VkCommandBuffer)> onAcquire = nullptr);
+		/**
+		* @brief Uploads data into an image like uploadImage, but lets fill write the data straight into the staging memory
+		* @param fill Called once with the mapped staging memory, has to write size bytes
+		* @param alignment Alignment of the staging offset, has to be a multiple of the texel block size of the image's format
+		*/
+		uint64_t uploadImage(VkImage image, VkDeviceSize size, VkDeviceSize alignment, const std::function<void(void *mapped)> &fill, std::vector<VkBufferImageCopy> regions, const VkImageSubresourceRange &subresourceRange, VkImageLayout finalLayout, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask, std::function<void(VkCommandBuffer)> onAcquire = nullptr);
+		/** @brief Returns true once the uploads up to the ticket can be used by graphics queue submissions */
+		bool isReady(uint64_t ticket) const { return ticket <= completedValue; }
+
+		/** @brief Submits the recorded transfers and hands finished ones over to the graphics queue, never blocks */
+		void update();
+		/** @brief Waits for all transfers and hands them over to the graphics queue */
+		void waitIdle();
+	};
+}
@@ -22,7 +22,13 @@ namespace vks
 	*/
 	VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset)
 	{
-		return vkMapMemory(device, memory, offset, size, 0, &mapped);
+		// Sub-allocated host visible memory is persistently mapped by the allocator
+		if (allocation.mapped)
+		{
+			mapped = static_cast<uint8_t*>(allocation.mapped) + offset;
+			return VK_SUCCESS;
+		}
+		return vkMapMemory(device, memory, allocation.offset + offset, size, 0, &mapped);
 	}
 
 	/**
@@ -34,7 +40,10 @@ namespace vks
 	{
 		if (mapped)
 		{
-			vkUnmapMemory(device, memory);
+			if (!allocation.mapped)
+			{
+				vkUnmapMemory(device, memory);
+			}
 			mapped = nullptr;
 		}
 	}
@@ -48,7 +57,7 @@ namespace vks
 	*/
 	VkResult Buffer::bind(VkDeviceSize offset)
 	{
-		return vkBindBufferMemory(device, buffer, memory, offset);
+		return vkBindBufferMemory(device, buffer, memory, allocation.offset + offset);
 	}
 
 	/**
@@ -78,6 +87,21 @@ namespace vks
 		memcpy(mapped, data, size);
 	}
 
+	/**
+	* Get the memory range covering a range of the buffer, as used for flushing and invalidating
+	*
+	* @note VK_WHOLE_SIZE is limited to the buffer's allocation, as other allocations may share the same memory
+	*/
+	VkMappedMemoryRange Buffer::getMappedRange(VkDeviceSize size, VkDeviceSize offset) const
+	{
+		VkMappedMemoryRange mappedRange = {};
+		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		mappedRange.memory = memory;
+		mappedRange.offset = allocation.offset + offset;
+		mappedRange.size = ((size == VK_WHOLE_SIZE) && allocation.block) ? allocation.size - offset : size;
+		return mappedRange;
+	}
+
 	/** 
 	* Flush a memory range of the buffer to make it visible to the device
 	*
@@ -90,11 +114,7 @@ namespace vks
 	*/
 	VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset)
 	{
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		VkMappedMemoryRange mappedRange = getMappedRange(size, offset);
 		return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
@@ -110,11 +130,7 @@ namespace vks
 	*/
 	VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
 	{
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		VkMappedMemoryRange mappedRange = getMappedRange(size, offset);
 		return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
@@ -123,13 +139,20 @@ namespace vks
 	*/
 	void Buffer::destroy()
 	{
+		unmap();
 		if (buffer)
 		{
 			vkDestroyBuffer(device, buffer, nullptr);
+			buffer = VK_NULL_HANDLE;
+		}
+		if (allocation.allocator)
+		{
+			allocation.allocator->free(allocation);
 		}
-		if (memory)
+		else if (memory)
 		{
 			vkFreeMemory(device, memory, nullptr);
 		}
+		memory = VK_NULL_HANDLE;
 	}
 };
@@ -64,10 +64,14 @@ namespace vks
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
+		asyncTransfer.destroy();
+		stagingRing.destroy();
+		uniformAllocator.destroy();
 		if (commandPool)
 		{
 			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
 		}
+		memoryAllocator.destroy();
 		if (logicalDevice)
 		{
 			vkDestroyDevice(logicalDevice, nullptr);
@@ -269,6 +273,32 @@ namespace vks
 			deviceCreateInfo.pNext = &physicalDeviceFeatures2;
 		}
 
+		// Timeline semaphores track the uploads on a dedicated transfer queue
+		// Devices exposing the extension have to support its timelineSemaphore feature, so it isn't queried
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+		if ((queueFamilyIndices.transfer != queueFamilyIndices.graphics) && extensionSupported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+		{
+			if (std::find(deviceExtensions.begin(), deviceExtensions.end(), std::string(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) == deviceExtensions.end())
+			{
+				deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			}
+			timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+			timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+			timelineSemaphoreFeatures.pNext = const_cast<void*>(deviceCreateInfo.pNext);
+			deviceCreateInfo.pNext = &timelineSemaphoreFeatures;
+			timelineSemaphores = true;
+		}
+
+		// Heap budgets are read with vkGetPhysicalDeviceMemoryProperties2KHR, which needs the instance extension
+		if (getPhysicalDeviceMemoryProperties2 && extensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+		{
+			if (std::find(deviceExtensions.begin(), deviceExtensions.end(), std::string(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) == deviceExtensions.end())
+			{
+				deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			}
+			memoryBudget = true;
+		}
+
 		// Enable the debug marker extension if it is present (likely meaning a debugging tool is present)
 		if (extensionSupported(VK_EXT_DEBUG_MARKER_EXTENSION_NAME))
 		{
@@ -308,9 +338,145 @@ namespace vks
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
+		memoryAllocator.init(logicalDevice, memoryProperties, properties.limits);
+		stagingRing.create(this, 32 * 1024 * 1024, queueFamilyIndices.graphics);
+
+		VkQueue graphicsQueue, transferQueue;
+		vkGetDeviceQueue(logicalDevice, queueFamilyIndices.graphics, 0, &graphicsQueue);
+		vkGetDeviceQueue(logicalDevice, queueFamilyIndices.transfer, 0, &transferQueue);
+		asyncTransfer.create(this, transferQueue, graphicsQueue, 32 * 1024 * 1024);
+
+		updateMemoryBudget();
+
 		return result;
 	}
 
+	/**
+	* Allocate memory for a buffer from the device's memory allocator and bind it to the buffer
+	*
+	* @param buffer Buffer to allocate the memory for
+	* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
+	* @param allocation Pointer to the allocation that receives the memory range
+	* @param category (Optional) Category the allocation is counted in
+	* @param deviceAddress (Optional) Set if the buffer has been created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+	*
+	* @return VK_SUCCESS if the memory has been allocated and bound
+	*/
+	VkResult VulkanDevice::allocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags memoryPropertyFlags, vks::MemoryAllocation *allocation, vks::MemoryCategory category, bool deviceAddress)
+	{
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(logicalDevice, buffer, &memReqs);
+		// Find a memory type index that fits the properties of the buffer
+		const uint32_t memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
+		// Such buffers get a dedicated allocation, so regular blocks don't need to be allocated with the flag
+		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
+		if (deviceAddress) {
+			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
+			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
+		}
+		VkResult result = memoryAllocator.allocate(memReqs, memoryTypeIndex, true, category, allocation, false, deviceAddress ? &allocFlagsInfo : nullptr);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+		return vkBindBufferMemory(logicalDevice, buffer, allocation->memory, allocation->offset);
+	}
+
+	/**
+	* Allocate memory for an image from the device's memory allocator and bind it to the image
+	*
+	* @param image Image to allocate the memory for
+	* @param memoryPropertyFlags Memory properties for this image (usually device local)
+	* @param allocation Pointer to the allocation that receives the memory range
+	* @param category (Optional) Category the allocation is counted in
+	* @param linearTiling (Optional) Set if the image has been created with VK_IMAGE_TILING_LINEAR
+	*
+	* @return VK_SUCCESS if the memory has been allocated and bound
+	*/
+	VkResult VulkanDevice::allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, vks::MemoryAllocation *allocation, vks::MemoryCategory category, bool linearTiling)
+	{
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+		const uint32_t memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+		VkResult result = memoryAllocator.allocate(memReqs, memoryTypeIndex, linearTiling, category, allocation);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+		return vkBindImageMemory(logicalDevice, image, allocation->memory, allocation->offset);
+	}
+
+	/**
+	* Return memory allocated by allocateBufferMemory or allocateImageMemory to the device's memory allocator
+	*
+	* @param allocation Allocation to free, reset to an empty allocation afterwards
+	*/
+	void VulkanDevice::freeMemory(vks::MemoryAllocation &allocation)
+	{
+		memoryAllocator.free(allocation);
+	}
+
+	/**
+	* Refresh the budget and usage of all memory heaps
+	*
+	* @note Without VK_EXT_memory_budget the budget is the heap size and the usage only covers the device memory reserved by the memory allocator
+	*/
+	void VulkanDevice::updateMemoryBudget()
+	{
+		heapBudgets.resize(memoryProperties.memoryHeapCount);
+		if (memoryBudget)
+		{
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+			budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+			VkPhysicalDeviceMemoryProperties2KHR memoryProperties2{};
+			memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+			memoryProperties2.pNext = &budgetProperties;
+			getPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+			{
+				heapBudgets[i].budget = budgetProperties.heapBudget[i];
+				heapBudgets[i].usage = budgetProperties.heapUsage[i];
+			}
+		}
+		else
+		{
+			const vks::MemoryStatistics statistics = memoryAllocator.getStatistics();
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+			{
+				heapBudgets[i].budget = memoryProperties.memoryHeaps[i].size;
+				heapBudgets[i].usage = 0;
+			}
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+			{
+				heapBudgets[memoryProperties.memoryTypes[i].heapIndex].usage += statistics.memoryTypes[i].reservedBytes;
+			}
+		}
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+		{
+			heapBudgets[i].size = memoryProperties.memoryHeaps[i].size;
+			heapBudgets[i].deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		}
+	}
+
+	/**
+	* Get the memory category of a buffer from its usage flags
+	*/
+	static vks::MemoryCategory getBufferMemoryCategory(VkBufferUsageFlags usageFlags)
+	{
+		if (usageFlags & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) {
+			return vks::MemoryCategory::Vertex;
+		}
+		if (usageFlags & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) {
+			return vks::MemoryCategory::Index;
+		}
+		if (usageFlags & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+			return vks::MemoryCategory::Uniform;
+		}
+		if (usageFlags == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {
+			return vks::MemoryCategory::Staging;
+		}
+		return vks::MemoryCategory::Other;
+	}
+
 	/**
 	* Create a buffer on the device
 	*
@@ -318,55 +484,42 @@ namespace vks
 	* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
 	* @param size Size of the buffer in byes
 	* @param buffer Pointer to the buffer handle acquired by the function
-	* @param memory Pointer to the memory handle acquired by the function
+	* @param memory Pointer to the memory allocation acquired by the function (to be freed with freeMemory)
 	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	* @param category (Optional) Category the memory is counted in, derived from the usage flags by default
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
 	*/
-	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data)
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, vks::MemoryAllocation *memory, void *data, vks::MemoryCategory category)
 	{
+		if (category == vks::MemoryCategory::Auto) {
+			category = getBufferMemoryCategory(usageFlags);
+		}
+
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
 
-		// Create the memory backing up the buffer handle
-		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		vkGetBufferMemoryRequirements(logicalDevice, *buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
-		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
-		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
-		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, memory));
-			
-		// If a pointer to the buffer data has been passed, map the buffer and copy over the data
+		// Sub-allocate the memory backing up the buffer handle and attach it to the buffer object
+		VK_CHECK_RESULT(allocateBufferMemory(*buffer, memoryPropertyFlags, memory, category, (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0));
+
+		// If a pointer to the buffer data has been passed, copy it over using the persistent mapping of the allocation
 		if (data != nullptr)
 		{
-			void *mapped;
-			VK_CHECK_RESULT(vkMapMemory(logicalDevice, *memory, 0, size, 0, &mapped));
-			memcpy(mapped, data, size);
+			assert(memory->mapped);
+			memcpy(memory->mapped, data, size);
 			// If host coherency hasn't been requested, do a manual flush to make writes visible
 			if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
 			{
 				VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
-				mappedRange.memory = *memory;
-				mappedRange.offset = 0;
-				mappedRange.size = size;
+				mappedRange.memory = memory->memory;
+				mappedRange.offset = memory->offset;
+				mappedRange.size = memory->size;
 				vkFlushMappedMemoryRanges(logicalDevice, 1, &mappedRange);
 			}
-			vkUnmapMemory(logicalDevice, *memory);
 		}
 
-		// Attach the memory to the buffer object
-		VK_CHECK_RESULT(vkBindBufferMemory(logicalDevice, *buffer, *memory, 0));
-
 		return VK_SUCCESS;
 	}
 
@@ -378,40 +531,35 @@ namespace vks
 	* @param buffer Pointer to a vk::Vulkan buffer object
 	* @param size Size of the buffer in bytes
 	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	* @param category (Optional) Category the memory is counted in, derived from the usage flags by default
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
 	*/
-	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data)
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data, vks::MemoryCategory category)
 	{
+		if (category == vks::MemoryCategory::Auto) {
+			category = getBufferMemoryCategory(usageFlags);
+		}
+
 		buffer->device = logicalDevice;
 
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
 
-		// Create the memory backing up the buffer handle
+		// Sub-allocate the memory backing up the buffer handle and attach it to the buffer object
+		VkResult result = allocateBufferMemory(buffer->buffer, memoryPropertyFlags, &buffer->allocation, category, (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0);
+		buffer->memory = buffer->allocation.memory;
+
 		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
-		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
-		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
-		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
-
 		buffer->alignment = memReqs.alignment;
 		buffer->size = size;
 		buffer->usageFlags = usageFlags;
 		buffer->memoryPropertyFlags = memoryPropertyFlags;
 
 		// If a pointer to the buffer data has been passed, map the buffer and copy over the data
-		if (data != nullptr)
+		if ((result == VK_SUCCESS) && (data != nullptr))
 		{
 			VK_CHECK_RESULT(buffer->map());
 			memcpy(buffer->mapped, data, size);
@@ -424,8 +572,7 @@ namespace vks
 		// Initialize a default descriptor that covers the whole buffer size
 		buffer->setupDescriptor();
 
-		// Attach the memory to the buffer object
-		return buffer->bind();
+		return result;
 	}
 
 	/**
@@ -527,6 +674,9 @@ namespace vks
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 
+		// Pending staging uploads have to be submitted first, the command buffer may use the resources they fill
+		stagingRing.submit();
+
 		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
@@ -10,8 +10,12 @@
 
 #pragma once
 
+#include "VulkanAsyncTransfer.h"
 #include "VulkanBuffer.h"
+#include "VulkanMemoryAllocator.h"
+#include "VulkanStagingRing.h"
 #include "VulkanTools.h"
+#include "VulkanUniformAllocator.h"
 #include "vulkan/vulkan.h"
 #include <algorithm>
 #include <assert.h>
@@ -19,6 +23,17 @@
 
 namespace vks
 {
+/** @brief Memory use of a heap, as reported by VK_EXT_memory_budget or estimated from the memory allocator */
+struct MemoryHeapBudget
+{
+	VkDeviceSize size = 0;
+	/** @brief Memory the process can allocate from the heap before allocations may fail or degrade performance */
+	VkDeviceSize budget = 0;
+	/** @brief Memory of the heap used by the process (only the memory allocator's blocks without VK_EXT_memory_budget) */
+	VkDeviceSize usage = 0;
+	bool deviceLocal = false;
+};
+
 struct VulkanDevice
 {
 	/** @brief Physical device representation */
@@ -39,8 +54,24 @@ struct VulkanDevice
 	std::vector<std::string> supportedExtensions;
 	/** @brief Default command pool for the graphics queue family index */
 	VkCommandPool commandPool = VK_NULL_HANDLE;
+	/** @brief Sub-allocator used for all buffer and image memory created through the device */
+	vks::MemoryAllocator memoryAllocator;
+	/** @brief Staging ring used by the upload paths, uploads are batched and only submitted on demand */
+	vks::StagingRing stagingRing;
+	/** @brief Uploads through the dedicated transfer queue that don't stall rendering, see AsyncTransfer */
+	vks::AsyncTransfer asyncTransfer;
+	/** @brief Per-frame uniform data bound with dynamic offsets, created by the application once the number of frames is known */
+	vks::UniformAllocator uniformAllocator;
 	/** @brief Set to true when the debug marker extension is detected */
 	bool enableDebugMarkers = false;
+	/** @brief Set to true when VK_KHR_timeline_semaphore has been enabled */
+	bool timelineSemaphores = false;
+	/** @brief Set by the application if VK_KHR_get_physical_device_properties2 has been enabled on the instance, needed for VK_EXT_memory_budget */
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2 = nullptr;
+	/** @brief Set to true when VK_EXT_memory_budget has been enabled */
+	bool memoryBudget = false;
+	/** @brief Budget and usage per memory heap, refreshed by updateMemoryBudget() */
+	std::vector<MemoryHeapBudget> heapBudgets;
 	/** @brief Contains queue family indices */
 	struct
 	{
@@ -56,9 +87,13 @@ struct VulkanDevice
 	~VulkanDevice();
 	uint32_t        getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, VkBool32 *memTypeFound = nullptr) const;
 	uint32_t        getQueueFamilyIndex(VkQueueFlags queueFlags) const;
-	VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char *> enabledExtensions, void *pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
-	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr);
-	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr);
+	VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char *> enabledExtensions, void *pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
+	VkResult        allocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags memoryPropertyFlags, vks::MemoryAllocation *allocation, vks::MemoryCategory category = vks::MemoryCategory::Other, bool deviceAddress = false);
+	VkResult        allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, vks::MemoryAllocation *allocation, vks::MemoryCategory category = vks::MemoryCategory::Other, bool linearTiling = false);
+	void            freeMemory(vks::MemoryAllocation &allocation);
+	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, vks::MemoryAllocation *memory, void *data = nullptr, vks::MemoryCategory category = vks::MemoryCategory::Auto);
+	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr, vks::MemoryCategory category = vks::MemoryCategory::Auto);
+	void            updateMemoryBudget();
 	void            copyBuffer(vks::Buffer *src, vks::Buffer *dst, VkQueue queue, VkBufferCopy *copyRegion = nullptr);
 	VkCommandPool   createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin = false);
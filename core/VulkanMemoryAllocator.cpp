@@ -0,0 +1,336 @@
+/*
+* Vulkan memory allocator
+*
+* Sub-allocates buffers and images from large device memory blocks per memory type using a buddy allocator
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMemoryAllocator.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <iostream>
+#include "VulkanTools.h"
+
+namespace vks
+{
+	const char *getMemoryCategoryName(MemoryCategory category)
+	{
+		switch (category) {
+		case MemoryCategory::Other: return "other";
+		case MemoryCategory::Vertex: return "vertex";
+		case MemoryCategory::Index: return "index";
+		case MemoryCategory::Uniform: return "uniform";
+		case MemoryCategory::Texture: return "texture";
+		case MemoryCategory::Staging: return "staging";
+		case MemoryCategory::Overlay: return "overlay";
+		default: return "unknown";
+		}
+	}
+
+	MemoryAllocator::~MemoryAllocator()
+	{
+		destroy();
+	}
+
+	void MemoryAllocator::init(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, const VkPhysicalDeviceLimits &limits)
+	{
+		// Block sizes must be a power of two for the buddy allocation to work
+		assert((preferredBlockSize & (preferredBlockSize - 1)) == 0);
+		this->device = device;
+		this->memoryProperties = memoryProperties;
+		nonCoherentAtomSize = std::max(limits.nonCoherentAtomSize, (VkDeviceSize)1);
+	}
+
+	void MemoryAllocator::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		uint32_t leakedAllocations = 0;
+		for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+			for (auto &pool : blocks[i]) {
+				for (auto &block : pool) {
+					leakedAllocations += block->allocationCount;
+					vkFreeMemory(device, block->memory, nullptr);
+				}
+				pool.clear();
+			}
+			leakedAllocations += dedicatedStats[i].allocationCount;
+			dedicatedStats[i] = MemoryStats();
+		}
+		for (auto &stats : categoryStats) {
+			stats = MemoryCategoryStats();
+		}
+		if (leakedAllocations > 0) {
+			std::cerr << "Memory allocator destroyed with " << leakedAllocations << " allocations still alive" << "\n";
+		}
+	}
+
+	VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const
+	{
+		// Keep blocks small compared to the heap, so small heaps (e.g. host visible device local memory) aren't exhausted by a few blocks
+		const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+		VkDeviceSize blockSize = preferredBlockSize;
+		while ((blockSize > minAllocationSize) && (blockSize > heapSize / 8)) {
+			blockSize >>= 1;
+		}
+		return blockSize;
+	}
+
+	uint32_t MemoryAllocator::getOrder(VkDeviceSize size) const
+	{
+		uint32_t order = 0;
+		while ((minAllocationSize << order) < size) {
+			order++;
+		}
+		return order;
+	}
+
+	VkResult MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, const void *pNext, VkDeviceMemory *memory, void **mapped)
+	{
+		VkMemoryAllocateInfo memAlloc{};
+		memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAlloc.pNext = pNext;
+		memAlloc.allocationSize = size;
+		memAlloc.memoryTypeIndex = memoryTypeIndex;
+		VkResult result = vkAllocateMemory(device, &memAlloc, nullptr, memory);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+		// Memory can only be mapped once, so host visible memory stays mapped for its whole lifetime and is shared by all allocations
+		*mapped = nullptr;
+		if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			result = vkMapMemory(device, *memory, 0, VK_WHOLE_SIZE, 0, mapped);
+			if (result != VK_SUCCESS) {
+				vkFreeMemory(device, *memory, nullptr);
+				*memory = VK_NULL_HANDLE;
+			}
+		}
+		return result;
+	}
+
+	bool MemoryAllocator::allocateFromBlock(MemoryBlock &block, uint32_t order, VkDeviceSize *offset)
+	{
+		const uint32_t maxOrder = static_cast<uint32_t>(block.freeRanges.size()) - 1;
+		uint32_t freeOrder = order;
+		while ((freeOrder <= maxOrder) && block.freeRanges[freeOrder].empty()) {
+			freeOrder++;
+		}
+		if (freeOrder > maxOrder) {
+			return false;
+		}
+		// Take the lowest free range, then split it until it has the requested size, the upper halves become free ranges
+		*offset = *block.freeRanges[freeOrder].begin();
+		block.freeRanges[freeOrder].erase(block.freeRanges[freeOrder].begin());
+		while (freeOrder > order) {
+			freeOrder--;
+			block.freeRanges[freeOrder].insert(*offset + (minAllocationSize << freeOrder));
+		}
+		return true;
+	}
+
+	void MemoryAllocator::freeInBlock(MemoryBlock &block, VkDeviceSize offset, uint32_t order)
+	{
+		const uint32_t maxOrder = static_cast<uint32_t>(block.freeRanges.size()) - 1;
+		// Merge with the buddy range as long as it is free
+		while (order < maxOrder) {
+			const VkDeviceSize buddy = offset ^ (minAllocationSize << order);
+			if (block.freeRanges[order].erase(buddy) == 0) {
+				break;
+			}
+			offset = std::min(offset, buddy);
+			order++;
+		}
+		block.freeRanges[order].insert(offset);
+	}
+
+	void MemoryAllocator::addToCategory(const MemoryAllocation &allocation)
+	{
+		MemoryCategoryStats &stats = categoryStats[static_cast<uint32_t>(allocation.category)];
+		stats.allocationCount++;
+		stats.allocatedBytes += allocation.size;
+		stats.requestedBytes += allocation.requestedSize;
+		if (memoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+			stats.deviceLocalBytes += allocation.size;
+		}
+		stats.peakAllocatedBytes = std::max(stats.peakAllocatedBytes, stats.allocatedBytes);
+	}
+
+	VkResult MemoryAllocator::allocate(const VkMemoryRequirements &memoryRequirements, uint32_t memoryTypeIndex, bool linear, MemoryCategory category, MemoryAllocation *allocation, bool dedicated, const void *pNext)
+	{
+		assert(device != VK_NULL_HANDLE);
+		assert(allocation && (allocation->allocator == nullptr));
+		assert(memoryTypeIndex < memoryProperties.memoryTypeCount);
+		assert(category < MemoryCategory::Count);
+
+		// Ranges of non-coherent memory must be flushed in multiples of nonCoherentAtomSize, so allocations must not share an atom
+		VkDeviceSize alignment = std::max(memoryRequirements.alignment, (VkDeviceSize)1);
+		const VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+			alignment = std::max(alignment, nonCoherentAtomSize);
+		}
+		// Buddy ranges are aligned to their size, so a range at least as large as the alignment is always suitably aligned
+		const VkDeviceSize rangeSize = std::max(memoryRequirements.size, alignment);
+		const VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// Large resources get their own device memory, sub-allocating them would waste most of a block
+		if (dedicated || pNext || (rangeSize > blockSize / 2)) {
+			void *mapped = nullptr;
+			VkResult result = allocateDeviceMemory(memoryRequirements.size, memoryTypeIndex, pNext, &allocation->memory, &mapped);
+			if (result != VK_SUCCESS) {
+				return result;
+			}
+			allocation->offset = 0;
+			allocation->size = memoryRequirements.size;
+			allocation->mapped = mapped;
+			allocation->memoryTypeIndex = memoryTypeIndex;
+			allocation->allocator = this;
+			allocation->block = nullptr;
+			allocation->order = 0;
+			allocation->requestedSize = memoryRequirements.size;
+			allocation->category = category;
+			addToCategory(*allocation);
+			MemoryStats &stats = dedicatedStats[memoryTypeIndex];
+			stats.deviceMemoryCount++;
+			stats.dedicatedAllocationCount++;
+			stats.allocationCount++;
+			stats.reservedBytes += memoryRequirements.size;
+			stats.allocatedBytes += memoryRequirements.size;
+			stats.requestedBytes += memoryRequirements.size;
+			return VK_SUCCESS;
+		}
+
+		const uint32_t order = getOrder(rangeSize);
+		std::vector<std::unique_ptr<MemoryBlock>> &pool = blocks[memoryTypeIndex][linear ? 0 : 1];
+		MemoryBlock *block = nullptr;
+		VkDeviceSize offset = 0;
+		for (auto &candidate : pool) {
+			if (allocateFromBlock(*candidate, order, &offset)) {
+				block = candidate.get();
+				break;
+			}
+		}
+		if (!block) {
+			std::unique_ptr<MemoryBlock> newBlock(new MemoryBlock());
+			void *mapped = nullptr;
+			VkResult result = allocateDeviceMemory(blockSize, memoryTypeIndex, nullptr, &newBlock->memory, &mapped);
+			if (result != VK_SUCCESS) {
+				return result;
+			}
+			newBlock->size = blockSize;
+			newBlock->mapped = static_cast<uint8_t*>(mapped);
+			newBlock->memoryTypeIndex = memoryTypeIndex;
+			newBlock->linear = linear;
+			newBlock->freeRanges.resize(getOrder(blockSize) + 1);
+			newBlock->freeRanges.back().insert(0);
+			block = newBlock.get();
+			pool.push_back(std::move(newBlock));
+			bool allocated = allocateFromBlock(*block, order, &offset);
+			assert(allocated);
+			(void)allocated;
+		}
+
+		block->allocationCount++;
+		block->allocatedBytes += minAllocationSize << order;
+		block->requestedBytes += memoryRequirements.size;
+
+		allocation->memory = block->memory;
+		allocation->offset = offset;
+		allocation->size = minAllocationSize << order;
+		allocation->mapped = block->mapped ? block->mapped + offset : nullptr;
+		allocation->memoryTypeIndex = memoryTypeIndex;
+		allocation->allocator = this;
+		allocation->block = block;
+		allocation->order = order;
+		allocation->requestedSize = memoryRequirements.size;
+		allocation->category = category;
+		addToCategory(*allocation);
+		return VK_SUCCESS;
+	}
+
+	void MemoryAllocator::free(MemoryAllocation &allocation)
+	{
+		if (!allocation.allocator) {
+			return;
+		}
+		assert(allocation.allocator == this);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		MemoryCategoryStats &categoryStat = categoryStats[static_cast<uint32_t>(allocation.category)];
+		categoryStat.allocationCount--;
+		categoryStat.allocatedBytes -= allocation.size;
+		categoryStat.requestedBytes -= allocation.requestedSize;
+		if (memoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+			categoryStat.deviceLocalBytes -= allocation.size;
+		}
+		MemoryBlock *block = allocation.block;
+		if (block) {
+			freeInBlock(*block, allocation.offset, allocation.order);
+			block->allocationCount--;
+			block->allocatedBytes -= allocation.size;
+			block->requestedBytes -= allocation.requestedSize;
+			// Keep one empty block per pool around, so resources that are created and destroyed repeatedly don't allocate device memory each time
+			if (block->allocationCount == 0) {
+				std::vector<std::unique_ptr<MemoryBlock>> &pool = blocks[block->memoryTypeIndex][block->linear ? 0 : 1];
+				auto otherEmptyBlock = std::find_if(pool.begin(), pool.end(), [block](const std::unique_ptr<MemoryBlock> &candidate) {
+					return (candidate.get() != block) && (candidate->allocationCount == 0);
+				});
+				if (otherEmptyBlock != pool.end()) {
+					vkFreeMemory(device, block->memory, nullptr);
+					pool.erase(std::find_if(pool.begin(), pool.end(), [block](const std::unique_ptr<MemoryBlock> &candidate) { return candidate.get() == block; }));
+				}
+			}
+		}
+		else {
+			vkFreeMemory(device, allocation.memory, nullptr);
+			MemoryStats &stats = dedicatedStats[allocation.memoryTypeIndex];
+			stats.deviceMemoryCount--;
+			stats.dedicatedAllocationCount--;
+			stats.allocationCount--;
+			stats.reservedBytes -= allocation.size;
+			stats.allocatedBytes -= allocation.size;
+			stats.requestedBytes -= allocation.requestedSize;
+		}
+		allocation = MemoryAllocation();
+	}
+
+	MemoryStatistics MemoryAllocator::getStatistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		MemoryStatistics statistics;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryCategory::Count); i++) {
+			statistics.categories[i] = categoryStats[i];
+		}
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			MemoryStats &stats = statistics.memoryTypes[i];
+			stats = dedicatedStats[i];
+			for (auto &pool : blocks[i]) {
+				for (auto &block : pool) {
+					stats.deviceMemoryCount++;
+					stats.blockCount++;
+					stats.allocationCount += block->allocationCount;
+					stats.reservedBytes += block->size;
+					stats.allocatedBytes += block->allocatedBytes;
+					stats.requestedBytes += block->requestedBytes;
+					for (size_t order = block->freeRanges.size(); order > 0; order--) {
+						if (!block->freeRanges[order - 1].empty()) {
+							stats.largestFreeRange = std::max(stats.largestFreeRange, minAllocationSize << (order - 1));
+							break;
+						}
+					}
+				}
+			}
+			statistics.total.deviceMemoryCount += stats.deviceMemoryCount;
+			statistics.total.blockCount += stats.blockCount;
+			statistics.total.dedicatedAllocationCount += stats.dedicatedAllocationCount;
+			statistics.total.allocationCount += stats.allocationCount;
+			statistics.total.reservedBytes += stats.reservedBytes;
+			statistics.total.allocatedBytes += stats.allocatedBytes;
+			statistics.total.requestedBytes += stats.requestedBytes;
+			statistics.total.largestFreeRange = std::max(statistics.total.largestFreeRange, stats.largestFreeRange);
+		}
+		return statistics;
+	}
+}
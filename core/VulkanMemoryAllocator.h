@@ -0,0 +1,162 @@
+/*
+* Vulkan memory allocator
+*
+* Sub-allocates buffers and images from large device memory blocks per memory type using a buddy allocator
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	class MemoryAllocator;
+	struct MemoryBlock;
+
+	/** @brief What an allocation is used for, allocations are counted per category */
+	enum class MemoryCategory : uint32_t
+	{
+		Other,
+		Vertex,
+		Index,
+		Uniform,
+		Texture,
+		Staging,
+		Overlay,
+		Count,
+		/** @brief Only accepted by VulkanDevice::createBuffer, derives the category from the buffer usage flags */
+		Auto = Count
+	};
+
+	const char *getMemoryCategoryName(MemoryCategory category);
+
+	/** @brief Range of device memory handed out by the MemoryAllocator */
+	struct MemoryAllocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		/** @brief Offset of the allocation inside memory, resources must be bound at this offset */
+		VkDeviceSize offset = 0;
+		/** @brief Size of the allocation, may be larger than the requested size */
+		VkDeviceSize size = 0;
+		/** @brief Persistently mapped pointer to the start of the allocation, nullptr for memory that isn't host visible */
+		void *mapped = nullptr;
+		uint32_t memoryTypeIndex = 0;
+		/** @brief Allocator the memory has been taken from, nullptr for empty allocations */
+		MemoryAllocator *allocator = nullptr;
+		/** @brief Block the allocation is part of, nullptr for dedicated allocations */
+		MemoryBlock *block = nullptr;
+		/** @brief Buddy order of the allocation inside its block */
+		uint32_t order = 0;
+		VkDeviceSize requestedSize = 0;
+		MemoryCategory category = MemoryCategory::Other;
+	};
+
+	/** @brief Allocation counters for a memory type or for all memory types */
+	struct MemoryStats
+	{
+		/** @brief Number of vkAllocateMemory allocations (blocks and dedicated allocations) alive */
+		uint32_t deviceMemoryCount = 0;
+		uint32_t blockCount = 0;
+		uint32_t dedicatedAllocationCount = 0;
+		/** @brief Number of allocations handed out */
+		uint32_t allocationCount = 0;
+		/** @brief Device memory allocated from the driver */
+		VkDeviceSize reservedBytes = 0;
+		/** @brief Memory handed out, including the rounding to buddy sizes */
+		VkDeviceSize allocatedBytes = 0;
+		/** @brief Memory actually requested by the resources */
+		VkDeviceSize requestedBytes = 0;
+		/** @brief Size of the largest free range inside a block */
+		VkDeviceSize largestFreeRange = 0;
+	};
+
+	/** @brief Allocation counters for a memory category */
+	struct MemoryCategoryStats
+	{
+		uint32_t allocationCount = 0;
+		/** @brief Memory handed out, including the rounding to buddy sizes */
+		VkDeviceSize allocatedBytes = 0;
+		VkDeviceSize requestedBytes = 0;
+		/** @brief Part of allocatedBytes taken from device local memory types */
+		VkDeviceSize deviceLocalBytes = 0;
+		/** @brief Highest allocatedBytes since the allocator has been initialized */
+		VkDeviceSize peakAllocatedBytes = 0;
+	};
+
+	struct MemoryStatistics
+	{
+		MemoryStats total;
+		MemoryStats memoryTypes[VK_MAX_MEMORY_TYPES];
+		MemoryCategoryStats categories[static_cast<uint32_t>(MemoryCategory::Count)];
+	};
+
+	/** @brief Large device memory allocation that is split into power of two sized ranges */
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint8_t *mapped = nullptr;
+		uint32_t memoryTypeIndex = 0;
+		bool linear = true;
+		/** @brief Offsets of the free ranges per order, a range of order n has a size of minAllocationSize << n */
+		std::vector<std::set<VkDeviceSize>> freeRanges;
+		uint32_t allocationCount = 0;
+		VkDeviceSize allocatedBytes = 0;
+		VkDeviceSize requestedBytes = 0;
+	};
+
+	class MemoryAllocator
+	{
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		VkDeviceSize nonCoherentAtomSize = 1;
+		std::mutex mutex;
+		/** @brief Blocks per memory type, buffers and linear images (index 0) are kept apart from optimal tiled images (index 1) so bufferImageGranularity never applies */
+		std::vector<std::unique_ptr<MemoryBlock>> blocks[VK_MAX_MEMORY_TYPES][2];
+		/** @brief Counters of the dedicated allocations per memory type */
+		MemoryStats dedicatedStats[VK_MAX_MEMORY_TYPES];
+		MemoryCategoryStats categoryStats[static_cast<uint32_t>(MemoryCategory::Count)];
+
+		VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+		uint32_t getOrder(VkDeviceSize size) const;
+		VkResult allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, const void *pNext, VkDeviceMemory *memory, void **mapped);
+		bool allocateFromBlock(MemoryBlock &block, uint32_t order, VkDeviceSize *offset);
+		void freeInBlock(MemoryBlock &block, VkDeviceSize offset, uint32_t order);
+		void addToCategory(const MemoryAllocation &allocation);
+	public:
+		/** @brief Smallest range handed out, also keeps sub-allocations aligned to nonCoherentAtomSize */
+		static const VkDeviceSize minAllocationSize = 256;
+		/** @brief Preferred size of a memory block, smaller heaps use smaller blocks */
+		VkDeviceSize preferredBlockSize = 64 * 1024 * 1024;
+
+		MemoryAllocator() = default;
+		~MemoryAllocator();
+		MemoryAllocator(const MemoryAllocator&) = delete;
+		MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+		void init(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, const VkPhysicalDeviceLimits &limits);
+		/** @brief Frees all device memory, resources still bound to it must have been destroyed before */
+		void destroy();
+
+		/**
+		* @brief Allocates memory for the given requirements
+		* @param linear True for buffers and linear tiled images, false for optimal tiled images
+		* @param category Category the allocation is counted in
+		* @param dedicated Forces a separate device memory allocation, e.g. for allocations that need pNext structures
+		*/
+		VkResult allocate(const VkMemoryRequirements &memoryRequirements, uint32_t memoryTypeIndex, bool linear, MemoryCategory category, MemoryAllocation *allocation, bool dedicated = false, const void *pNext = nullptr);
+		/** @brief Returns the allocation to its block (or frees a dedicated allocation) and resets it */
+		void free(MemoryAllocation &allocation);
+
+		MemoryStatistics getStatistics();
+		VkDeviceSize getNonCoherentAtomSize() const { return nonCoherentAtomSize; }
+	};
+}
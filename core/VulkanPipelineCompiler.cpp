@@ -0,0 +1,151 @@
+/*
+* Vulkan pipeline compiler
+*
+* Compiles graphics pipelines on the job system so that pipeline creation doesn't block the first frame
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPipelineCompiler.h"
+
+#include <algorithm>
+#include <assert.h>
+#include "VulkanTools.h"
+
+namespace vks
+{
+	GraphicsPipelineDesc::GraphicsPipelineDesc(const VkGraphicsPipelineCreateInfo &createInfo)
+	{
+		assert(createInfo.pNext == nullptr);
+		pipelineCreateInfo = createInfo;
+
+		// Shader stages, including optional specialization constants
+		stages.assign(createInfo.pStages, createInfo.pStages + createInfo.stageCount);
+		specializationInfos.resize(stages.size());
+		specializationMapEntries.resize(stages.size());
+		specializationData.resize(stages.size());
+		for (size_t i = 0; i < stages.size(); i++) {
+			const VkSpecializationInfo *specializationInfo = stages[i].pSpecializationInfo;
+			if (!specializationInfo) {
+				continue;
+			}
+			specializationMapEntries[i].assign(specializationInfo->pMapEntries, specializationInfo->pMapEntries + specializationInfo->mapEntryCount);
+			const uint8_t *data = static_cast<const uint8_t*>(specializationInfo->pData);
+			specializationData[i].assign(data, data + specializationInfo->dataSize);
+			specializationInfos[i] = *specializationInfo;
+			specializationInfos[i].pMapEntries = specializationMapEntries[i].data();
+			specializationInfos[i].pData = specializationData[i].data();
+			stages[i].pSpecializationInfo = &specializationInfos[i];
+		}
+		pipelineCreateInfo.pStages = stages.data();
+
+		if (createInfo.pVertexInputState) {
+			vertexInputState = *createInfo.pVertexInputState;
+			vertexBindings.assign(vertexInputState.pVertexBindingDescriptions, vertexInputState.pVertexBindingDescriptions + vertexInputState.vertexBindingDescriptionCount);
+			vertexAttributes.assign(vertexInputState.pVertexAttributeDescriptions, vertexInputState.pVertexAttributeDescriptions + vertexInputState.vertexAttributeDescriptionCount);
+			vertexInputState.pVertexBindingDescriptions = vertexBindings.data();
+			vertexInputState.pVertexAttributeDescriptions = vertexAttributes.data();
+			pipelineCreateInfo.pVertexInputState = &vertexInputState;
+		}
+		if (createInfo.pInputAssemblyState) {
+			inputAssemblyState = *createInfo.pInputAssemblyState;
+			pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+		}
+		if (createInfo.pViewportState) {
+			// Viewports and scissors are expected to be dynamic
+			assert(createInfo.pViewportState->pViewports == nullptr && createInfo.pViewportState->pScissors == nullptr);
+			viewportState = *createInfo.pViewportState;
+			pipelineCreateInfo.pViewportState = &viewportState;
+		}
+		if (createInfo.pRasterizationState) {
+			rasterizationState = *createInfo.pRasterizationState;
+			pipelineCreateInfo.pRasterizationState = &rasterizationState;
+		}
+		if (createInfo.pMultisampleState) {
+			assert(createInfo.pMultisampleState->pSampleMask == nullptr);
+			multisampleState = *createInfo.pMultisampleState;
+			pipelineCreateInfo.pMultisampleState = &multisampleState;
+		}
+		if (createInfo.pDepthStencilState) {
+			depthStencilState = *createInfo.pDepthStencilState;
+			pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+		}
+		if (createInfo.pColorBlendState) {
+			colorBlendState = *createInfo.pColorBlendState;
+			blendAttachments.assign(colorBlendState.pAttachments, colorBlendState.pAttachments + colorBlendState.attachmentCount);
+			colorBlendState.pAttachments = blendAttachments.data();
+			pipelineCreateInfo.pColorBlendState = &colorBlendState;
+		}
+		if (createInfo.pDynamicState) {
+			dynamicState = *createInfo.pDynamicState;
+			dynamicStates.assign(dynamicState.pDynamicStates, dynamicState.pDynamicStates + dynamicState.dynamicStateCount);
+			dynamicState.pDynamicStates = dynamicStates.data();
+			pipelineCreateInfo.pDynamicState = &dynamicState;
+		}
+		// Tessellation is not used by any of the pipelines
+		assert(createInfo.pTessellationState == nullptr);
+	}
+
+	bool AsyncPipeline::ready() const
+	{
+		return !job || job->finished;
+	}
+
+	VkPipeline AsyncPipeline::get(VkPipeline fallback) const
+	{
+		return ready() ? pipeline : fallback;
+	}
+
+	VkPipeline AsyncPipeline::wait()
+	{
+		if (job) {
+			jobSystem->wait(job);
+		}
+		return pipeline;
+	}
+
+	void AsyncPipeline::destroy()
+	{
+		wait();
+		if (pipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipeline, nullptr);
+			pipeline = VK_NULL_HANDLE;
+		}
+	}
+
+	PipelineCompiler::PipelineCompiler(VkDevice device, VkPipelineCache pipelineCache, JobSystem &jobSystem) : device(device), pipelineCache(pipelineCache), jobSystem(jobSystem)
+	{
+	}
+
+	PipelineCompiler::~PipelineCompiler()
+	{
+		waitIdle();
+	}
+
+	AsyncPipelineHandle PipelineCompiler::compile(const VkGraphicsPipelineCreateInfo &createInfo)
+	{
+		// Drop finished compilations
+		pending.erase(std::remove_if(pending.begin(), pending.end(), [](const AsyncPipelineHandle &handle) { return handle->ready(); }), pending.end());
+
+		std::shared_ptr<GraphicsPipelineDesc> desc = std::make_shared<GraphicsPipelineDesc>(createInfo);
+		AsyncPipelineHandle handle = std::make_shared<AsyncPipeline>();
+		handle->device = device;
+		handle->jobSystem = &jobSystem;
+		// The pending list keeps the handle alive until the job has finished
+		AsyncPipeline *target = handle.get();
+		// Pipeline caches are internally synchronized, so all workers can compile against the shared cache
+		handle->job = jobSystem.schedule([this, desc, target] {
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &desc->pipelineCreateInfo, nullptr, &target->pipeline));
+		});
+		pending.push_back(handle);
+		return handle;
+	}
+
+	void PipelineCompiler::waitIdle()
+	{
+		for (auto &handle : pending) {
+			handle->wait();
+		}
+		pending.clear();
+	}
+}
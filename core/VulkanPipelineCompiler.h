@@ -0,0 +1,84 @@
+/*
+* Vulkan pipeline compiler
+*
+* Compiles graphics pipelines on the job system so that pipeline creation doesn't block the first frame
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "JobSystem.h"
+
+namespace vks
+{
+	/**
+	* @brief Self-contained copy of a graphics pipeline description that stays valid after the create info it was taken from went out of scope
+	* @note Extension structures (pNext chains) are not supported, shader modules, layout and render pass must stay alive until the pipeline has been compiled
+	*/
+	struct GraphicsPipelineDesc
+	{
+		std::vector<VkPipelineShaderStageCreateInfo> stages;
+		std::vector<VkSpecializationInfo> specializationInfos;
+		std::vector<std::vector<VkSpecializationMapEntry>> specializationMapEntries;
+		std::vector<std::vector<uint8_t>> specializationData;
+		std::vector<VkVertexInputBindingDescription> vertexBindings;
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+		VkPipelineVertexInputStateCreateInfo vertexInputState{};
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{};
+		VkPipelineViewportStateCreateInfo viewportState{};
+		VkPipelineRasterizationStateCreateInfo rasterizationState{};
+		VkPipelineMultisampleStateCreateInfo multisampleState{};
+		VkPipelineDepthStencilStateCreateInfo depthStencilState{};
+		std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+		VkPipelineColorBlendStateCreateInfo colorBlendState{};
+		std::vector<VkDynamicState> dynamicStates;
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		VkGraphicsPipelineCreateInfo pipelineCreateInfo{};
+
+		explicit GraphicsPipelineDesc(const VkGraphicsPipelineCreateInfo &createInfo);
+		GraphicsPipelineDesc(const GraphicsPipelineDesc&) = delete;
+		GraphicsPipelineDesc& operator=(const GraphicsPipelineDesc&) = delete;
+	};
+
+	/** @brief Pipeline that is compiled in the background, the handle is VK_NULL_HANDLE until the compilation job has finished */
+	struct AsyncPipeline
+	{
+		VkDevice device = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		JobHandle job;
+		JobSystem *jobSystem = nullptr;
+
+		/** @brief Returns true once the pipeline can be used */
+		bool ready() const;
+		/** @brief Returns the compiled pipeline, or the given fallback while it's still being compiled */
+		VkPipeline get(VkPipeline fallback = VK_NULL_HANDLE) const;
+		/** @brief Blocks until the pipeline has been compiled (helping with other jobs in the meantime) */
+		VkPipeline wait();
+		/** @brief Waits for a pending compilation and destroys the pipeline */
+		void destroy();
+	};
+	typedef std::shared_ptr<AsyncPipeline> AsyncPipelineHandle;
+
+	class PipelineCompiler
+	{
+	private:
+		VkDevice device;
+		VkPipelineCache pipelineCache;
+		JobSystem &jobSystem;
+		/** @brief Compilations that may still be running, only touched by the thread that owns the compiler */
+		std::vector<AsyncPipelineHandle> pending;
+	public:
+		PipelineCompiler(VkDevice device, VkPipelineCache pipelineCache, JobSystem &jobSystem = JobSystem::instance());
+		/** @brief Waits for all pending compilations, the pipelines themselves are owned by the returned handles */
+		~PipelineCompiler();
+		/** @brief Takes a copy of the create info and compiles the pipeline against the shared pipeline cache on a worker thread */
+		AsyncPipelineHandle compile(const VkGraphicsPipelineCreateInfo &createInfo);
+		/** @brief Blocks until all pipelines scheduled so far have been compiled */
+		void waitIdle();
+	};
+}
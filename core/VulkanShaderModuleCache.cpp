@@ -0,0 +1,144 @@
+/*
+* Vulkan shader module cache
+*
+* Loads SPIR-V through memory mapped files and shares modules with identical code, modules are reference counted
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanShaderModuleCache.h"
+
+#include <assert.h>
+#include <iostream>
+#include "MappedFile.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	ShaderModuleCache::~ShaderModuleCache()
+	{
+		clear();
+	}
+
+	void ShaderModuleCache::setDevice(VkDevice device)
+	{
+		this->device = device;
+	}
+
+	VkShaderModule ShaderModuleCache::acquireLocked(const uint32_t *code, size_t size, uint64_t hash, const std::string &fileName)
+	{
+		auto existing = modulesByHash.find(hash);
+		if ((existing != modulesByHash.end()) && (entries[existing->second].codeSize == size)) {
+			entries[existing->second].refCount++;
+			if (!fileName.empty()) {
+				modulesByFile[fileName] = existing->second;
+			}
+			return existing->second;
+		}
+
+		VkShaderModuleCreateInfo moduleCreateInfo{};
+		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleCreateInfo.codeSize = size;
+		moduleCreateInfo.pCode = code;
+		VkShaderModule module;
+		VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, nullptr, &module));
+
+		Entry entry;
+		entry.hash = hash;
+		entry.codeSize = size;
+		entry.refCount = 1;
+		entries[module] = entry;
+		// A (very unlikely) hash collision with different code keeps the first module as the shared one
+		if (existing == modulesByHash.end()) {
+			modulesByHash[hash] = module;
+		}
+		if (!fileName.empty()) {
+			modulesByFile[fileName] = module;
+		}
+		return module;
+	}
+
+	VkShaderModule ShaderModuleCache::acquire(const uint32_t *code, size_t size, const std::string &fileName)
+	{
+		assert(device != VK_NULL_HANDLE);
+		const uint32_t spirvMagic = 0x07230203;
+		if ((size < sizeof(uint32_t)) || (size % sizeof(uint32_t) != 0) || (code[0] != spirvMagic)) {
+			std::cerr << "Error: \"" << fileName << "\" does not contain valid SPIR-V" << "\n";
+			return VK_NULL_HANDLE;
+		}
+		const uint64_t hash = vks::tools::hashData(code, size);
+		std::lock_guard<std::mutex> lock(mutex);
+		return acquireLocked(code, size, hash, fileName);
+	}
+
+	VkShaderModule ShaderModuleCache::acquireFile(const std::string &fileName)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto loaded = modulesByFile.find(fileName);
+			if (loaded != modulesByFile.end()) {
+				entries[loaded->second].refCount++;
+				return loaded->second;
+			}
+		}
+		// Mapped pages are page aligned, so the SPIR-V words can be passed to the driver without copying them first
+		MappedFile file;
+		if (!file.open(fileName)) {
+			std::cerr << "Error: Could not open shader file \"" << fileName << "\"" << "\n";
+			return VK_NULL_HANDLE;
+		}
+		return acquire(reinterpret_cast<const uint32_t*>(file.data()), file.size(), fileName);
+	}
+
+	void ShaderModuleCache::addRef(VkShaderModule module)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto entry = entries.find(module);
+		assert(entry != entries.end());
+		entry->second.refCount++;
+	}
+
+	void ShaderModuleCache::release(VkShaderModule module)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto entry = entries.find(module);
+		if (entry == entries.end()) {
+			return;
+		}
+		assert(entry->second.refCount > 0);
+		if (--entry->second.refCount > 0) {
+			return;
+		}
+		auto byHash = modulesByHash.find(entry->second.hash);
+		if ((byHash != modulesByHash.end()) && (byHash->second == module)) {
+			modulesByHash.erase(byHash);
+		}
+		for (auto byFile = modulesByFile.begin(); byFile != modulesByFile.end();) {
+			if (byFile->second == module) {
+				byFile = modulesByFile.erase(byFile);
+			}
+			else {
+				++byFile;
+			}
+		}
+		vkDestroyShaderModule(device, module, nullptr);
+		entries.erase(entry);
+	}
+
+	void ShaderModuleCache::clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &entry : entries) {
+			vkDestroyShaderModule(device, entry.first, nullptr);
+		}
+		entries.clear();
+		modulesByHash.clear();
+		modulesByFile.clear();
+	}
+
+	size_t ShaderModuleCache::size()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries.size();
+	}
+}
@@ -0,0 +1,57 @@
+/*
+* Vulkan shader module cache
+*
+* Loads SPIR-V through memory mapped files and shares modules with identical code, modules are reference counted
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	class ShaderModuleCache
+	{
+	private:
+		struct Entry
+		{
+			uint64_t hash;
+			size_t codeSize;
+			uint32_t refCount;
+		};
+		VkDevice device = VK_NULL_HANDLE;
+		std::mutex mutex;
+		std::unordered_map<VkShaderModule, Entry> entries;
+		/** @brief Modules by hash of their SPIR-V code */
+		std::unordered_map<uint64_t, VkShaderModule> modulesByHash;
+		/** @brief Modules by the file they have been loaded from, avoids repeated file access for the same shader */
+		std::unordered_map<std::string, VkShaderModule> modulesByFile;
+
+		VkShaderModule acquireLocked(const uint32_t *code, size_t size, uint64_t hash, const std::string &fileName);
+	public:
+		ShaderModuleCache() = default;
+		~ShaderModuleCache();
+		ShaderModuleCache(const ShaderModuleCache&) = delete;
+		ShaderModuleCache& operator=(const ShaderModuleCache&) = delete;
+
+		void setDevice(VkDevice device);
+		/** @brief Returns a module for the given SPIR-V code, creating it only if no module with identical code exists */
+		VkShaderModule acquire(const uint32_t *code, size_t size, const std::string &fileName = "");
+		/** @brief Returns a module for the given SPIR-V file, the file is memory mapped and only read if it hasn't been loaded before */
+		VkShaderModule acquireFile(const std::string &fileName);
+		/** @brief Adds a reference to a module returned by acquire() */
+		void addRef(VkShaderModule module);
+		/** @brief Drops a reference, the module is destroyed once it's no longer used */
+		void release(VkShaderModule module);
+		/** @brief Destroys all modules regardless of their reference counts */
+		void clear();
+		/** @brief Number of distinct modules alive */
+		size_t size();
+	};
+}
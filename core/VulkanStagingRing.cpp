@@ -0,0 +1,240 @@
+/*
+* Vulkan staging ring
+*
+* Persistently mapped staging buffer that is used as a ring, uploads are recorded into batches that are submitted together and retired by fences
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanStagingRing.h"
+
+#include <assert.h>
+#include <string.h>
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	StagingRing::~StagingRing()
+	{
+		destroy();
+	}
+
+	void StagingRing::create(VulkanDevice *device, VkDeviceSize size, uint32_t queueFamilyIndex)
+	{
+		assert(this->device == nullptr);
+		this->device = device;
+		this->size = size;
+		head = tail = 0;
+		commandPool = device->createCommandPool(queueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size);
+		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &buffer));
+		VK_CHECK_RESULT(device->allocateBufferMemory(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &memory, vks::MemoryCategory::Staging));
+	}
+
+	void StagingRing::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		waitIdle();
+		for (auto batch : freeBatches) {
+			vkDestroyFence(device->logicalDevice, batch->fence, nullptr);
+			delete batch;
+		}
+		freeBatches.clear();
+		// Command buffers are freed along with the pool
+		vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+		vkDestroyBuffer(device->logicalDevice, buffer, nullptr);
+		device->freeMemory(memory);
+		commandPool = VK_NULL_HANDLE;
+		buffer = VK_NULL_HANDLE;
+		device = nullptr;
+	}
+
+	StagingRing::Batch *StagingRing::beginBatch(VkQueue queue)
+	{
+		assert(recording == nullptr);
+		Batch *batch;
+		if (!freeBatches.empty()) {
+			batch = freeBatches.back();
+			freeBatches.pop_back();
+		}
+		else {
+			batch = new Batch();
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device->logicalDevice, &cmdBufAllocateInfo, &batch->commandBuffer));
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(0);
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &batch->fence));
+		}
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(batch->commandBuffer, &cmdBufInfo));
+		batch->queue = queue;
+		recording = batch;
+		return batch;
+	}
+
+	void StagingRing::retire(Batch *batch)
+	{
+		// Batches finish in submission order, so everything up to the end of this batch can be reused
+		tail = batch->end;
+		for (size_t i = 0; i < batch->oversizedBuffers.size(); i++) {
+			vkDestroyBuffer(device->logicalDevice, batch->oversizedBuffers[i], nullptr);
+			device->freeMemory(batch->oversizedMemory[i]);
+		}
+		batch->oversizedBuffers.clear();
+		batch->oversizedMemory.clear();
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &batch->fence));
+		freeBatches.push_back(batch);
+	}
+
+	void StagingRing::retireBatches(VkDeviceSize requiredSpace)
+	{
+		while (!inFlight.empty()) {
+			Batch *batch = inFlight.front();
+			if (head - tail + requiredSpace > size) {
+				VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &batch->fence, VK_TRUE, UINT64_MAX));
+			}
+			else if (vkGetFenceStatus(device->logicalDevice, batch->fence) != VK_SUCCESS) {
+				break;
+			}
+			inFlight.pop_front();
+			retire(batch);
+		}
+	}
+
+	StagingRegion StagingRing::allocate(VkQueue queue, VkDeviceSize size, VkDeviceSize alignment)
+	{
+		assert(device);
+		assert(alignment > 0);
+		if (recording && (recording->queue != queue)) {
+			submit();
+		}
+
+		StagingRegion region;
+		region.size = size;
+
+		// Uploads that don't fit into the ring get a temporary buffer that is freed along with the batch
+		if (size > this->size) {
+			Batch *batch = recording ? recording : beginBatch(queue);
+			VkBuffer oversizedBuffer;
+			MemoryAllocation oversizedMemory;
+			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size);
+			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &oversizedBuffer));
+			VK_CHECK_RESULT(device->allocateBufferMemory(oversizedBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &oversizedMemory, vks::MemoryCategory::Staging));
+			batch->oversizedBuffers.push_back(oversizedBuffer);
+			batch->oversizedMemory.push_back(oversizedMemory);
+			region.buffer = oversizedBuffer;
+			region.mapped = oversizedMemory.mapped;
+			return region;
+		}
+
+		VkDeviceSize offset;
+		while (true) {
+			const VkDeviceSize position = head % this->size;
+			offset = ((position + alignment - 1) / alignment) * alignment;
+			// Regions never wrap around, the remainder of the ring is skipped instead
+			if (offset + size > this->size) {
+				offset = 0;
+			}
+			const VkDeviceSize padding = (offset >= position) ? offset - position : this->size - position;
+			if (head + padding + size - tail <= this->size) {
+				head += padding + size;
+				break;
+			}
+			if (!inFlight.empty()) {
+				retireBatches(padding + size);
+			}
+			else if (recording) {
+				// The space is taken by uploads that haven't been submitted yet
+				submit();
+			}
+			else {
+				// Nothing is in use, restart at the beginning of the ring
+				head = tail = ((head + this->size - 1) / this->size) * this->size;
+			}
+		}
+
+		if (!recording) {
+			beginBatch(queue);
+		}
+		region.buffer = buffer;
+		region.offset = offset;
+		region.mapped = static_cast<uint8_t*>(memory.mapped) + offset;
+		return region;
+	}
+
+	StagingRegion StagingRing::upload(VkQueue queue, const void *data, VkDeviceSize size, VkDeviceSize alignment)
+	{
+		StagingRegion region = allocate(queue, size, alignment);
+		memcpy(region.mapped, data, size);
+		return region;
+	}
+
+	VkCommandBuffer StagingRing::getCommandBuffer(VkQueue queue)
+	{
+		assert(device);
+		if (recording && (recording->queue != queue)) {
+			submit();
+		}
+		if (!recording) {
+			beginBatch(queue);
+		}
+		return recording->commandBuffer;
+	}
+
+	bool StagingRing::submit(VkSemaphore signalSemaphore, uint64_t signalValue)
+	{
+		if (!recording) {
+			return false;
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(recording->commandBuffer));
+		recording->end = head;
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &recording->commandBuffer;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		if (signalSemaphore != VK_NULL_HANDLE) {
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &signalSemaphore;
+			timelineInfo.signalSemaphoreValueCount = 1;
+			timelineInfo.pSignalSemaphoreValues = &signalValue;
+		}
+		if (!waitSemaphores.empty() || (signalSemaphore != VK_NULL_HANDLE)) {
+			timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+			timelineInfo.pWaitSemaphoreValues = waitValues.data();
+			submitInfo.pNext = &timelineInfo;
+		}
+		VK_CHECK_RESULT(vkQueueSubmit(recording->queue, 1, &submitInfo, recording->fence));
+		waitSemaphores.clear();
+		waitValues.clear();
+		waitStages.clear();
+		inFlight.push_back(recording);
+		recording = nullptr;
+		// Recycle whatever has already finished, without waiting
+		retireBatches(0);
+		return true;
+	}
+
+	void StagingRing::addWaitSemaphore(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags waitStage)
+	{
+		waitSemaphores.push_back(semaphore);
+		waitValues.push_back(value);
+		waitStages.push_back(waitStage);
+	}
+
+	void StagingRing::waitIdle()
+	{
+		submit();
+		while (!inFlight.empty()) {
+			Batch *batch = inFlight.front();
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &batch->fence, VK_TRUE, UINT64_MAX));
+			inFlight.pop_front();
+			retire(batch);
+		}
+	}
+}
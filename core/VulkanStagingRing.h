@@ -0,0 +1,99 @@
+/*
+* Vulkan staging ring
+*
+* Persistently mapped staging buffer that is used as a ring, uploads are recorded into batches that are submitted together and retired by fences
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanMemoryAllocator.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/** @brief Part of the staging ring (or of a temporary buffer for uploads larger than the ring) to copy upload data into */
+	struct StagingRegion
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		/** @brief Offset of the region in buffer, to be added to the source offsets of the copy commands */
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void *mapped = nullptr;
+	};
+
+	class StagingRing
+	{
+	private:
+		/** @brief Uploads that are submitted together, the ring space up to end is reused once the fence has been signaled */
+		struct Batch
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			VkQueue queue = VK_NULL_HANDLE;
+			VkDeviceSize end = 0;
+			/** @brief Temporary staging buffers for uploads that didn't fit into the ring */
+			std::vector<VkBuffer> oversizedBuffers;
+			std::vector<MemoryAllocation> oversizedMemory;
+		};
+
+		VulkanDevice *device = nullptr;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		MemoryAllocation memory;
+		VkDeviceSize size = 0;
+		/** @brief Total number of bytes handed out and retired, the ring positions are these modulo size */
+		VkDeviceSize head = 0;
+		VkDeviceSize tail = 0;
+		/** @brief Batch recording commands, null until the first upload after a submit */
+		Batch *recording = nullptr;
+		std::deque<Batch*> inFlight;
+		std::vector<Batch*> freeBatches;
+		/** @brief Semaphores the next submitted batch waits on */
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<uint64_t> waitValues;
+		std::vector<VkPipelineStageFlags> waitStages;
+
+		Batch *beginBatch(VkQueue queue);
+		void retire(Batch *batch);
+		/** @brief Retires finished batches, waiting for the oldest ones until at least requiredSpace bytes are free */
+		void retireBatches(VkDeviceSize requiredSpace);
+	public:
+		StagingRing() = default;
+		~StagingRing();
+		StagingRing(const StagingRing&) = delete;
+		StagingRing& operator=(const StagingRing&) = delete;
+
+		/** @brief Creates the ring, the command buffers are allocated for queues of the given family */
+		void create(VulkanDevice *device, VkDeviceSize size, uint32_t queueFamilyIndex);
+		/** @brief Waits for all uploads and frees the ring */
+		void destroy();
+
+		/**
+		* @brief Reserves space for an upload to the given queue
+		* @param alignment Alignment of the region's offset, doesn't have to be a power of two (image copies need multiples of the texel block size)
+		* @note May submit the batch that is being recorded to make space, so the copies for a region have to be recorded (with getCommandBuffer) before allocating the next one
+		*/
+		StagingRegion allocate(VkQueue queue, VkDeviceSize size, VkDeviceSize alignment = 16);
+		/** @brief Reserves space for an upload and copies the data into it */
+		StagingRegion upload(VkQueue queue, const void *data, VkDeviceSize size, VkDeviceSize alignment = 16);
+		/** @brief Command buffer of the batch for the given queue, valid until the next call to allocate() or submit() */
+		VkCommandBuffer getCommandBuffer(VkQueue queue);
+		/**
+		* @brief Submits the recorded uploads without waiting for them, later submissions to the same queue see their results
+		* @param signalSemaphore (Optional) Timeline semaphore that is set to signalValue once the batch has finished
+		* @return False if there was nothing to submit (the semaphore isn't signaled then)
+		*/
+		bool submit(VkSemaphore signalSemaphore = VK_NULL_HANDLE, uint64_t signalValue = 0);
+		/** @brief Makes the next submitted batch wait until the timeline semaphore has reached value */
+		void addWaitSemaphore(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags waitStage);
+		/** @brief Submits the recorded uploads and waits until all uploads have finished */
+		void waitIdle();
+	};
+}
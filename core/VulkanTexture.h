@@ -35,6 +35,7 @@ class Texture
 	VkImage               image;
 	VkImageLayout         imageLayout;
 	VkDeviceMemory        deviceMemory;
+	vks::MemoryAllocation allocation;
 	VkImageView           view;
 	uint32_t              width, height;
 	uint32_t              mipLevels;
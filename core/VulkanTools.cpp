@@ -7,6 +7,7 @@
 */
 
 #include "VulkanTools.h"
+#include "MappedFile.h"
 
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 // iOS & macOS: VulkanExampleBase::getAssetPath() implemented externally to allow access to Objective-C components
@@ -356,28 +357,22 @@ namespace vks
 #else
 		VkShaderModule loadShader(const char *fileName, VkDevice device)
 		{
-			std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
+			// The SPIR-V is passed to the driver straight from the mapped file
+			vks::MappedFile file;
 
-			if (is.is_open())
+			if (file.open(fileName))
 			{
-				size_t size = is.tellg();
-				is.seekg(0, std::ios::beg);
-				char* shaderCode = new char[size];
-				is.read(shaderCode, size);
-				is.close();
-
+				size_t size = file.size();
 				assert(size > 0);
 
 				VkShaderModule shaderModule;
 				VkShaderModuleCreateInfo moduleCreateInfo{};
 				moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 				moduleCreateInfo.codeSize = size;
-				moduleCreateInfo.pCode = (uint32_t*)shaderCode;
+				moduleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(file.data());
 
 				VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
 
-				delete[] shaderCode;
-
 				return shaderModule;
 			}
 			else
@@ -399,5 +394,131 @@ namespace vks
 	        return (value + alignment - 1) & ~(alignment - 1);
         }
 
+		uint64_t hashData(const void *data, size_t size, uint64_t seed)
+		{
+			const uint8_t *bytes = static_cast<const uint8_t*>(data);
+			uint64_t hash = seed;
+			for (size_t i = 0; i < size; i++) {
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+			return hash;
+		}
+
+		bool savePPM(const std::string &filename, uint32_t width, uint32_t height, const uint8_t *rgba)
+		{
+			std::ofstream file(filename, std::ios::out | std::ios::binary);
+			if (!file.is_open()) {
+				std::cerr << "Error: Could not open \"" << filename << "\" for writing" << "\n";
+				return false;
+			}
+			file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
+			std::vector<uint8_t> row(width * 3);
+			for (uint32_t y = 0; y < height; y++) {
+				const uint8_t *src = rgba + (size_t)y * width * 4;
+				for (uint32_t x = 0; x < width; x++) {
+					row[x * 3 + 0] = src[x * 4 + 0];
+					row[x * 3 + 1] = src[x * 4 + 1];
+					row[x * 3 + 2] = src[x * 4 + 2];
+				}
+				file.write((const char*)row.data(), row.size());
+			}
+			return file.good();
+		}
+
+		namespace
+		{
+			uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size)
+			{
+				static uint32_t table[256] = {};
+				if (table[1] == 0) {
+					for (uint32_t n = 0; n < 256; n++) {
+						uint32_t c = n;
+						for (uint32_t k = 0; k < 8; k++) {
+							c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+						}
+						table[n] = c;
+					}
+				}
+				crc = ~crc;
+				for (size_t i = 0; i < size; i++) {
+					crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+				}
+				return ~crc;
+			}
+
+			void writeBigEndian(std::vector<uint8_t> &out, uint32_t value)
+			{
+				out.push_back((value >> 24) & 0xff);
+				out.push_back((value >> 16) & 0xff);
+				out.push_back((value >> 8) & 0xff);
+				out.push_back(value & 0xff);
+			}
+
+			void writePNGChunk(std::ofstream &file, const char *type, const std::vector<uint8_t> &data)
+			{
+				std::vector<uint8_t> chunk;
+				writeBigEndian(chunk, static_cast<uint32_t>(data.size()));
+				chunk.insert(chunk.end(), type, type + 4);
+				chunk.insert(chunk.end(), data.begin(), data.end());
+				// The CRC covers chunk type and data
+				writeBigEndian(chunk, crc32(0, chunk.data() + 4, chunk.size() - 4));
+				file.write((const char*)chunk.data(), chunk.size());
+			}
+		}
+
+		bool savePNG(const std::string &filename, uint32_t width, uint32_t height, const uint8_t *rgba)
+		{
+			std::ofstream file(filename, std::ios::out | std::ios::binary);
+			if (!file.is_open()) {
+				std::cerr << "Error: Could not open \"" << filename << "\" for writing" << "\n";
+				return false;
+			}
+			const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+			file.write((const char*)signature, sizeof(signature));
+
+			std::vector<uint8_t> header;
+			writeBigEndian(header, width);
+			writeBigEndian(header, height);
+			// 8 bit RGB, default compression, filter and no interlacing
+			const uint8_t format[5] = { 8, 2, 0, 0, 0 };
+			header.insert(header.end(), format, format + 5);
+			writePNGChunk(file, "IHDR", header);
+
+			// Scanlines with filter type "none", stored in a zlib stream made of uncompressed deflate blocks
+			std::vector<uint8_t> raw;
+			raw.reserve((size_t)height * (width * 3 + 1));
+			for (uint32_t y = 0; y < height; y++) {
+				raw.push_back(0);
+				const uint8_t *src = rgba + (size_t)y * width * 4;
+				for (uint32_t x = 0; x < width; x++) {
+					raw.insert(raw.end(), src + x * 4, src + x * 4 + 3);
+				}
+			}
+			std::vector<uint8_t> zlib = { 0x78, 0x01 };
+			const size_t maxBlockSize = 65535;
+			for (size_t offset = 0; offset < raw.size() || offset == 0; offset += maxBlockSize) {
+				const size_t blockSize = std::min(maxBlockSize, raw.size() - offset);
+				const bool lastBlock = (offset + blockSize >= raw.size());
+				zlib.push_back(lastBlock ? 1 : 0);
+				zlib.push_back(blockSize & 0xff);
+				zlib.push_back((blockSize >> 8) & 0xff);
+				zlib.push_back(~blockSize & 0xff);
+				zlib.push_back((~blockSize >> 8) & 0xff);
+				zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+				if (lastBlock) {
+					break;
+				}
+			}
+			uint32_t a = 1, b = 0;
+			for (size_t i = 0; i < raw.size(); i++) {
+				a = (a + raw[i]) % 65521;
+				b = (b + a) % 65521;
+			}
+			writeBigEndian(zlib, (b << 16) | a);
+			writePNGChunk(file, "IDAT", zlib);
+			writePNGChunk(file, "IEND", std::vector<uint8_t>());
+			return file.good();
+		}
+
 	}
 }
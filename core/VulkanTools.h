@@ -130,5 +130,13 @@ namespace vks
 		bool fileExists(const std::string &filename);
 
 		uint32_t alignedSize(uint32_t value, uint32_t alignment);
+
+		/** @brief 64 bit FNV-1a hash of a block of memory */
+		uint64_t hashData(const void *data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+		/** @brief Writes tightly packed 8 bit RGBA pixels to a binary PPM file (alpha is dropped) */
+		bool savePPM(const std::string &filename, uint32_t width, uint32_t height, const uint8_t *rgba);
+		/** @brief Writes tightly packed 8 bit RGBA pixels to an uncompressed PNG file (alpha is dropped) */
+		bool savePNG(const std::string &filename, uint32_t width, uint32_t height, const uint8_t *rgba);
 	}
 }
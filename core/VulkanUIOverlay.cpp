@@ -102,13 +102,7 @@ namespace vks
 		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageInfo, nullptr, &fontImage));
-		VkMemoryRequirements memReqs;
-		vkGetImageMemoryRequirements(device->logicalDevice, fontImage, &memReqs);
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &fontMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, fontImage, fontMemory, 0));
+		VK_CHECK_RESULT(device->allocateImageMemory(fontImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &fontMemory, vks::MemoryCategory::Overlay));
 
 		// Image view
 		VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
@@ -120,21 +114,11 @@ namespace vks
 		viewInfo.subresourceRange.layerCount = 1;
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &fontView));
 
-		// Staging buffers for font data upload
-		vks::Buffer stagingBuffer;
+		// Font data is uploaded through the device's staging ring
+		vks::StagingRegion staging = device->stagingRing.upload(queue, fontData, uploadSize);
 
-		VK_CHECK_RESULT(device->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			uploadSize));
-
-		stagingBuffer.map();
-		memcpy(stagingBuffer.mapped, fontData, uploadSize);
-		stagingBuffer.unmap();
-
-		// Copy buffer data to font image
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		// Copy buffer data to font image, the upload is submitted along with other pending uploads
+		VkCommandBuffer copyCmd = device->stagingRing.getCommandBuffer(queue);
 
 		// Prepare for transfer
 		vks::tools::setImageLayout(
@@ -148,6 +132,7 @@ namespace vks
 
 		// Copy
 		VkBufferImageCopy bufferCopyRegion = {};
+		bufferCopyRegion.bufferOffset = staging.offset;
 		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		bufferCopyRegion.imageSubresource.layerCount = 1;
 		bufferCopyRegion.imageExtent.width = texWidth;
@@ -156,7 +141,7 @@ namespace vks
 
 		vkCmdCopyBufferToImage(
 			copyCmd,
-			stagingBuffer.buffer,
+			staging.buffer,
 			fontImage,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
@@ -173,10 +158,6 @@ namespace vks
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 
-		device->flushCommandBuffer(copyCmd, queue, true);
-
-		stagingBuffer.destroy();
-
 		// Font texture Sampler
 		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
 		samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -217,7 +198,7 @@ namespace vks
 	}
 
 	/** Prepare a separate pipeline for the UI overlay rendering decoupled from the main application */
-	void UIOverlay::preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass, const VkFormat colorFormat, const VkFormat depthFormat)
+	void UIOverlay::preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass, const VkFormat colorFormat, const VkFormat depthFormat, vks::PipelineCompiler *pipelineCompiler)
 	{
 		// Pipeline layout
 		// Push constants for UI rendering parameters
@@ -307,50 +288,86 @@ namespace vks
 
 		pipelineCreateInfo.pVertexInputState = &vertexInputState;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+		// Dynamic rendering needs the pNext chain, which can't be compiled in the background
+		if (pipelineCompiler && (pipelineCreateInfo.pNext == nullptr)) {
+			asyncPipeline = pipelineCompiler->compile(pipelineCreateInfo);
+		}
+		else {
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+		}
+	}
+
+	void UIOverlay::setImageCount(uint32_t imageCount)
+	{
+		for (size_t i = imageCount; i < imageBuffers.size(); i++) {
+			imageBuffers[i].vertexBuffer.destroy();
+			imageBuffers[i].indexBuffer.destroy();
+		}
+		imageBuffers.resize(imageCount);
 	}
 
-	/** Update vertex and index buffer containing the imGui elements when required */
-	bool UIOverlay::update()
+	uint64_t UIOverlay::drawCommandsHash() const
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
-		bool updateCmdBuffers = false;
+		if (!visible || (pipeline == VK_NULL_HANDLE) || !imDrawData || (imDrawData->TotalVtxCount == 0) || (imDrawData->TotalIdxCount == 0)) {
+			return 0;
+		}
+		// Vertex positions are uploaded every frame, only the values baked into the command buffer are hashed
+		const ImVec2 displaySize = ImGui::GetIO().DisplaySize;
+		uint64_t hash = vks::tools::hashData(&displaySize, sizeof(displaySize));
+		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++) {
+			const ImDrawList* cmd_list = imDrawData->CmdLists[i];
+			hash = vks::tools::hashData(&cmd_list->VtxBuffer.Size, sizeof(cmd_list->VtxBuffer.Size), hash);
+			for (int32_t j = 0; j < cmd_list->CmdBuffer.Size; j++) {
+				const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[j];
+				hash = vks::tools::hashData(&pcmd->ClipRect, sizeof(pcmd->ClipRect), hash);
+				hash = vks::tools::hashData(&pcmd->ElemCount, sizeof(pcmd->ElemCount), hash);
+			}
+		}
+		// 0 is reserved for "nothing drawn"
+		return (hash != 0) ? hash : 1;
+	}
 
-		if (!imDrawData) { return false; };
+	/** Update the vertex and index buffer of an image with the current imGui elements */
+	bool UIOverlay::update(uint32_t imageIndex)
+	{
+		// The overlay pipeline may have been compiled in the background
+		if (asyncPipeline && asyncPipeline->ready()) {
+			pipeline = asyncPipeline->pipeline;
+			asyncPipeline.reset();
+		}
 
+		ImageBuffers& buffers = imageBuffers[imageIndex];
+		const uint64_t hash = drawCommandsHash();
+		if (hash == 0) {
+			return buffers.recordedHash != 0;
+		}
+
+		ImDrawData* imDrawData = ImGui::GetDrawData();
 		// Note: Alignment is done inside buffer creation
 		VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
 		VkDeviceSize indexBufferSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
-
-		// Update buffers only if vertex or index count has been changed compared to current buffer size
-		if ((vertexBufferSize == 0) || (indexBufferSize == 0)) {
-			return false;
-		}
-
-		// Vertex buffer
-		if ((vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
-			vertexBuffer.unmap();
-			vertexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vertexBuffer, vertexBufferSize));
-			vertexCount = imDrawData->TotalVtxCount;
-			vertexBuffer.unmap();
-			vertexBuffer.map();
-			updateCmdBuffers = true;
+		bool recreated = false;
+
+		// The buffers of this image aren't used by any frame in flight, so they can be grown without waiting
+		if (buffers.vertexCount < imDrawData->TotalVtxCount) {
+			buffers.vertexBuffer.destroy();
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &buffers.vertexBuffer, vertexBufferSize, nullptr, vks::MemoryCategory::Overlay));
+			buffers.vertexCount = imDrawData->TotalVtxCount;
+			buffers.vertexBuffer.map();
+			recreated = true;
 		}
-
-		// Index buffer
-		if ((indexBuffer.buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount)) {
-			indexBuffer.unmap();
-			indexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &indexBuffer, indexBufferSize));
-			indexCount = imDrawData->TotalIdxCount;
-			indexBuffer.map();
-			updateCmdBuffers = true;
+		if (buffers.indexCount < imDrawData->TotalIdxCount) {
+			buffers.indexBuffer.destroy();
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &buffers.indexBuffer, indexBufferSize, nullptr, vks::MemoryCategory::Overlay));
+			buffers.indexCount = imDrawData->TotalIdxCount;
+			buffers.indexBuffer.map();
+			recreated = true;
 		}
 
 		// Upload data
-		ImDrawVert* vtxDst = (ImDrawVert*)vertexBuffer.mapped;
-		ImDrawIdx* idxDst = (ImDrawIdx*)indexBuffer.mapped;
+		ImDrawVert* vtxDst = (ImDrawVert*)buffers.vertexBuffer.mapped;
+		ImDrawIdx* idxDst = (ImDrawIdx*)buffers.indexBuffer.mapped;
 
 		for (int n = 0; n < imDrawData->CmdListsCount; n++) {
 			const ImDrawList* cmd_list = imDrawData->CmdLists[n];
@@ -361,19 +378,24 @@ namespace vks
 		}
 
 		// Flush to make writes visible to GPU
-		vertexBuffer.flush();
-		indexBuffer.flush();
+		buffers.vertexBuffer.flush();
+		buffers.indexBuffer.flush();
+		buffers.uploadedHash = hash;
 
-		return updateCmdBuffers;
+		return recreated || (hash != buffers.recordedHash);
 	}
 
-	void UIOverlay::draw(const VkCommandBuffer commandBuffer)
+	void UIOverlay::draw(const VkCommandBuffer commandBuffer, uint32_t imageIndex)
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
 		int32_t vertexOffset = 0;
 		int32_t indexOffset = 0;
 
-		if ((!imDrawData) || (imDrawData->CmdListsCount == 0)) {
+		// Only draw if the image's buffers hold the geometry for the current draw commands, otherwise the next update() requests a re-record
+		ImageBuffers& buffers = imageBuffers[imageIndex];
+		const uint64_t hash = drawCommandsHash();
+		buffers.recordedHash = (hash == buffers.uploadedHash) ? hash : 0;
+		if (buffers.recordedHash == 0) {
 			return;
 		}
 
@@ -387,8 +409,8 @@ namespace vks
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 
 		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffers.vertexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, buffers.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 
 		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++)
 		{
@@ -417,15 +439,18 @@ namespace vks
 
 	void UIOverlay::freeResources()
 	{
-		vertexBuffer.destroy();
-		indexBuffer.destroy();
+		setImageCount(0);
 		vkDestroyImageView(device->logicalDevice, fontView, nullptr);
 		vkDestroyImage(device->logicalDevice, fontImage, nullptr);
-		vkFreeMemory(device->logicalDevice, fontMemory, nullptr);
+		device->freeMemory(fontMemory);
 		vkDestroySampler(device->logicalDevice, sampler, nullptr);
 		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
 		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
 		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		if (asyncPipeline) {
+			pipeline = asyncPipeline->wait();
+			asyncPipeline.reset();
+		}
 		vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
 	}
 
@@ -21,6 +21,7 @@
 #include "VulkanDebug.h"
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
+#include "VulkanPipelineCompiler.h"
 
 #include "../external/imgui/imgui.h"
 
@@ -39,10 +40,18 @@ namespace vks
 		VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 		uint32_t subpass = 0;
 
-		vks::Buffer vertexBuffer;
-		vks::Buffer indexBuffer;
-		int32_t vertexCount = 0;
-		int32_t indexCount = 0;
+		/** @brief Geometry of the overlay, kept per swap chain image so that updates never touch buffers read by other frames in flight */
+		struct ImageBuffers {
+			vks::Buffer vertexBuffer;
+			vks::Buffer indexBuffer;
+			int32_t vertexCount = 0;
+			int32_t indexCount = 0;
+			/** @brief Hash of the draw commands whose geometry is currently stored in the buffers */
+			uint64_t uploadedHash = 0;
+			/** @brief Hash of the draw commands recorded into the image's command buffer (0 = nothing recorded) */
+			uint64_t recordedHash = 0;
+		};
+		std::vector<ImageBuffers> imageBuffers;
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaders;
 
@@ -50,9 +59,11 @@ namespace vks
 		VkDescriptorSetLayout descriptorSetLayout;
 		VkDescriptorSet descriptorSet;
 		VkPipelineLayout pipelineLayout;
-		VkPipeline pipeline;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		/** @brief Set while the pipeline is compiled in the background, the overlay isn't drawn until it's ready */
+		vks::AsyncPipelineHandle asyncPipeline;
 
-		VkDeviceMemory fontMemory = VK_NULL_HANDLE;
+		vks::MemoryAllocation fontMemory;
 		VkImage fontImage = VK_NULL_HANDLE;
 		VkImageView fontView = VK_NULL_HANDLE;
 		VkSampler sampler;
@@ -69,11 +80,16 @@ namespace vks
 		UIOverlay();
 		~UIOverlay();
 
-		void preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass, const VkFormat colorFormat, const VkFormat depthFormat);
+		void preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass, const VkFormat colorFormat, const VkFormat depthFormat, vks::PipelineCompiler *pipelineCompiler = nullptr);
 		void prepareResources();
 
-		bool update();
-		void draw(const VkCommandBuffer commandBuffer);
+		/** @brief Sets the number of swap chain images, must only be called while the device is idle */
+		void setImageCount(uint32_t imageCount);
+		/** @brief Uploads the current ImGui geometry for the given image, returns true if its command buffer needs to be re-recorded */
+		bool update(uint32_t imageIndex);
+		void draw(const VkCommandBuffer commandBuffer, uint32_t imageIndex);
+		/** @brief Hash of everything that ends up in the recorded draw commands, 0 if nothing is drawn */
+		uint64_t drawCommandsHash() const;
 		void resize(uint32_t width, uint32_t height);
 
 		void freeResources();
@@ -0,0 +1,100 @@
+/*
+* Vulkan uniform allocator
+*
+* Linear per-frame allocator for uniform data that is bound with dynamic descriptor offsets
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanUniformAllocator.h"
+
+#include <algorithm>
+#include <assert.h>
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	UniformAllocator::~UniformAllocator()
+	{
+		destroy();
+	}
+
+	void UniformAllocator::create(VulkanDevice *device, VkDeviceSize frameSize, uint32_t frameCount, VkDeviceSize maxRange)
+	{
+		assert(buffer == VK_NULL_HANDLE);
+		assert((frameCount > 0) && (maxRange <= device->properties.limits.maxUniformBufferRange));
+		this->device = device;
+		this->frameCount = frameCount;
+		this->maxRange = maxRange;
+		alignment = std::max<VkDeviceSize>(device->properties.limits.minUniformBufferOffsetAlignment, 16);
+		// Slices start aligned, so offsets inside a slice only have to be aligned relative to its start
+		this->frameSize = (frameSize + alignment - 1) & ~(alignment - 1);
+		frameIndex = 0;
+		head = 0;
+		// The descriptor range of the last allocation may extend past the end of the last slice
+		const VkDeviceSize bufferSize = this->frameSize * frameCount + maxRange;
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, bufferSize);
+		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &buffer));
+		VK_CHECK_RESULT(device->allocateBufferMemory(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &memory, vks::MemoryCategory::Uniform));
+	}
+
+	void UniformAllocator::destroy()
+	{
+		if (buffer == VK_NULL_HANDLE) {
+			return;
+		}
+		vkDestroyBuffer(device->logicalDevice, buffer, nullptr);
+		device->freeMemory(memory);
+		buffer = VK_NULL_HANDLE;
+		device = nullptr;
+	}
+
+	bool UniformAllocator::reserveFrames(uint32_t frameCount)
+	{
+		assert(buffer != VK_NULL_HANDLE);
+		if (frameCount <= this->frameCount) {
+			return false;
+		}
+		VulkanDevice *device = this->device;
+		const VkDeviceSize frameSize = this->frameSize;
+		const VkDeviceSize maxRange = this->maxRange;
+		destroy();
+		create(device, frameSize, frameCount, maxRange);
+		return true;
+	}
+
+	void UniformAllocator::beginFrame(uint32_t frameIndex)
+	{
+		assert(frameIndex < frameCount);
+		this->frameIndex = frameIndex;
+		head = frameIndex * frameSize;
+	}
+
+	UniformAllocation UniformAllocator::allocate(VkDeviceSize size, VkDeviceSize range)
+	{
+		assert(buffer != VK_NULL_HANDLE);
+		// Only maxRange bytes past the last slice are kept addressable, so larger descriptor ranges could read past the buffer
+		if (range > maxRange) {
+			vks::tools::exitFatal("Descriptor range of " + std::to_string(range) + " bytes exceeds the uniform allocator's maximum range of " + std::to_string(maxRange) + " bytes", -1);
+		}
+		const VkDeviceSize offset = (head + alignment - 1) & ~(alignment - 1);
+		if (offset + size > (frameIndex + 1) * frameSize) {
+			vks::tools::exitFatal("Uniform data of a frame exceeds the uniform allocator's frame size of " + std::to_string(frameSize) + " bytes", -1);
+		}
+		head = offset + size;
+		UniformAllocation allocation;
+		allocation.mapped = static_cast<uint8_t*>(memory.mapped) + offset;
+		allocation.dynamicOffset = static_cast<uint32_t>(offset);
+		return allocation;
+	}
+
+	VkDescriptorBufferInfo UniformAllocator::getDescriptor(VkDeviceSize range) const
+	{
+		assert(range <= maxRange);
+		VkDescriptorBufferInfo descriptor{};
+		descriptor.buffer = buffer;
+		descriptor.offset = 0;
+		descriptor.range = range;
+		return descriptor;
+	}
+}
@@ -0,0 +1,89 @@
+/*
+* Vulkan uniform allocator
+*
+* Linear per-frame allocator for uniform data that is bound with dynamic descriptor offsets
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string.h>
+
+#include "vulkan/vulkan.h"
+#include "VulkanMemoryAllocator.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/** @brief Uniform data written for the current frame */
+	struct UniformAllocation
+	{
+		void *mapped = nullptr;
+		/** @brief Offset to pass to vkCmdBindDescriptorSets for a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor of the allocator's buffer */
+		uint32_t dynamicOffset = 0;
+	};
+
+	/**
+	* @brief Hands out uniform data from one persistently mapped buffer that is split into a slice per frame
+	*
+	* All allocations of a frame are made after beginFrame() and are only valid until the same slice is begun again,
+	* so the slice may only be reset once the GPU has finished the frame's previous submission.
+	*/
+	class UniformAllocator
+	{
+	private:
+		VulkanDevice *device = nullptr;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		MemoryAllocation memory;
+		VkDeviceSize alignment = 256;
+		VkDeviceSize frameSize = 0;
+		uint32_t frameCount = 0;
+		/** @brief Largest descriptor range bound with a dynamic offset, kept addressable after the last allocation of the buffer */
+		VkDeviceSize maxRange = 0;
+		uint32_t frameIndex = 0;
+		VkDeviceSize head = 0;
+	public:
+		UniformAllocator() = default;
+		~UniformAllocator();
+		UniformAllocator(const UniformAllocator&) = delete;
+		UniformAllocator& operator=(const UniformAllocator&) = delete;
+
+		/**
+		* @brief Creates the buffer backing all frames
+		* @param frameSize Uniform data available per frame
+		* @param maxRange Largest range of the descriptors bound to the buffer, allocations may be smaller than the range they are bound with
+		*/
+		void create(VulkanDevice *device, VkDeviceSize frameSize, uint32_t frameCount, VkDeviceSize maxRange);
+		void destroy();
+		bool isCreated() const { return buffer != VK_NULL_HANDLE; }
+		/**
+		* @brief Recreates the buffer with room for at least frameCount slices, must only be called while no frame is in flight
+		* @return True if the buffer was recreated, descriptors referring to it have to be written again
+		*/
+		bool reserveFrames(uint32_t frameCount);
+
+		/** @brief Starts allocating from the given frame's slice, discarding its previous allocations */
+		void beginFrame(uint32_t frameIndex);
+		/**
+		* @brief Allocates uniform data in the current frame's slice, aligned to minUniformBufferOffsetAlignment
+		* @param range (Optional) Range of the descriptor the data is bound with if it's larger than size
+		*/
+		UniformAllocation allocate(VkDeviceSize size, VkDeviceSize range = 0);
+		/** @brief Copies data into the current frame's slice and returns its dynamic offset */
+		template <typename T> uint32_t push(const T &data)
+		{
+			UniformAllocation allocation = allocate(sizeof(T));
+			memcpy(allocation.mapped, &data, sizeof(T));
+			return allocation.dynamicOffset;
+		}
+
+		/** @brief Descriptor for VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC bindings, the offset is supplied at bind time */
+		VkDescriptorBufferInfo getDescriptor(VkDeviceSize range) const;
+		VkDeviceSize getAlignment() const { return alignment; }
+		uint32_t getFrameCount() const { return frameCount; }
+		/** @brief Bytes allocated in the current frame's slice */
+		VkDeviceSize getFrameUsage() const { return head - frameIndex * frameSize; }
+	};
+}
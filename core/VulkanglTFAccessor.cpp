@@ -0,0 +1,353 @@
+/*
+* glTF accessor decoding
+*
+* Bulk conversion of glTF accessor streams to the loader's vertex and index formats, vectorized with SSE2 where available
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanglTFAccessor.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <limits>
+#include <math.h>
+#include <string.h>
+#include "VulkanglTFModel.h"
+
+// SSE2 is part of every x86-64 CPU, so no runtime dispatch is required
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VKGLTF_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace vkglTF
+{
+	namespace
+	{
+		const float zeros[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+		/** @brief Reads the integer components of one element as floats, applying the glTF normalization rules */
+		template<typename T>
+		void readIntegerElement(const uint8_t *src, uint32_t components, bool normalized, float *element)
+		{
+			const float maxValue = static_cast<float>(std::numeric_limits<T>::max());
+			for (uint32_t c = 0; c < components; c++) {
+				T value;
+				memcpy(&value, src + c * sizeof(T), sizeof(T));
+				element[c] = normalized ? std::max(static_cast<float>(value) / maxValue, -1.0f) : static_cast<float>(value);
+			}
+		}
+
+		void transformVectors(float *vectors, size_t stride, size_t count, const glm::mat4 *matrix, bool isPosition)
+		{
+			uint8_t *data = reinterpret_cast<uint8_t*>(vectors);
+#if defined(VKGLTF_SSE2)
+			const glm::mat4 identity(1.0f);
+			const glm::mat4 &m = matrix ? *matrix : identity;
+			const __m128 column0 = _mm_loadu_ps(&m[0][0]);
+			const __m128 column1 = _mm_loadu_ps(&m[1][0]);
+			const __m128 column2 = _mm_loadu_ps(&m[2][0]);
+			const __m128 column3 = _mm_loadu_ps(&m[3][0]);
+			// The w lane is ignored, masking it keeps the length of normals independent of the matrix' last row
+			const __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+			for (size_t i = 0; i < count; i++) {
+				float *v = reinterpret_cast<float*>(data + i * stride);
+				__m128 result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(v[0])), _mm_mul_ps(column1, _mm_set1_ps(v[1]))), _mm_mul_ps(column2, _mm_set1_ps(v[2])));
+				if (isPosition) {
+					result = _mm_add_ps(result, column3);
+				}
+				else {
+					result = _mm_and_ps(result, xyzMask);
+					const __m128 squared = _mm_mul_ps(result, result);
+					const __m128 lengthSquared = _mm_add_ss(_mm_add_ss(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(1, 1, 1, 1))), _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(2, 2, 2, 2)));
+					if (_mm_cvtss_f32(lengthSquared) > 0.0f) {
+						const __m128 length = _mm_sqrt_ss(lengthSquared);
+						result = _mm_div_ps(result, _mm_shuffle_ps(length, length, _MM_SHUFFLE(0, 0, 0, 0)));
+					}
+				}
+				_mm_storel_pi(reinterpret_cast<__m64*>(v), result);
+				_mm_store_ss(v + 2, _mm_shuffle_ps(result, result, _MM_SHUFFLE(2, 2, 2, 2)));
+			}
+#else
+			for (size_t i = 0; i < count; i++) {
+				float *v = reinterpret_cast<float*>(data + i * stride);
+				glm::vec3 result(v[0], v[1], v[2]);
+				if (isPosition) {
+					result = glm::vec3(*matrix * glm::vec4(result, 1.0f));
+				}
+				else {
+					if (matrix) {
+						result = glm::mat3(*matrix) * result;
+					}
+					const float lengthSquared = glm::dot(result, result);
+					if (lengthSquared > 0.0f) {
+						result /= sqrtf(lengthSquared);
+					}
+				}
+				v[0] = result.x;
+				v[1] = result.y;
+				v[2] = result.z;
+			}
+#endif
+		}
+	}
+
+	void readFloats(const AccessorStream &stream, size_t first, size_t last, float *dst, size_t dstStride, uint32_t dstComponents, const float *defaults)
+	{
+		assert((dstComponents <= 4) && (last <= stream.count));
+		if (!defaults) {
+			defaults = zeros;
+		}
+		const uint32_t components = std::min(stream.componentCount, 4u);
+		const uint8_t *src = stream.data + first * stream.stride;
+		uint8_t *out = reinterpret_cast<uint8_t*>(dst);
+		float element[4];
+
+		// Plain float streams that cover all destination components are copied without conversion
+		if ((stream.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) && (components >= dstComponents)) {
+			for (size_t i = first; i < last; i++) {
+				memcpy(out, src, dstComponents * sizeof(float));
+				src += stream.stride;
+				out += dstStride;
+			}
+			return;
+		}
+
+#if defined(VKGLTF_SSE2)
+		// Unsigned byte and short streams (colors, joints, quantized attributes) are widened and converted four components at a time
+		if ((stream.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) || (stream.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)) {
+			const bool isByte = (stream.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE);
+			const size_t elementSize = components * (isByte ? 1 : 2);
+			const __m128 scale = _mm_set1_ps(stream.normalized ? (isByte ? 1.0f / 255.0f : 1.0f / 65535.0f) : 1.0f);
+			const __m128i zero = _mm_setzero_si128();
+			for (size_t i = first; i < last; i++) {
+				uint64_t raw = 0;
+				memcpy(&raw, src, elementSize);
+				__m128i values = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&raw));
+				if (isByte) {
+					values = _mm_unpacklo_epi8(values, zero);
+				}
+				values = _mm_unpacklo_epi16(values, zero);
+				_mm_storeu_ps(element, _mm_mul_ps(_mm_cvtepi32_ps(values), scale));
+				for (uint32_t c = components; c < dstComponents; c++) {
+					element[c] = defaults[c];
+				}
+				memcpy(out, element, dstComponents * sizeof(float));
+				src += stream.stride;
+				out += dstStride;
+			}
+			return;
+		}
+#endif
+
+		for (size_t i = first; i < last; i++) {
+			memcpy(element, defaults, sizeof(element));
+			switch (stream.componentType) {
+			case TINYGLTF_COMPONENT_TYPE_FLOAT:
+				memcpy(element, src, components * sizeof(float));
+				break;
+			case TINYGLTF_COMPONENT_TYPE_BYTE:
+				readIntegerElement<int8_t>(src, components, stream.normalized, element);
+				break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+				readIntegerElement<uint8_t>(src, components, stream.normalized, element);
+				break;
+			case TINYGLTF_COMPONENT_TYPE_SHORT:
+				readIntegerElement<int16_t>(src, components, stream.normalized, element);
+				break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+				readIntegerElement<uint16_t>(src, components, stream.normalized, element);
+				break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+				readIntegerElement<uint32_t>(src, components, false, element);
+				break;
+			default:
+				assert(!"Unsupported accessor component type");
+				break;
+			}
+			memcpy(out, element, dstComponents * sizeof(float));
+			src += stream.stride;
+			out += dstStride;
+		}
+	}
+
+	void readIndices(const AccessorStream &stream, size_t first, size_t last, uint32_t *dst, uint32_t offset)
+	{
+		assert(last <= stream.count);
+		const size_t count = last - first;
+		size_t i = 0;
+		switch (stream.componentType) {
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+			const uint8_t *src = stream.data + first * sizeof(uint32_t);
+#if defined(VKGLTF_SSE2)
+			const __m128i offsets = _mm_set1_epi32(static_cast<int>(offset));
+			for (; i + 4 <= count; i += 4) {
+				const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * sizeof(uint32_t)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi32(values, offsets));
+			}
+#endif
+			for (; i < count; i++) {
+				uint32_t index;
+				memcpy(&index, src + i * sizeof(uint32_t), sizeof(index));
+				dst[i] = index + offset;
+			}
+			break;
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+			const uint8_t *src = stream.data + first * sizeof(uint16_t);
+#if defined(VKGLTF_SSE2)
+			const __m128i offsets = _mm_set1_epi32(static_cast<int>(offset));
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 8 <= count; i += 8) {
+				const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * sizeof(uint16_t)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi32(_mm_unpacklo_epi16(values, zero), offsets));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_add_epi32(_mm_unpackhi_epi16(values, zero), offsets));
+			}
+#endif
+			for (; i < count; i++) {
+				uint16_t index;
+				memcpy(&index, src + i * sizeof(uint16_t), sizeof(index));
+				dst[i] = index + offset;
+			}
+			break;
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+			const uint8_t *src = stream.data + first;
+#if defined(VKGLTF_SSE2)
+			const __m128i offsets = _mm_set1_epi32(static_cast<int>(offset));
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= count; i += 16) {
+				const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				const __m128i lo = _mm_unpacklo_epi8(values, zero);
+				const __m128i hi = _mm_unpackhi_epi8(values, zero);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi32(_mm_unpacklo_epi16(lo, zero), offsets));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_add_epi32(_mm_unpackhi_epi16(lo, zero), offsets));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_add_epi32(_mm_unpacklo_epi16(hi, zero), offsets));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), _mm_add_epi32(_mm_unpackhi_epi16(hi, zero), offsets));
+			}
+#endif
+			for (; i < count; i++) {
+				dst[i] = src[i] + offset;
+			}
+			break;
+		}
+		default:
+			assert(!"Unsupported index component type");
+			break;
+		}
+	}
+
+	void readIndices(const AccessorStream &stream, size_t first, size_t last, uint16_t *dst)
+	{
+		assert(last <= stream.count);
+		const size_t count = last - first;
+		size_t i = 0;
+		switch (stream.componentType) {
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+			const uint8_t *src = stream.data + first * sizeof(uint32_t);
+#if defined(VKGLTF_SSE2)
+			// SSE2 only has a signed saturating pack, so the values are biased into the signed 16 bit range and back
+			const __m128i bias32 = _mm_set1_epi32(0x8000);
+			const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+			for (; i + 8 <= count; i += 8) {
+				const __m128i lo = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * sizeof(uint32_t))), bias32);
+				const __m128i hi = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i + 4) * sizeof(uint32_t))), bias32);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi16(_mm_packs_epi32(lo, hi), bias16));
+			}
+#endif
+			for (; i < count; i++) {
+				uint32_t index;
+				memcpy(&index, src + i * sizeof(uint32_t), sizeof(index));
+				assert(index <= 0xFFFF);
+				dst[i] = static_cast<uint16_t>(index);
+			}
+			break;
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			memcpy(dst, stream.data + first * sizeof(uint16_t), count * sizeof(uint16_t));
+			break;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+			const uint8_t *src = stream.data + first;
+#if defined(VKGLTF_SSE2)
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= count; i += 16) {
+				const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(values, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(values, zero));
+			}
+#endif
+			for (; i < count; i++) {
+				dst[i] = src[i];
+			}
+			break;
+		}
+		default:
+			assert(!"Unsupported index component type");
+			break;
+		}
+	}
+
+	void transformPositions(float *positions, size_t stride, size_t count, const glm::mat4 &matrix)
+	{
+		transformVectors(positions, stride, count, &matrix, true);
+	}
+
+	void transformNormals(float *normals, size_t stride, size_t count, const glm::mat4 *matrix)
+	{
+		transformVectors(normals, stride, count, matrix, false);
+	}
+
+	uint16_t floatToHalf(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		const uint32_t sign = (bits >> 16) & 0x8000;
+		const uint32_t exponent = (bits >> 23) & 0xFF;
+		uint32_t mantissa = bits & 0x7FFFFF;
+		// Infinity and NaN
+		if (exponent == 0xFF) {
+			return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+		}
+		const int halfExponent = static_cast<int>(exponent) - 127 + 15;
+		if (halfExponent >= 31) {
+			return static_cast<uint16_t>(sign | 0x7C00);
+		}
+		// Values below the smallest normal half float become subnormals (or zero), the implicit leading one is shifted into the mantissa
+		uint32_t shift = 13;
+		uint32_t half = 0;
+		if (halfExponent <= 0) {
+			if (halfExponent < -10) {
+				return static_cast<uint16_t>(sign);
+			}
+			mantissa |= 0x800000;
+			shift = static_cast<uint32_t>(14 - halfExponent);
+		}
+		else {
+			half = static_cast<uint32_t>(halfExponent) << 10;
+		}
+		half |= mantissa >> shift;
+		// A carry out of the mantissa correctly increments the exponent
+		const uint32_t remainder = mantissa & ((1u << shift) - 1);
+		const uint32_t halfway = 1u << (shift - 1);
+		if ((remainder > halfway) || ((remainder == halfway) && (half & 1))) {
+			half++;
+		}
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	int8_t floatToSnorm8(float value)
+	{
+		return static_cast<int8_t>(roundf(std::min(std::max(value, -1.0f), 1.0f) * 127.0f));
+	}
+
+	uint8_t floatToUnorm8(float value)
+	{
+		return static_cast<uint8_t>(roundf(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+	}
+
+	uint16_t floatToUnorm16(float value)
+	{
+		return static_cast<uint16_t>(roundf(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+	}
+}
@@ -0,0 +1,55 @@
+/*
+* glTF accessor decoding
+*
+* Bulk conversion of glTF accessor streams to the loader's vertex and index formats, vectorized with SSE2 where available
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+namespace vkglTF
+{
+	/** @brief Elements of a glTF accessor, resolved against the buffer data of the model being loaded */
+	struct AccessorStream
+	{
+		const uint8_t *data = nullptr;
+		size_t count = 0;
+		/** @brief Distance between elements in bytes, the buffer view's byteStride or the element size for tightly packed data */
+		size_t stride = 0;
+		/** @brief glTF component type (TINYGLTF_COMPONENT_TYPE_*) */
+		int componentType = 0;
+		uint32_t componentCount = 0;
+		bool normalized = false;
+	};
+
+	/**
+	* @brief Converts the elements [first, last) of a stream to floats
+	*
+	* Writes dstComponents (at most 4) floats per element, dstStride bytes apart. Components missing in the stream are taken from
+	* defaults (zero if null), normalized integer components are mapped to [0, 1] or [-1, 1] as defined by the glTF specification.
+	*/
+	void readFloats(const AccessorStream &stream, size_t first, size_t last, float *dst, size_t dstStride, uint32_t dstComponents, const float *defaults = nullptr);
+	/** @brief Converts the indices [first, last) of an unsigned byte, short or int stream to 32 bit and adds offset to them */
+	void readIndices(const AccessorStream &stream, size_t first, size_t last, uint32_t *dst, uint32_t offset);
+	/** @brief Converts the indices [first, last) of an unsigned byte, short or int stream to 16 bit, all indices have to be below 65536 */
+	void readIndices(const AccessorStream &stream, size_t first, size_t last, uint16_t *dst);
+	/** @brief Transforms count vec3 positions, stride bytes apart, by a matrix */
+	void transformPositions(float *positions, size_t stride, size_t count, const glm::mat4 &matrix);
+	/** @brief Transforms count vec3 normals by the upper 3x3 part of a matrix (or leaves them untransformed if null) and normalizes them, zero normals stay zero */
+	void transformNormals(float *normals, size_t stride, size_t count, const glm::mat4 *matrix);
+
+	/** @brief Converts a float to an IEEE 754 half float, rounding to nearest even */
+	uint16_t floatToHalf(float value);
+	/** @brief Quantizes a float in [-1, 1] to a signed normalized 8 bit value, values outside of the range are clamped */
+	int8_t floatToSnorm8(float value);
+	/** @brief Quantizes a float in [0, 1] to an unsigned normalized 8 bit value, values outside of the range are clamped */
+	uint8_t floatToUnorm8(float value);
+	/** @brief Quantizes a float in [0, 1] to an unsigned normalized 16 bit value, values outside of the range are clamped */
+	uint16_t floatToUnorm16(float value);
+}
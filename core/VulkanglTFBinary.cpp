@@ -0,0 +1,361 @@
+/*
+* Binary glTF
+*
+* Prepares binary glTF (.glb) containers and text glTF files with embedded data for tinygltf without copying or
+* decoding their buffers through it, and converts text glTF files with embedded or external buffers to .glb
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanglTFBinary.h"
+
+#include <fstream>
+#include <iterator>
+#include <string.h>
+#include "Base64.h"
+#include "json.hpp"
+
+namespace vkglTF
+{
+	namespace
+	{
+		const uint32_t glbMagic = 0x46546C67;
+		const uint32_t glbVersion = 2;
+		const uint32_t glbChunkJson = 0x4E4F534A;
+		const uint32_t glbChunkBin = 0x004E4942;
+		const size_t glbHeaderSize = 12;
+		const size_t glbChunkHeaderSize = 8;
+
+		// Stands in for data tinygltf must not copy, it only accepts data URIs that decode to at least one byte
+		const char *placeholderBufferUri = "data:application/octet-stream;base64,AA==";
+		const char *placeholderImageUri = "data:image/png;base64,AA==";
+
+		uint32_t readUint32(const uint8_t *data)
+		{
+			uint32_t value;
+			memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		void appendUint32(std::vector<uint8_t> &data, uint32_t value)
+		{
+			const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+			data.insert(data.end(), bytes, bytes + sizeof(value));
+		}
+
+		bool readFile(const std::string &fileName, std::vector<uint8_t> *data)
+		{
+			std::ifstream file(fileName, std::ios::binary);
+			if (!file.is_open()) {
+				return false;
+			}
+			data->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			return true;
+		}
+
+		bool isDataUri(const std::string &uri)
+		{
+			return uri.compare(0, 5, "data:") == 0;
+		}
+
+		/** @brief Decodes a base64 data URI, returns false for other URIs and invalid data */
+		bool decodeDataUri(const std::string &uri, std::vector<uint8_t> *data, std::string *mimeType)
+		{
+			const std::string encoding = ";base64";
+			const size_t comma = uri.find(',');
+			if (!isDataUri(uri) || (comma == std::string::npos) || (comma < 5 + encoding.size()) || (uri.compare(comma - encoding.size(), encoding.size(), encoding) != 0)) {
+				return false;
+			}
+			*mimeType = uri.substr(5, comma - 5 - encoding.size());
+			const char *text = uri.data() + comma + 1;
+			const size_t length = uri.size() - comma - 1;
+			data->resize(vks::base64::getDecodedSize(text, length));
+			return vks::base64::decode(text, length, data->data());
+		}
+
+		/** @brief Replaces images stored in buffer views of buffers with in place data by placeholders, so the image loader decodes them from that data */
+		bool redirectBufferViewImages(nlohmann::json &document, GltfContents *contents, std::string *error)
+		{
+			if (!document.count("images")) {
+				return true;
+			}
+			nlohmann::json &images = document["images"];
+			contents->images.resize(images.size());
+			for (size_t i = 0; i < images.size(); i++) {
+				nlohmann::json &image = images[i];
+				if (!image.count("bufferView")) {
+					continue;
+				}
+				const nlohmann::json &bufferView = document.at("bufferViews").at(image["bufferView"].get<size_t>());
+				const int buffer = bufferView.value("buffer", -1);
+				if ((buffer < 0) || (buffer >= static_cast<int>(contents->buffers.size())) || !contents->buffers[buffer].data) {
+					continue;
+				}
+				const DataRange &bufferData = contents->buffers[buffer];
+				const size_t byteOffset = bufferView.value("byteOffset", size_t(0));
+				const size_t byteLength = bufferView.value("byteLength", size_t(0));
+				if ((byteOffset > bufferData.size) || (byteLength > bufferData.size - byteOffset)) {
+					*error = "Image exceeds its buffer";
+					return false;
+				}
+				contents->images[i].data = bufferData.data + byteOffset;
+				contents->images[i].size = byteLength;
+				image.erase("bufferView");
+				image["uri"] = placeholderImageUri;
+			}
+			return true;
+		}
+	}
+
+	bool isGlb(const uint8_t *data, size_t size)
+	{
+		return (size >= glbHeaderSize) && (readUint32(data) == glbMagic);
+	}
+
+	bool readGlb(const uint8_t *data, size_t size, GltfContents *contents, std::string *error)
+	{
+		if (!isGlb(data, size) || (readUint32(data + 4) != glbVersion)) {
+			*error = "Not a glTF 2.0 binary file";
+			return false;
+		}
+		const size_t length = readUint32(data + 8);
+		if ((length > size) || (length < glbHeaderSize + glbChunkHeaderSize)) {
+			*error = "Invalid length in glTF binary header";
+			return false;
+		}
+
+		// The JSON chunk comes first, followed by an optional binary chunk
+		DataRange json;
+		json.size = readUint32(data + glbHeaderSize);
+		json.data = data + glbHeaderSize + glbChunkHeaderSize;
+		if ((readUint32(data + glbHeaderSize + 4) != glbChunkJson) || (json.size > length - glbHeaderSize - glbChunkHeaderSize)) {
+			*error = "Invalid JSON chunk in glTF binary file";
+			return false;
+		}
+		DataRange bin;
+		const size_t binOffset = glbHeaderSize + glbChunkHeaderSize + json.size;
+		if (binOffset + glbChunkHeaderSize <= length) {
+			const size_t binSize = readUint32(data + binOffset);
+			if ((readUint32(data + binOffset + 4) == glbChunkBin) && (binSize <= length - binOffset - glbChunkHeaderSize)) {
+				bin.data = data + binOffset + glbChunkHeaderSize;
+				bin.size = binSize;
+			}
+		}
+
+		try {
+			nlohmann::json document = nlohmann::json::parse(json.data, json.data + json.size);
+			contents->buffers.clear();
+			contents->images.clear();
+			contents->decoded.clear();
+
+			// Only the first buffer may be stored in the binary chunk, it's the one without an uri
+			if (document.count("buffers") && !document["buffers"].empty() && !document["buffers"][0].count("uri")) {
+				nlohmann::json &buffer = document["buffers"][0];
+				if (!bin.data || (buffer.value("byteLength", size_t(0)) > bin.size)) {
+					*error = "Buffer exceeds the binary chunk of the glTF binary file";
+					return false;
+				}
+				contents->buffers.resize(document["buffers"].size());
+				contents->buffers[0] = bin;
+				buffer["byteLength"] = 1;
+				buffer["uri"] = placeholderBufferUri;
+			}
+
+			// Images stored in the binary chunk are decoded from the file's memory by the image loader instead
+			if (!redirectBufferViewImages(document, contents, error)) {
+				return false;
+			}
+
+			contents->json = document.dump();
+		}
+		catch (const std::exception &e) {
+			*error = std::string("Invalid JSON in glTF binary file: ") + e.what();
+			return false;
+		}
+		return true;
+	}
+
+	bool readGltf(const char *text, size_t size, GltfContents *contents, std::string *error)
+	{
+		try {
+			nlohmann::json document = nlohmann::json::parse(text, text + size);
+			contents->buffers.clear();
+			contents->images.clear();
+			contents->decoded.clear();
+			bool replaced = false;
+			std::string mimeType;
+
+			// Other URIs (external files or data URIs that can't be decoded here) are left to tinygltf
+			if (document.count("buffers")) {
+				nlohmann::json &buffers = document["buffers"];
+				contents->buffers.resize(buffers.size());
+				for (size_t i = 0; i < buffers.size(); i++) {
+					nlohmann::json &buffer = buffers[i];
+					std::vector<uint8_t> data;
+					if (!buffer.count("uri") || !decodeDataUri(buffer["uri"].get_ref<const std::string&>(), &data, &mimeType)) {
+						continue;
+					}
+					const size_t byteLength = buffer.value("byteLength", size_t(0));
+					if (data.size() < byteLength) {
+						*error = "Buffer data URI is shorter than the buffer's byteLength";
+						return false;
+					}
+					contents->decoded.push_back(std::move(data));
+					contents->buffers[i].data = contents->decoded.back().data();
+					contents->buffers[i].size = byteLength;
+					buffer["byteLength"] = 1;
+					buffer["uri"] = placeholderBufferUri;
+					replaced = true;
+				}
+			}
+
+			if (document.count("images")) {
+				nlohmann::json &images = document["images"];
+				contents->images.resize(images.size());
+				for (size_t i = 0; i < images.size(); i++) {
+					nlohmann::json &image = images[i];
+					std::vector<uint8_t> data;
+					if (!image.count("uri") || !decodeDataUri(image["uri"].get_ref<const std::string&>(), &data, &mimeType)) {
+						continue;
+					}
+					contents->decoded.push_back(std::move(data));
+					contents->images[i].data = contents->decoded.back().data();
+					contents->images[i].size = contents->decoded.back().size();
+					image["uri"] = placeholderImageUri;
+					replaced = true;
+				}
+			}
+
+			if (!redirectBufferViewImages(document, contents, error)) {
+				return false;
+			}
+
+			// Files without embedded data are passed on unchanged
+			if (replaced) {
+				contents->json = document.dump();
+			}
+			else {
+				contents->json.assign(text, size);
+			}
+		}
+		catch (const std::exception &e) {
+			*error = std::string("Invalid JSON in glTF file: ") + e.what();
+			return false;
+		}
+		return true;
+	}
+
+	bool convertGltfToGlb(const std::string &gltfFile, const std::string &glbFile, std::string *error)
+	{
+		std::vector<uint8_t> text;
+		if (!readFile(gltfFile, &text)) {
+			*error = "Could not open " + gltfFile;
+			return false;
+		}
+		const size_t pos = gltfFile.find_last_of("/\\");
+		const std::string baseDir = (pos == std::string::npos) ? std::string() : gltfFile.substr(0, pos + 1);
+
+		std::vector<uint8_t> bin;
+		std::string json;
+		try {
+			nlohmann::json document = nlohmann::json::parse(text.begin(), text.end());
+
+			// Merge all buffers into the binary chunk, 16 byte alignment keeps the alignment of all accessors
+			std::vector<size_t> bufferOffsets;
+			if (document.count("buffers")) {
+				for (auto &buffer : document["buffers"]) {
+					const size_t byteLength = buffer.at("byteLength").get<size_t>();
+					std::vector<unsigned char> data;
+					const std::string uri = buffer.value("uri", std::string());
+					std::string mimeType;
+					if (isDataUri(uri)) {
+						if (!decodeDataUri(uri, &data, &mimeType) || (data.size() < byteLength)) {
+							*error = "Could not decode buffer data URI";
+							return false;
+						}
+					}
+					else if (uri.empty() || !readFile(baseDir + uri, &data) || (data.size() < byteLength)) {
+						*error = "Could not read buffer \"" + uri + "\"";
+						return false;
+					}
+					bin.resize((bin.size() + 15) & ~size_t(15));
+					bufferOffsets.push_back(bin.size());
+					bin.insert(bin.end(), data.begin(), data.begin() + byteLength);
+				}
+			}
+			if (document.count("bufferViews")) {
+				for (auto &bufferView : document["bufferViews"]) {
+					const size_t buffer = bufferView.at("buffer").get<size_t>();
+					bufferView["byteOffset"] = bufferOffsets.at(buffer) + bufferView.value("byteOffset", size_t(0));
+					bufferView["buffer"] = 0;
+				}
+			}
+
+			// Move images stored as data URIs into buffer views of the binary chunk
+			if (document.count("images")) {
+				for (auto &image : document["images"]) {
+					const std::string uri = image.value("uri", std::string());
+					if (!isDataUri(uri)) {
+						continue;
+					}
+					std::vector<uint8_t> data;
+					std::string mimeType;
+					if (!decodeDataUri(uri, &data, &mimeType)) {
+						*error = "Could not decode image data URI";
+						return false;
+					}
+					bin.resize((bin.size() + 3) & ~size_t(3));
+					nlohmann::json bufferView;
+					bufferView["buffer"] = 0;
+					bufferView["byteOffset"] = bin.size();
+					bufferView["byteLength"] = data.size();
+					bin.insert(bin.end(), data.begin(), data.end());
+					document["bufferViews"].push_back(bufferView);
+					image.erase("uri");
+					image["bufferView"] = document["bufferViews"].size() - 1;
+					image["mimeType"] = mimeType;
+				}
+			}
+
+			if (!bin.empty()) {
+				nlohmann::json buffer;
+				buffer["byteLength"] = bin.size();
+				document["buffers"] = nlohmann::json::array({ buffer });
+			}
+			else {
+				document.erase("buffers");
+			}
+			json = document.dump();
+		}
+		catch (const std::exception &e) {
+			*error = "Invalid glTF file " + gltfFile + ": " + e.what();
+			return false;
+		}
+
+		// Chunks have to be 4 byte aligned, JSON is padded with spaces and binary data with zeros
+		json.resize((json.size() + 3) & ~size_t(3), ' ');
+		bin.resize((bin.size() + 3) & ~size_t(3), 0);
+
+		std::vector<uint8_t> glb;
+		const size_t length = glbHeaderSize + glbChunkHeaderSize + json.size() + (bin.empty() ? 0 : glbChunkHeaderSize + bin.size());
+		glb.reserve(length);
+		appendUint32(glb, glbMagic);
+		appendUint32(glb, glbVersion);
+		appendUint32(glb, static_cast<uint32_t>(length));
+		appendUint32(glb, static_cast<uint32_t>(json.size()));
+		appendUint32(glb, glbChunkJson);
+		glb.insert(glb.end(), json.begin(), json.end());
+		if (!bin.empty()) {
+			appendUint32(glb, static_cast<uint32_t>(bin.size()));
+			appendUint32(glb, glbChunkBin);
+			glb.insert(glb.end(), bin.begin(), bin.end());
+		}
+
+		std::ofstream file(glbFile, std::ios::binary);
+		if (!file.is_open() || !file.write(reinterpret_cast<const char*>(glb.data()), glb.size())) {
+			*error = "Could not write " + glbFile;
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,57 @@
+/*
+* Binary glTF
+*
+* Prepares binary glTF (.glb) containers and text glTF files with embedded data for tinygltf without copying or
+* decoding their buffers through it, and converts text glTF files with embedded or external buffers to .glb
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace vkglTF
+{
+	/** @brief Range of bytes inside a .glb file or a decoded data URI */
+	struct DataRange
+	{
+		const uint8_t *data = nullptr;
+		size_t size = 0;
+	};
+
+	/**
+	* @brief Contents of a glTF file prepared for tinygltf
+	*
+	* Buffers stored in the binary chunk of a .glb file or embedded as base64 data URIs, and the images stored in them, are replaced
+	* by one byte data URIs in the JSON, so tinygltf neither copies nor decodes them. Their data is read from the ranges below instead,
+	* which point into the file's memory or into the data URIs decoded by vks::base64.
+	*/
+	struct GltfContents
+	{
+		std::string json;
+		/** @brief Data per buffer index, empty for buffers loaded by tinygltf (e.g. external files) */
+		std::vector<DataRange> buffers;
+		/** @brief Encoded data per image index, empty for images loaded by tinygltf */
+		std::vector<DataRange> images;
+		/** @brief Storage of the decoded data URIs */
+		std::vector<std::vector<uint8_t>> decoded;
+	};
+
+	/** @brief Returns true if the data starts with a .glb header */
+	bool isGlb(const uint8_t *data, size_t size);
+	/** @brief Splits a .glb file into its chunks and prepares the JSON for tinygltf, data has to stay valid as long as the contents are used */
+	bool readGlb(const uint8_t *data, size_t size, GltfContents *contents, std::string *error);
+	/** @brief Decodes the base64 data URIs of buffers and images of a text glTF file and prepares the JSON for tinygltf */
+	bool readGltf(const char *text, size_t size, GltfContents *contents, std::string *error);
+	/**
+	* @brief Converts a text glTF file to a .glb file
+	*
+	* All buffers (data URIs or external files) are merged into the binary chunk and images stored as data URIs are moved into it.
+	* Images referencing external files (e.g. KTX textures) keep their URIs, so the .glb has to be stored next to them.
+	*/
+	bool convertGltfToGlb(const std::string &gltfFile, const std::string &glbFile, std::string *error);
+}
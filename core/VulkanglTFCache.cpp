@@ -0,0 +1,340 @@
+/*
+* glTF mesh cache
+*
+* Binary file format for the processed data of a vkglTF::Model (vertex, index and meshlet data, primitives and their levels of
+* detail, node hierarchy, materials and decoded images), so models can be loaded without parsing the glTF file and decoding its
+* primitives and images again
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanglTFCache.h"
+#include "VulkanglTFMeshlet.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace vkglTF
+{
+	namespace
+	{
+		const uint32_t cacheMagic = 0x434D4B56;
+		// Has to be increased whenever the layout of the file or the processing of the stored data changes
+		const uint32_t cacheVersion = 4;
+		// Data ranges start at multiples of this in the file, so vertex and index data read from the mapped file is aligned
+		const size_t cacheRangeAlignment = 16;
+
+		class Writer
+		{
+		public:
+			std::vector<uint8_t> data;
+
+			template<typename T>
+			void put(const T &value)
+			{
+				const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+				data.insert(data.end(), bytes, bytes + sizeof(T));
+			}
+			void putString(const std::string &value)
+			{
+				put(static_cast<uint32_t>(value.size()));
+				data.insert(data.end(), value.begin(), value.end());
+			}
+			void putRange(const DataRange &range)
+			{
+				put(static_cast<uint64_t>(range.size));
+				data.resize((data.size() + cacheRangeAlignment - 1) / cacheRangeAlignment * cacheRangeAlignment, 0);
+				if (range.size > 0) {
+					data.insert(data.end(), range.data, range.data + range.size);
+				}
+			}
+		};
+
+		class Reader
+		{
+		private:
+			const uint8_t *begin;
+			const uint8_t *end;
+			const uint8_t *current;
+		public:
+			Reader(const uint8_t *data, size_t size) : begin(data), end(data + size), current(data) {};
+
+			template<typename T>
+			bool get(T &value)
+			{
+				if (static_cast<size_t>(end - current) < sizeof(T)) {
+					return false;
+				}
+				memcpy(&value, current, sizeof(T));
+				current += sizeof(T);
+				return true;
+			}
+			bool getString(std::string &value)
+			{
+				uint32_t size;
+				if (!get(size) || (static_cast<size_t>(end - current) < size)) {
+					return false;
+				}
+				value.assign(reinterpret_cast<const char*>(current), size);
+				current += size;
+				return true;
+			}
+			bool getRange(DataRange &range)
+			{
+				uint64_t size;
+				if (!get(size)) {
+					return false;
+				}
+				const size_t offset = (static_cast<size_t>(current - begin) + cacheRangeAlignment - 1) / cacheRangeAlignment * cacheRangeAlignment;
+				if ((offset > static_cast<size_t>(end - begin)) || (static_cast<uint64_t>(end - begin - offset) < size)) {
+					return false;
+				}
+				range.data = begin + offset;
+				range.size = static_cast<size_t>(size);
+				current = range.data + range.size;
+				return true;
+			}
+			/** @brief Reads the element count of an array, fails if the remaining data can't hold that many elements of at least minSize bytes */
+			bool getCount(uint32_t &count, size_t minSize)
+			{
+				return get(count) && (count <= static_cast<size_t>(end - current) / minSize);
+			}
+		};
+
+		bool isValidTexture(int32_t texture, size_t imageCount)
+		{
+			return (texture == CachedModel::Material::NoTexture) || (texture == CachedModel::Material::EmptyTexture) || ((texture >= 0) && (static_cast<size_t>(texture) < imageCount));
+		}
+
+		bool validate(const CachedModel &model, std::string *error)
+		{
+			if (((model.indexSize != 2) && (model.indexSize != 4)) || (model.indexData.size % model.indexSize != 0)) {
+				*error = "Invalid index size";
+				return false;
+			}
+			if ((model.vertexCount == 0) || (model.vertexData.size % model.vertexCount != 0)) {
+				*error = "Vertex data doesn't match the vertex count";
+				return false;
+			}
+			const uint64_t indexCount = model.indexData.size / model.indexSize;
+			const uint64_t meshletCount = model.meshletData.size / sizeof(Meshlet);
+			for (const CachedModel::Primitive &primitive : model.primitives) {
+				if ((static_cast<uint64_t>(primitive.firstIndex) + primitive.indexCount > indexCount) || (static_cast<uint64_t>(primitive.firstVertex) + primitive.vertexCount > model.vertexCount) ||
+					(static_cast<uint64_t>(primitive.firstMeshlet) + primitive.meshletCount > meshletCount) || (static_cast<uint64_t>(primitive.firstLod) + primitive.lodCount > model.lods.size()) ||
+					(primitive.material >= model.materials.size())) {
+					*error = "Primitive references data outside of the cache";
+					return false;
+				}
+			}
+			for (const CachedModel::Lod &lod : model.lods) {
+				if (static_cast<uint64_t>(lod.firstIndex) + lod.indexCount > indexCount) {
+					*error = "Level of detail references data outside of the cache";
+					return false;
+				}
+			}
+			// Meshlets are read by shaders, so their ranges have to be checked as well
+			if ((model.meshletData.size % sizeof(Meshlet) != 0) || (model.meshletVertexData.size % sizeof(uint32_t) != 0)) {
+				*error = "Invalid meshlet data";
+				return false;
+			}
+			for (uint64_t i = 0; i < meshletCount; i++) {
+				Meshlet meshlet;
+				memcpy(&meshlet, model.meshletData.data + i * sizeof(Meshlet), sizeof(Meshlet));
+				if ((meshlet.vertexCount > maxMeshletVertices) || (meshlet.triangleCount > maxMeshletTriangles) ||
+					(static_cast<uint64_t>(meshlet.vertexOffset) + meshlet.vertexCount > model.meshletVertexData.size / sizeof(uint32_t)) ||
+					(static_cast<uint64_t>(meshlet.triangleOffset) + meshlet.triangleCount * 3 > model.meshletTriangleData.size)) {
+					*error = "Meshlet references data outside of the cache";
+					return false;
+				}
+			}
+			for (size_t i = 0; i < model.nodes.size(); i++) {
+				const CachedModel::Node &node = model.nodes[i];
+				// Children are stored before their parents, which also rules out cycles
+				if (((node.parent != -1) && ((node.parent <= static_cast<int32_t>(i)) || (static_cast<size_t>(node.parent) >= model.nodes.size()))) ||
+					(static_cast<uint64_t>(node.firstPrimitive) + node.primitiveCount > model.primitives.size())) {
+					*error = "Invalid node hierarchy";
+					return false;
+				}
+			}
+			for (const CachedModel::Material &material : model.materials) {
+				const int32_t textures[] = { material.baseColorTexture, material.metallicRoughnessTexture, material.normalTexture, material.occlusionTexture, material.emissiveTexture };
+				for (int32_t texture : textures) {
+					if (!isValidTexture(texture, model.images.size())) {
+						*error = "Material references an invalid image";
+						return false;
+					}
+				}
+			}
+			for (const CachedModel::Image &image : model.images) {
+				if (image.uri.empty() && (static_cast<uint64_t>(image.width) * image.height * image.component != image.pixels.size)) {
+					*error = "Image data doesn't match its size";
+					return false;
+				}
+			}
+			return true;
+		}
+	}
+
+	std::string getMeshCacheFileName(const std::string &filename)
+	{
+		return filename + ".cache";
+	}
+
+	bool readMeshCache(const uint8_t *data, size_t size, CachedModel *model, std::string *error)
+	{
+		Reader reader(data, size);
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		if (!reader.get(magic) || (magic != cacheMagic)) {
+			*error = "Not a mesh cache file";
+			return false;
+		}
+		if (!reader.get(version) || (version != cacheVersion)) {
+			*error = "Mesh cache was written by a different version";
+			return false;
+		}
+
+		bool valid = reader.get(model->key);
+		uint32_t count = 0;
+		valid = valid && reader.getCount(count, sizeof(uint32_t) + sizeof(uint64_t));
+		model->dependencies.resize(valid ? count : 0);
+		for (CachedModel::Dependency &dependency : model->dependencies) {
+			valid = valid && reader.getString(dependency.uri) && reader.get(dependency.hash);
+		}
+
+		valid = valid && reader.getCount(count, sizeof(glm::mat4));
+		model->nodes.resize(valid ? count : 0);
+		for (CachedModel::Node &node : model->nodes) {
+			uint8_t hasMesh = 0;
+			valid = valid && reader.get(node.parent) && reader.get(node.index) && reader.getString(node.name);
+			valid = valid && reader.get(node.matrix) && reader.get(node.translation) && reader.get(node.scale) && reader.get(node.rotation);
+			valid = valid && reader.get(hasMesh) && reader.getString(node.meshName) && reader.get(node.firstPrimitive) && reader.get(node.primitiveCount);
+			node.hasMesh = (hasMesh != 0);
+		}
+
+		valid = valid && reader.getCount(count, sizeof(CachedModel::Primitive));
+		model->primitives.resize(valid ? count : 0);
+		for (CachedModel::Primitive &primitive : model->primitives) {
+			valid = valid && reader.get(primitive);
+		}
+
+		valid = valid && reader.getCount(count, sizeof(CachedModel::Lod));
+		model->lods.resize(valid ? count : 0);
+		for (CachedModel::Lod &lod : model->lods) {
+			valid = valid && reader.get(lod);
+		}
+
+		valid = valid && reader.getCount(count, sizeof(CachedModel::Material));
+		model->materials.resize(valid ? count : 0);
+		for (CachedModel::Material &material : model->materials) {
+			valid = valid && reader.get(material);
+		}
+
+		valid = valid && reader.getCount(count, 3 * sizeof(uint32_t) + sizeof(uint64_t));
+		model->images.resize(valid ? count : 0);
+		for (CachedModel::Image &image : model->images) {
+			valid = valid && reader.getString(image.uri) && reader.get(image.width) && reader.get(image.height) && reader.get(image.component) && reader.getRange(image.pixels);
+		}
+
+		uint8_t metallicRoughnessWorkflow = 1;
+		valid = valid && reader.get(metallicRoughnessWorkflow) && reader.get(model->indexSize) && reader.get(model->vertexCount);
+		valid = valid && reader.getRange(model->vertexData) && reader.getRange(model->indexData);
+		valid = valid && reader.getRange(model->meshletData) && reader.getRange(model->meshletVertexData) && reader.getRange(model->meshletTriangleData);
+		model->metallicRoughnessWorkflow = (metallicRoughnessWorkflow != 0);
+		if (!valid) {
+			*error = "Mesh cache file is truncated";
+			return false;
+		}
+		return validate(*model, error);
+	}
+
+	bool writeMeshCache(const std::string &filename, const CachedModel &model, std::string *error)
+	{
+		Writer writer;
+		writer.put(cacheMagic);
+		writer.put(cacheVersion);
+		writer.put(model.key);
+		writer.put(static_cast<uint32_t>(model.dependencies.size()));
+		for (const CachedModel::Dependency &dependency : model.dependencies) {
+			writer.putString(dependency.uri);
+			writer.put(dependency.hash);
+		}
+		writer.put(static_cast<uint32_t>(model.nodes.size()));
+		for (const CachedModel::Node &node : model.nodes) {
+			writer.put(node.parent);
+			writer.put(node.index);
+			writer.putString(node.name);
+			writer.put(node.matrix);
+			writer.put(node.translation);
+			writer.put(node.scale);
+			writer.put(node.rotation);
+			writer.put(static_cast<uint8_t>(node.hasMesh ? 1 : 0));
+			writer.putString(node.meshName);
+			writer.put(node.firstPrimitive);
+			writer.put(node.primitiveCount);
+		}
+		writer.put(static_cast<uint32_t>(model.primitives.size()));
+		for (const CachedModel::Primitive &primitive : model.primitives) {
+			writer.put(primitive);
+		}
+		writer.put(static_cast<uint32_t>(model.lods.size()));
+		for (const CachedModel::Lod &lod : model.lods) {
+			writer.put(lod);
+		}
+		writer.put(static_cast<uint32_t>(model.materials.size()));
+		for (const CachedModel::Material &material : model.materials) {
+			writer.put(material);
+		}
+		writer.put(static_cast<uint32_t>(model.images.size()));
+		for (const CachedModel::Image &image : model.images) {
+			writer.putString(image.uri);
+			writer.put(image.width);
+			writer.put(image.height);
+			writer.put(image.component);
+			writer.putRange(image.pixels);
+		}
+		writer.put(static_cast<uint8_t>(model.metallicRoughnessWorkflow ? 1 : 0));
+		writer.put(model.indexSize);
+		writer.put(model.vertexCount);
+		writer.putRange(model.vertexData);
+		writer.putRange(model.indexData);
+		writer.putRange(model.meshletData);
+		writer.putRange(model.meshletVertexData);
+		writer.putRange(model.meshletTriangleData);
+
+		// A partially written file must never be picked up by readMeshCache, so the complete file is written to a unique temporary file
+		// and moved over the previous one, which also keeps concurrent writers of the same cache from interfering
+		const std::string temporaryFile = filename + "." + std::to_string(std::chrono::high_resolution_clock::now().time_since_epoch().count()) + ".tmp";
+		{
+			std::ofstream file(temporaryFile, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				*error = "Could not create " + temporaryFile;
+				return false;
+			}
+			file.write(reinterpret_cast<const char*>(writer.data.data()), writer.data.size());
+			if (!file.good()) {
+				file.close();
+				remove(temporaryFile.c_str());
+				*error = "Could not write " + temporaryFile;
+				return false;
+			}
+		}
+#if defined(_WIN32)
+		const bool moved = MoveFileExA(temporaryFile.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		const bool moved = rename(temporaryFile.c_str(), filename.c_str()) == 0;
+#endif
+		if (!moved) {
+			remove(temporaryFile.c_str());
+			*error = "Could not rename " + temporaryFile + " to " + filename;
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,132 @@
+/*
+* glTF mesh cache
+*
+* Binary file format for the processed data of a vkglTF::Model (vertex, index and meshlet data, primitives and their levels of
+* detail, node hierarchy, materials and decoded images), so models can be loaded without parsing the glTF file and decoding its
+* primitives and images again
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "VulkanglTFBinary.h"
+
+namespace vkglTF
+{
+	/**
+	* @brief Processed model data as stored in a mesh cache file
+	*
+	* Cache files are written in native byte order. When read, the data ranges point into the cache file's memory, so it has to stay
+	* mapped as long as they are used.
+	*/
+	struct CachedModel
+	{
+		/** @brief File read while loading the model, the cache is only valid as long as its hash matches */
+		struct Dependency
+		{
+			/** @brief Path relative to the model's directory */
+			std::string uri;
+			uint64_t hash = 0;
+		};
+		/** @brief Node in the order of Model::linearNodes, children are stored before their parents */
+		struct Node
+		{
+			/** @brief Index of the parent in CachedModel::nodes, -1 for root nodes */
+			int32_t parent = -1;
+			/** @brief glTF node index */
+			uint32_t index = 0;
+			std::string name;
+			glm::mat4 matrix = glm::mat4(1.0f);
+			glm::vec3 translation = glm::vec3(0.0f);
+			glm::vec3 scale = glm::vec3(1.0f);
+			glm::quat rotation = glm::quat();
+			bool hasMesh = false;
+			std::string meshName;
+			/** @brief Range of the mesh's primitives in CachedModel::primitives */
+			uint32_t firstPrimitive = 0;
+			uint32_t primitiveCount = 0;
+		};
+		struct Primitive
+		{
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+			uint32_t firstVertex = 0;
+			uint32_t vertexCount = 0;
+			uint32_t firstMeshlet = 0;
+			uint32_t meshletCount = 0;
+			/** @brief Range of the primitive's levels of detail in CachedModel::lods */
+			uint32_t firstLod = 0;
+			uint32_t lodCount = 0;
+			uint32_t material = 0;
+			glm::vec3 min = glm::vec3(0.0f);
+			glm::vec3 max = glm::vec3(0.0f);
+		};
+		/** @brief Simplified index range of a primitive */
+		struct Lod
+		{
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+			float error = 0.0f;
+		};
+		struct Material
+		{
+			/** @brief Texture references are indices into CachedModel::images or one of these values */
+			enum { NoTexture = -1, EmptyTexture = -2 };
+			uint32_t alphaMode = 0;
+			float alphaCutoff = 1.0f;
+			float metallicFactor = 1.0f;
+			float roughnessFactor = 1.0f;
+			glm::vec4 baseColorFactor = glm::vec4(1.0f);
+			int32_t baseColorTexture = NoTexture;
+			int32_t metallicRoughnessTexture = NoTexture;
+			int32_t normalTexture = NoTexture;
+			int32_t occlusionTexture = NoTexture;
+			int32_t emissiveTexture = NoTexture;
+		};
+		/** @brief Decoded 8 bit pixels of an image, or only its URI for images loaded from external KTX files */
+		struct Image
+		{
+			std::string uri;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t component = 0;
+			DataRange pixels;
+		};
+
+		/** @brief Hash of the source file and all loading parameters that change the processed data */
+		uint64_t key = 0;
+		std::vector<Dependency> dependencies;
+		std::vector<Node> nodes;
+		std::vector<Primitive> primitives;
+		std::vector<Lod> lods;
+		std::vector<Material> materials;
+		std::vector<Image> images;
+		bool metallicRoughnessWorkflow = true;
+		/** @brief Size of an index in bytes, 2 or 4 */
+		uint32_t indexSize = 4;
+		uint32_t vertexCount = 0;
+		/** @brief Vertex data as laid out by the model's vertex layout */
+		DataRange vertexData;
+		DataRange indexData;
+		/** @brief Meshlet array, meshlet vertex indices and meshlet triangles, empty unless the model was loaded with meshlets */
+		DataRange meshletData;
+		DataRange meshletVertexData;
+		DataRange meshletTriangleData;
+	};
+
+	/** @brief Returns the name of the mesh cache file stored next to a glTF file */
+	std::string getMeshCacheFileName(const std::string &filename);
+	/** @brief Reads the cache file contents from memory and validates all ranges and references, data has to stay valid as long as the cached model is used */
+	bool readMeshCache(const uint8_t *data, size_t size, CachedModel *model, std::string *error);
+	/** @brief Writes a mesh cache file, the file is written under a temporary name and renamed once it's complete */
+	bool writeMeshCache(const std::string &filename, const CachedModel &model, std::string *error);
+}
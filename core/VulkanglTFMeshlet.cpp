@@ -0,0 +1,133 @@
+/*
+* glTF meshlet generation
+*
+* Splits indexed triangle lists into small clusters of triangles (meshlets) with bounding spheres and normal cones, so they can
+* be culled individually against the view frustum and for back-facing triangles
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanglTFMeshlet.h"
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+namespace vkglTF
+{
+	namespace
+	{
+		const uint8_t unusedVertex = 0xFF;
+
+		glm::vec3 getPosition(const float *positions, size_t positionStride, uint32_t vertex)
+		{
+			const float *position = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + vertex * positionStride);
+			return glm::vec3(position[0], position[1], position[2]);
+		}
+
+		/** @brief Computes the bounding sphere and normal cone of a meshlet whose vertices and triangles have been appended */
+		void computeBounds(Meshlet &meshlet, const float *positions, size_t positionStride, uint32_t vertexOffset, const std::vector<uint32_t> &meshletVertices, const std::vector<uint8_t> &meshletTriangles)
+		{
+			const uint32_t *vertices = &meshletVertices[meshlet.vertexOffset];
+			glm::vec3 min(std::numeric_limits<float>::max());
+			glm::vec3 max(-std::numeric_limits<float>::max());
+			for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+				const glm::vec3 position = getPosition(positions, positionStride, vertices[i] - vertexOffset);
+				min = glm::min(min, position);
+				max = glm::max(max, position);
+			}
+			meshlet.center = (min + max) * 0.5f;
+			meshlet.radius = 0.0f;
+			for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+				meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.center, getPosition(positions, positionStride, vertices[i] - vertexOffset)));
+			}
+
+			// The cone axis is the average triangle normal, its angle has to cover the normals of all non-degenerate triangles
+			std::vector<glm::vec3> normals(meshlet.triangleCount);
+			std::vector<glm::vec3> centroids(meshlet.triangleCount);
+			glm::vec3 normalSum(0.0f);
+			for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+				const uint8_t *triangle = &meshletTriangles[meshlet.triangleOffset + t * 3];
+				const glm::vec3 p0 = getPosition(positions, positionStride, vertices[triangle[0]] - vertexOffset);
+				const glm::vec3 p1 = getPosition(positions, positionStride, vertices[triangle[1]] - vertexOffset);
+				const glm::vec3 p2 = getPosition(positions, positionStride, vertices[triangle[2]] - vertexOffset);
+				const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+				const float length = glm::length(normal);
+				normals[t] = (length > 0.0f) ? normal / length : glm::vec3(0.0f);
+				centroids[t] = (p0 + p1 + p2) / 3.0f;
+				normalSum += normals[t];
+			}
+			const float axisLength = glm::length(normalSum);
+			meshlet.coneAxis = (axisLength > 0.0f) ? normalSum / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+			meshlet.coneApex = meshlet.center;
+			meshlet.coneCutoff = 1.0f;
+			float minDot = 1.0f;
+			for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+				if (normals[t] != glm::vec3(0.0f)) {
+					minDot = std::min(minDot, glm::dot(normals[t], meshlet.coneAxis));
+				}
+			}
+			// Cones wider than about 84 degrees would hardly ever cull anything
+			if ((axisLength == 0.0f) || (minDot <= 0.1f)) {
+				return;
+			}
+			// The apex is moved back along the axis until every triangle's plane is in front of it, so the test is exact for perspective views
+			float maxDistance = 0.0f;
+			for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+				if (normals[t] != glm::vec3(0.0f)) {
+					const float distance = glm::dot(meshlet.center - centroids[t], normals[t]) / glm::dot(meshlet.coneAxis, normals[t]);
+					maxDistance = std::max(maxDistance, distance);
+				}
+			}
+			meshlet.coneApex = meshlet.center - meshlet.coneAxis * maxDistance;
+			meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+		}
+	}
+
+	void buildMeshlets(const uint32_t *indices, size_t indexCount, const float *positions, size_t positionStride, size_t vertexCount, uint32_t vertexOffset,
+		std::vector<Meshlet> &meshlets, std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles)
+	{
+		// Local index of each vertex in the current meshlet
+		std::vector<uint8_t> localIndices(vertexCount, unusedVertex);
+		Meshlet meshlet{};
+
+		auto finishMeshlet = [&]() {
+			computeBounds(meshlet, positions, positionStride, vertexOffset, meshletVertices, meshletTriangles);
+			for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+				localIndices[meshletVertices[meshlet.vertexOffset + i] - vertexOffset] = unusedVertex;
+			}
+			meshlets.push_back(meshlet);
+			// Triangles of each meshlet start at a four byte boundary, so shaders can read them as 32 bit words
+			meshletTriangles.resize((meshletTriangles.size() + 3) & ~size_t(3), 0);
+			meshlet = Meshlet{};
+		};
+
+		meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+		for (size_t i = 0; i + 2 < indexCount; i += 3) {
+			const uint32_t *triangle = indices + i;
+			uint32_t newVertices = 0;
+			for (uint32_t c = 0; c < 3; c++) {
+				newVertices += (localIndices[triangle[c]] == unusedVertex) ? 1 : 0;
+			}
+			// Repeated indices in degenerate triangles are counted twice, which only ends a meshlet slightly earlier
+			if ((meshlet.vertexCount + newVertices > maxMeshletVertices) || (meshlet.triangleCount + 1 > maxMeshletTriangles)) {
+				finishMeshlet();
+				meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+				meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+			}
+			for (uint32_t c = 0; c < 3; c++) {
+				uint8_t &localIndex = localIndices[triangle[c]];
+				if (localIndex == unusedVertex) {
+					localIndex = static_cast<uint8_t>(meshlet.vertexCount++);
+					meshletVertices.push_back(triangle[c] + vertexOffset);
+				}
+				meshletTriangles.push_back(localIndex);
+			}
+			meshlet.triangleCount++;
+		}
+		if (meshlet.triangleCount > 0) {
+			finishMeshlet();
+		}
+	}
+}
@@ -0,0 +1,58 @@
+/*
+* glTF meshlet generation
+*
+* Splits indexed triangle lists into small clusters of triangles (meshlets) with bounding spheres and normal cones, so they can
+* be culled individually against the view frustum and for back-facing triangles
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vkglTF
+{
+	/** @brief Maximum number of unique vertices per meshlet */
+	const uint32_t maxMeshletVertices = 64;
+	/** @brief Maximum number of triangles per meshlet */
+	const uint32_t maxMeshletTriangles = 124;
+
+	/**
+	* @brief Cluster of triangles of a primitive, laid out for shader storage buffers (std430)
+	*
+	* A meshlet can be culled if it's outside of the view frustum, tested with its bounding sphere, or if all of its triangles face
+	* away from the camera, which is the case if dot(normalize(coneApex - cameraPosition), coneAxis) >= coneCutoff. Positions are in
+	* the space of the vertex buffer, which is the mesh's space unless the model was loaded with pre-transformed vertices.
+	*/
+	struct Meshlet
+	{
+		glm::vec3 center;
+		float radius;
+		glm::vec3 coneApex;
+		/** @brief Cosine of the cone's half angle, 1 if the triangles' normals spread too far for the cone to ever cull the meshlet */
+		float coneCutoff;
+		glm::vec3 coneAxis;
+		/** @brief Index of the meshlet's first entry in the meshlet vertex indices */
+		uint32_t vertexOffset;
+		/** @brief Byte offset of the meshlet's first triangle in the meshlet triangles, always a multiple of four */
+		uint32_t triangleOffset;
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+		uint32_t padding;
+	};
+
+	/**
+	* @brief Splits a triangle list into meshlets in index order and appends them
+	*
+	* Every meshlet references up to maxMeshletVertices vertices, whose indices (with vertexOffset added) are appended to
+	* meshletVertices, and up to maxMeshletTriangles triangles, appended to meshletTriangles as three 8 bit indices into the meshlet's
+	* vertices each. Triangles follow the order of the index buffer, so it should be optimized for vertex locality first.
+	*/
+	void buildMeshlets(const uint32_t *indices, size_t indexCount, const float *positions, size_t positionStride, size_t vertexCount, uint32_t vertexOffset,
+		std::vector<Meshlet> &meshlets, std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles);
+}
@@ -12,16 +12,65 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "VulkanglTFModel.h"
+#include "VulkanglTFBinary.h"
+#include "VulkanglTFCache.h"
+#include "VulkanglTFOptimizer.h"
+#include "VulkanglTFSimplifier.h"
+#include "PixelConversion.h"
+#include "MappedFile.h"
+#include "JobSystem.h"
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
 
+namespace
+{
+	/** @brief Encoded image data collected while tinygltf parses the file */
+	struct EncodedImage
+	{
+		bool pending = false;
+		/** @brief Image memory of a .glb file or a data URI, which stays valid until loadSource returns */
+		const unsigned char* bytes = nullptr;
+		int size = 0;
+		/** @brief Copy of data that is only valid during the image loader callback (external image files and buffer views) */
+		std::vector<unsigned char> storage;
+		int requestedWidth = 0;
+		int requestedHeight = 0;
+	};
+
+	/** @brief User data of deferImageDataFunc */
+	struct DeferredImages
+	{
+		const std::vector<vkglTF::DataRange>* embedded = nullptr;
+		std::vector<EncodedImage> images;
+	};
+
+	/** @brief Waits for a job when leaving the scope, so a job referring to local variables can't outlive them if its owner returns early or throws */
+	struct JobWaitGuard
+	{
+		vks::JobHandle job;
+		~JobWaitGuard()
+		{
+			if (!job) {
+				return;
+			}
+			// Only reached when the owner leaves early, which already reports its own error
+			try {
+				vks::JobSystem::instance().wait(job);
+			}
+			catch (...) {
+			}
+		}
+	};
+}
+
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
+	Images are only collected while tinygltf parses the file and decoded on the job system afterwards, see decodeImages
 */
-bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
+bool deferImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string*, std::string*, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
 {
 	// KTX files will be handled by our own code
 	if (image->uri.find_last_of(".") != std::string::npos) {
@@ -30,7 +79,84 @@ bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string
 		}
 	}
 
-	return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
+	DeferredImages& deferred = *static_cast<DeferredImages*>(userData);
+	if (imageIndex >= static_cast<int>(deferred.images.size())) {
+		deferred.images.resize(imageIndex + 1);
+	}
+	EncodedImage& encoded = deferred.images[imageIndex];
+	encoded.pending = true;
+	encoded.requestedWidth = req_width;
+	encoded.requestedHeight = req_height;
+	// Images stored in the binary chunk of a .glb file or decoded from data URIs are read from that memory, tinygltf only sees a placeholder
+	if (deferred.embedded && (imageIndex < static_cast<int>(deferred.embedded->size())) && (*deferred.embedded)[imageIndex].data) {
+		encoded.bytes = (*deferred.embedded)[imageIndex].data;
+		encoded.size = static_cast<int>((*deferred.embedded)[imageIndex].size);
+	} else {
+		encoded.storage.assign(bytes, bytes + size);
+		encoded.size = size;
+	}
+	return true;
+}
+
+/*
+	Decodes an image with stb_image, 8 bit RGB images keep their three components so Texture::fromglTfImage can upload them as is or
+	expand them while copying them to the staging memory, all other images are decoded to RGBA by tinygltf
+*/
+bool decodeImage(tinygltf::Image& image, int imageIndex, const EncodedImage& encoded, std::string& error)
+{
+	const unsigned char* bytes = encoded.storage.empty() ? encoded.bytes : encoded.storage.data();
+	int width = 0;
+	int height = 0;
+	int components = 0;
+	if (!stbi_info_from_memory(bytes, encoded.size, &width, &height, &components) || (components != 3) || stbi_is_16_bit_from_memory(bytes, encoded.size)) {
+		std::string warning;
+		return tinygltf::LoadImageData(&image, imageIndex, &error, &warning, encoded.requestedWidth, encoded.requestedHeight, bytes, encoded.size, nullptr);
+	}
+	unsigned char* data = stbi_load_from_memory(bytes, encoded.size, &width, &height, &components, 3);
+	if (!data) {
+		error = "Could not decode image " + std::to_string(imageIndex) + "\n";
+		return false;
+	}
+	if (((encoded.requestedWidth > 0) && (encoded.requestedWidth != width)) || ((encoded.requestedHeight > 0) && (encoded.requestedHeight != height))) {
+		stbi_image_free(data);
+		error = "Image size mismatch for image " + std::to_string(imageIndex) + "\n";
+		return false;
+	}
+	image.width = width;
+	image.height = height;
+	image.component = 3;
+	image.bits = 8;
+	image.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+	image.image.assign(data, data + static_cast<size_t>(width) * height * 3);
+	stbi_image_free(data);
+	return true;
+}
+
+/*
+	Decodes the images collected by deferImageDataFunc in parallel, each job writes to its own image only
+*/
+bool decodeImages(DeferredImages& deferred, std::vector<tinygltf::Image>& images, std::string& error)
+{
+	const uint32_t imageCount = static_cast<uint32_t>(std::min(deferred.images.size(), images.size()));
+	std::vector<std::string> errors(imageCount);
+	vks::JobSystem &jobSystem = vks::JobSystem::instance();
+	jobSystem.wait(jobSystem.parallelFor(imageCount, 1, [&](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++) {
+			EncodedImage& encoded = deferred.images[i];
+			if (!encoded.pending) {
+				continue;
+			}
+			if (!decodeImage(images[i], static_cast<int>(i), encoded, errors[i]) && errors[i].empty()) {
+				errors[i] = "Could not decode image " + std::to_string(i) + "\n";
+			}
+			// The encoded data is no longer needed once the image has been decoded
+			std::vector<unsigned char>().swap(encoded.storage);
+		}
+	}));
+	for (const std::string& imageError : errors) {
+		error += imageError;
+	}
+	return error.empty();
 }
 
 bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData) 
@@ -57,12 +183,12 @@ void vkglTF::Texture::destroy()
 	{
 		vkDestroyImageView(device->logicalDevice, view, nullptr);
 		vkDestroyImage(device->logicalDevice, image, nullptr);
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		device->freeMemory(allocation);
 		vkDestroySampler(device->logicalDevice, sampler, nullptr);
 	}
 }
 
-void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue, bool asyncUpload)
 {
 	this->device = device;
 
@@ -79,65 +205,44 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 	if (!isKtx) {
 		// Texture was loaded using STB_Image
 
-		unsigned char* buffer = nullptr;
-		VkDeviceSize bufferSize = 0;
-		bool deleteBuffer = false;
+		width = gltfimage.width;
+		height = gltfimage.height;
+		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+
+		// RGB images are uploaded as is if the device can sample and blit (for the mip chain) them, most devices don't support RGB only
+		// on Vulkan though, so the pixels are expanded to RGBA while they are written to the staging memory otherwise
+		VkFormatProperties formatProperties;
+		const VkFormatFeatureFlags rgbFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+		format = VK_FORMAT_R8G8B8A8_UNORM;
+		bool expandRGB = false;
 		if (gltfimage.component == 3) {
-			// Most devices don't support RGB only on Vulkan so convert if necessary
-			// TODO: Check actual format support and transform only if required
-			bufferSize = gltfimage.width * gltfimage.height * 4;
-			buffer = new unsigned char[bufferSize];
-			unsigned char* rgba = buffer;
-			unsigned char* rgb = &gltfimage.image[0];
-			for (size_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
-				for (int32_t j = 0; j < 3; ++j) {
-					rgba[j] = rgb[j];
-				}
-				rgba += 4;
-				rgb += 3;
+			vkGetPhysicalDeviceFormatProperties(device->physicalDevice, VK_FORMAT_R8G8B8_UNORM, &formatProperties);
+			if ((formatProperties.optimalTilingFeatures & rgbFeatures) == rgbFeatures) {
+				format = VK_FORMAT_R8G8B8_UNORM;
+			}
+			else {
+				expandRGB = true;
 			}
-			deleteBuffer = true;
 		}
-		else {
-			buffer = &gltfimage.image[0];
-			bufferSize = gltfimage.image.size();
+		if (format == VK_FORMAT_R8G8B8A8_UNORM) {
+			vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
+			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
 		}
 
-		format = VK_FORMAT_R8G8B8A8_UNORM;
-
-		VkFormatProperties formatProperties;
-
-		width = gltfimage.width;
-		height = gltfimage.height;
-		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
-
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
-
-		VkMemoryAllocateInfo memAllocInfo{};
-		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		VkMemoryRequirements memReqs{};
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo{};
-		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCreateInfo.size = bufferSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		const unsigned char* pixels = gltfimage.image.data();
+		const size_t pixelCount = static_cast<size_t>(width) * height;
+		const VkDeviceSize bufferSize = expandRGB ? pixelCount * 4 : gltfimage.image.size();
+		// Copy offsets have to be a multiple of the texel size, 48 keeps the ring's usual 16 byte alignment for 3 byte texels
+		const VkDeviceSize stagingAlignment = (format == VK_FORMAT_R8G8B8_UNORM) ? 48 : 16;
+		auto fillStaging = [pixels, pixelCount, bufferSize, expandRGB](void* mapped) {
+			if (expandRGB) {
+				vks::pixels::expandRGBToRGBA(pixels, static_cast<uint8_t*>(mapped), pixelCount);
+			}
+			else {
+				memcpy(mapped, pixels, static_cast<size_t>(bufferSize));
+			}
+		};
 
 		VkImageCreateInfo imageCreateInfo{};
 		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -153,31 +258,14 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		imageCreateInfo.extent = { width, height, 1 };
 		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation, vks::MemoryCategory::Texture));
+		deviceMemory = allocation.memory;
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		subresourceRange.levelCount = 1;
 		subresourceRange.layerCount = 1;
 
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = 0;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
-
 		VkBufferImageCopy bufferCopyRegion = {};
 		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		bufferCopyRegion.imageSubresource.mipLevel = 0;
@@ -187,49 +275,93 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		bufferCopyRegion.imageExtent.height = height;
 		bufferCopyRegion.imageExtent.depth = 1;
 
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
+		// Expects the first level in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, captures copies as the texture may have moved until an async upload is acquired
+		VkImage mipImage = image;
+		uint32_t mipWidth = width;
+		uint32_t mipHeight = height;
+		uint32_t mipCount = mipLevels;
+		auto generateMipChain = [mipImage, mipWidth, mipHeight, mipCount](VkCommandBuffer blitCmd) {
+			for (uint32_t i = 1; i < mipCount; i++) {
+				VkImageBlit imageBlit{};
+
+				imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				imageBlit.srcSubresource.layerCount = 1;
+				imageBlit.srcSubresource.mipLevel = i - 1;
+				imageBlit.srcOffsets[1].x = int32_t(mipWidth >> (i - 1));
+				imageBlit.srcOffsets[1].y = int32_t(mipHeight >> (i - 1));
+				imageBlit.srcOffsets[1].z = 1;
+
+				imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				imageBlit.dstSubresource.layerCount = 1;
+				imageBlit.dstSubresource.mipLevel = i;
+				imageBlit.dstOffsets[1].x = int32_t(mipWidth >> i);
+				imageBlit.dstOffsets[1].y = int32_t(mipHeight >> i);
+				imageBlit.dstOffsets[1].z = 1;
+
+				VkImageSubresourceRange mipSubRange = {};
+				mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				mipSubRange.baseMipLevel = i;
+				mipSubRange.levelCount = 1;
+				mipSubRange.layerCount = 1;
+
+				{
+					VkImageMemoryBarrier imageMemoryBarrier{};
+					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					imageMemoryBarrier.srcAccessMask = 0;
+					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					imageMemoryBarrier.image = mipImage;
+					imageMemoryBarrier.subresourceRange = mipSubRange;
+					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				}
 
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
+				vkCmdBlitImage(blitCmd, mipImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mipImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+				{
+					VkImageMemoryBarrier imageMemoryBarrier{};
+					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+					imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+					imageMemoryBarrier.image = mipImage;
+					imageMemoryBarrier.subresourceRange = mipSubRange;
+					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				}
+			}
 
-		device->flushCommandBuffer(copyCmd, copyQueue, true);
+			VkImageSubresourceRange subresourceRange = {};
+			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			subresourceRange.levelCount = mipCount;
+			subresourceRange.layerCount = 1;
 
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+			{
+				VkImageMemoryBarrier imageMemoryBarrier{};
+				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				imageMemoryBarrier.image = mipImage;
+				imageMemoryBarrier.subresourceRange = subresourceRange;
+				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			}
+		};
+		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		for (uint32_t i = 1; i < mipLevels; i++) {
-			VkImageBlit imageBlit{};
-
-			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.srcSubresource.layerCount = 1;
-			imageBlit.srcSubresource.mipLevel = i - 1;
-			imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-			imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-			imageBlit.srcOffsets[1].z = 1;
-
-			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.dstSubresource.layerCount = 1;
-			imageBlit.dstSubresource.mipLevel = i;
-			imageBlit.dstOffsets[1].x = int32_t(width >> i);
-			imageBlit.dstOffsets[1].y = int32_t(height >> i);
-			imageBlit.dstOffsets[1].z = 1;
-
-			VkImageSubresourceRange mipSubRange = {};
-			mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			mipSubRange.baseMipLevel = i;
-			mipSubRange.levelCount = 1;
-			mipSubRange.layerCount = 1;
+		if (asyncUpload) {
+			// The first level is copied on the transfer queue, transfer queues can't blit so the mip chain is generated once the graphics queue has acquired the image
+			uploadTicket = device->asyncTransfer.uploadImage(image, bufferSize, stagingAlignment, fillStaging, { bufferCopyRegion }, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, generateMipChain);
+		}
+		else {
+			vks::StagingRegion staging = device->stagingRing.allocate(copyQueue, bufferSize, stagingAlignment);
+			fillStaging(staging.mapped);
+			bufferCopyRegion.bufferOffset = staging.offset;
+
+			// The copy and the mip chain generation are recorded into the staging ring's current batch
+			VkCommandBuffer copyCmd = device->stagingRing.getCommandBuffer(copyQueue);
 
 			{
 				VkImageMemoryBarrier imageMemoryBarrier{};
@@ -239,11 +371,11 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 				imageMemoryBarrier.srcAccessMask = 0;
 				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				imageMemoryBarrier.subresourceRange = subresourceRange;
+				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 			}
 
-			vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+			vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
 			{
 				VkImageMemoryBarrier imageMemoryBarrier{};
@@ -253,31 +385,12 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				imageMemoryBarrier.subresourceRange = subresourceRange;
+				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 			}
-		}
 
-		subresourceRange.levelCount = mipLevels;
-		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			generateMipChain(copyCmd);
 		}
-
-        if (deleteBuffer) {
-            delete[] buffer;
-        }
-
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
 	}
 	else {
 		// Texture is stored in an external ktx file
@@ -320,30 +433,6 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
-
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
 		for (uint32_t i = 0; i < mipLevels; i++)
 		{
@@ -376,11 +465,8 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation, vks::MemoryCategory::Texture));
+		deviceMemory = allocation.memory;
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -388,15 +474,21 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		subresourceRange.levelCount = mipLevels;
 		subresourceRange.layerCount = 1;
 
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-		device->flushCommandBuffer(copyCmd, copyQueue);
+		if (asyncUpload) {
+			uploadTicket = device->asyncTransfer.uploadImage(image, ktxTextureData, ktxTextureSize, bufferCopyRegions, subresourceRange, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+		else {
+			vks::StagingRegion staging = device->stagingRing.upload(copyQueue, ktxTextureData, ktxTextureSize);
+			for (auto &bufferCopyRegion : bufferCopyRegions) {
+				bufferCopyRegion.bufferOffset += staging.offset;
+			}
+			VkCommandBuffer copyCmd = device->stagingRing.getCommandBuffer(copyQueue);
+			vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+			vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+			vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		}
 		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
 		ktxTexture_Destroy(ktxTexture);
 	}
 
@@ -487,21 +579,10 @@ void vkglTF::Primitive::setDimensions(glm::vec3 min, glm::vec3 max) {
 */
 vkglTF::Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix) {
 	this->device = device;
-	this->uniformBlock.matrix = matrix;
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		sizeof(uniformBlock),
-		&uniformBuffer.buffer,
-		&uniformBuffer.memory,
-		&uniformBlock));
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
-	uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
+	this->matrix = matrix;
 };
 
 vkglTF::Mesh::~Mesh() {
-	vkDestroyBuffer(device->logicalDevice, uniformBuffer.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, uniformBuffer.memory, nullptr);
     for(auto primitive : primitives)
     {
         delete primitive;
@@ -528,20 +609,18 @@ glm::mat4 vkglTF::Node::getMatrix() {
 void vkglTF::Node::update() {
 	if (mesh) {
 		glm::mat4 m = getMatrix();
+		mesh->matrix = m;
 		if (skin) {
-			mesh->uniformBlock.matrix = m;
-			// Update join matrices
+			// Update join matrices, these are written to the uniform allocator by Model::updateUniforms
 			glm::mat4 inverseTransform = glm::inverse(m);
-			for (size_t i = 0; i < skin->joints.size(); i++) {
+			size_t numJoints = std::min(skin->joints.size(), static_cast<size_t>(MAX_NUM_JOINTS));
+			mesh->jointMatrices.resize(numJoints);
+			for (size_t i = 0; i < numJoints; i++) {
 				vkglTF::Node *jointNode = skin->joints[i];
 				glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
 				jointMat = inverseTransform * jointMat;
-				mesh->uniformBlock.jointMatrix[i] = jointMat;
+				mesh->jointMatrices[i] = jointMat;
 			}
-			mesh->uniformBlock.jointcount = (float)skin->joints.size();
-			memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
-		} else {
-			memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
 		}
 	}
 
@@ -614,6 +693,179 @@ VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputStat
 	return &pipelineVertexInputStateCreateInfo;
 }
 
+/*
+	Compact vertex layouts
+*/
+
+namespace
+{
+	/** @brief Writes count float values to a vertex buffer element of the given format */
+	void writeVertexElement(uint8_t *dst, const float *values, uint32_t count, VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_R32G32_SFLOAT:
+		case VK_FORMAT_R32G32B32_SFLOAT:
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			memcpy(dst, values, count * sizeof(float));
+			break;
+		case VK_FORMAT_R16G16_SFLOAT: {
+			const uint16_t halfs[2] = { vkglTF::floatToHalf(values[0]), vkglTF::floatToHalf(values[1]) };
+			memcpy(dst, halfs, sizeof(halfs));
+			break;
+		}
+		case VK_FORMAT_R8G8B8A8_SNORM:
+			for (uint32_t i = 0; i < 4; i++) {
+				dst[i] = static_cast<uint8_t>((i < count) ? vkglTF::floatToSnorm8(values[i]) : 0);
+			}
+			break;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+			for (uint32_t i = 0; i < 4; i++) {
+				dst[i] = (i < count) ? vkglTF::floatToUnorm8(values[i]) : 0;
+			}
+			break;
+		case VK_FORMAT_R8G8B8A8_UINT:
+			for (uint32_t i = 0; i < 4; i++) {
+				dst[i] = (i < count) ? static_cast<uint8_t>(std::min(std::max(values[i], 0.0f), 255.0f)) : 0;
+			}
+			break;
+		case VK_FORMAT_R16G16B16A16_UNORM: {
+			uint16_t unorms[4] = {};
+			for (uint32_t i = 0; i < count; i++) {
+				unorms[i] = vkglTF::floatToUnorm16(values[i]);
+			}
+			memcpy(dst, unorms, sizeof(unorms));
+			break;
+		}
+		default:
+			assert(!"Unsupported vertex format");
+			break;
+		}
+	}
+}
+
+VkFormat vkglTF::VertexLayout::getFormat(VertexComponent component) const
+{
+	// All formats are mandatory for vertex buffers, so no format support queries are required
+	switch (component) {
+		case VertexComponent::Position:
+			return VK_FORMAT_R32G32B32_SFLOAT;
+		case VertexComponent::Normal:
+			return quantized ? VK_FORMAT_R8G8B8A8_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+		case VertexComponent::UV:
+			return quantized ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT;
+		case VertexComponent::Color:
+			return quantized ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32A32_SFLOAT;
+		case VertexComponent::Tangent:
+			return quantized ? VK_FORMAT_R8G8B8A8_SNORM : VK_FORMAT_R32G32B32A32_SFLOAT;
+		case VertexComponent::Joint0:
+			return quantized ? VK_FORMAT_R8G8B8A8_UINT : VK_FORMAT_R32G32B32A32_SFLOAT;
+		case VertexComponent::Weight0:
+			return quantized ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32A32_SFLOAT;
+		default:
+			return VK_FORMAT_UNDEFINED;
+	}
+}
+
+uint32_t vkglTF::VertexLayout::getSize(VertexComponent component) const
+{
+	switch (getFormat(component)) {
+		case VK_FORMAT_R8G8B8A8_SNORM:
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_UINT:
+		case VK_FORMAT_R16G16_SFLOAT:
+			return 4;
+		case VK_FORMAT_R32G32_SFLOAT:
+		case VK_FORMAT_R16G16B16A16_UNORM:
+			return 8;
+		case VK_FORMAT_R32G32B32_SFLOAT:
+			return 12;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return 16;
+		default:
+			return 0;
+	}
+}
+
+uint32_t vkglTF::VertexLayout::getVertexSize() const
+{
+	uint32_t size = 0;
+	for (VertexComponent component : components) {
+		size += getSize(component);
+	}
+	return size;
+}
+
+VkDeviceSize vkglTF::VertexLayout::getOffset(uint32_t componentIndex, uint32_t vertexCount) const
+{
+	// All sizes are multiples of four, so every element stays aligned to its format
+	VkDeviceSize offset = 0;
+	for (uint32_t i = 0; i < componentIndex; i++) {
+		offset += getSize(components[i]);
+	}
+	return deinterleaved ? offset * vertexCount : offset;
+}
+
+uint32_t vkglTF::VertexLayout::getStride(uint32_t componentIndex) const
+{
+	return deinterleaved ? getSize(components[componentIndex]) : getVertexSize();
+}
+
+void vkglTF::VertexLayout::pack(const Vertex* vertices, uint32_t first, uint32_t last, uint32_t vertexCount, uint8_t* dst) const
+{
+	for (uint32_t c = 0; c < static_cast<uint32_t>(components.size()); c++) {
+		const VkFormat format = getFormat(components[c]);
+		const uint32_t stride = getStride(c);
+		size_t member = 0;
+		uint32_t count = 4;
+		switch (components[c]) {
+			case VertexComponent::Position:
+				member = offsetof(Vertex, pos);
+				count = 3;
+				break;
+			case VertexComponent::Normal:
+				member = offsetof(Vertex, normal);
+				count = 3;
+				break;
+			case VertexComponent::UV:
+				member = offsetof(Vertex, uv);
+				count = 2;
+				break;
+			case VertexComponent::Color:
+				member = offsetof(Vertex, color);
+				break;
+			case VertexComponent::Tangent:
+				member = offsetof(Vertex, tangent);
+				break;
+			case VertexComponent::Joint0:
+				member = offsetof(Vertex, joint0);
+				break;
+			case VertexComponent::Weight0:
+				member = offsetof(Vertex, weight0);
+				break;
+		}
+		uint8_t *out = dst + getOffset(c, vertexCount) + static_cast<VkDeviceSize>(first) * stride;
+		for (uint32_t v = first; v < last; v++) {
+			writeVertexElement(out, reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(&vertices[v]) + member), count, format);
+			out += stride;
+		}
+	}
+}
+
+VkPipelineVertexInputStateCreateInfo* vkglTF::VertexLayout::getPipelineVertexInputState()
+{
+	bindingDescriptions.clear();
+	attributeDescriptions.clear();
+	for (uint32_t c = 0; c < static_cast<uint32_t>(components.size()); c++) {
+		const uint32_t binding = deinterleaved ? c : 0;
+		if (deinterleaved || (c == 0)) {
+			bindingDescriptions.push_back({ binding, getStride(c), VK_VERTEX_INPUT_RATE_VERTEX });
+		}
+		attributeDescriptions.push_back({ c, binding, getFormat(components[c]), static_cast<uint32_t>(getOffset(c, 0)) });
+	}
+	pipelineVertexInputStateCreateInfo = vks::initializers::pipelineVertexInputStateCreateInfo(bindingDescriptions, attributeDescriptions);
+	return &pipelineVertexInputStateCreateInfo;
+}
+
 vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
 {
 
@@ -635,30 +887,11 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	unsigned char* buffer = new unsigned char[bufferSize];
 	memset(buffer, 0, bufferSize);
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingMemory;
-	VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-	bufferCreateInfo.size = bufferSize;
-	// This buffer is used as a transfer source for the buffer copy
-	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-	VkMemoryRequirements memReqs;
-	vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-	// Copy texture data into staging buffer
-	uint8_t* data;
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-	memcpy(data, buffer, bufferSize);
-	vkUnmapMemory(device->logicalDevice, stagingMemory);
+	// Copy texture data into the staging ring
+	vks::StagingRegion staging = device->stagingRing.upload(transferQueue, buffer, bufferSize);
 
 	VkBufferImageCopy bufferCopyRegion = {};
+	bufferCopyRegion.bufferOffset = staging.offset;
 	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	bufferCopyRegion.imageSubresource.layerCount = 1;
 	bufferCopyRegion.imageExtent.width = emptyTexture.width;
@@ -679,11 +912,8 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &emptyTexture.image));
 
-	vkGetImageMemoryRequirements(device->logicalDevice, emptyTexture.image, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &emptyTexture.deviceMemory));
-	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, emptyTexture.image, emptyTexture.deviceMemory, 0));
+	VK_CHECK_RESULT(device->allocateImageMemory(emptyTexture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &emptyTexture.allocation, vks::MemoryCategory::Texture));
+	emptyTexture.deviceMemory = emptyTexture.allocation.memory;
 
 	VkImageSubresourceRange subresourceRange{};
 	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -691,17 +921,12 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	subresourceRange.levelCount = 1;
 	subresourceRange.layerCount = 1;
 
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	VkCommandBuffer copyCmd = device->stagingRing.getCommandBuffer(transferQueue);
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-	vkCmdCopyBufferToImage(copyCmd, stagingBuffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+	vkCmdCopyBufferToImage(copyCmd, staging.buffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-	device->flushCommandBuffer(copyCmd, transferQueue);
 	emptyTexture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	// Clean up staging resources
-	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
 	VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
 	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
 	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
@@ -731,19 +956,37 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 */
 vkglTF::Model::~Model()
 {
-	vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
-	for (auto texture : textures) {
-		texture.destroy();
+	// A model destroyed while it's being parsed has to wait for the job, the Vulkan resources haven't been created yet
+	if (loadJob) {
+		vks::JobSystem::instance().wait(loadJob);
 	}
+	const bool loading = (loadState != nullptr);
 	for (auto node : nodes) {
 		delete node;
 	}
     for (auto skin : skins) {
         delete skin;
     }
+	// Models only parsed to bake a mesh cache have no Vulkan resources
+	if (!device || loading) {
+		return;
+	}
+	// Resources of a model that is still streaming in are referenced by pending transfer and acquire commands
+	if (!isReady()) {
+		device->asyncTransfer.waitIdle();
+		device->stagingRing.waitIdle();
+	}
+	vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
+	device->freeMemory(vertices.memory);
+	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
+	device->freeMemory(indices.memory);
+	if (meshlets.buffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(device->logicalDevice, meshlets.buffer, nullptr);
+		device->freeMemory(meshlets.memory);
+	}
+	for (auto texture : textures) {
+		texture.destroy();
+	}
 	if (descriptorSetLayoutUbo != VK_NULL_HANDLE) {
 		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutUbo, nullptr);
 		descriptorSetLayoutUbo = VK_NULL_HANDLE;
@@ -756,7 +999,7 @@ vkglTF::Model::~Model()
 	emptyTexture.destroy();
 }
 
-void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale)
+void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, uint32_t& indexCount, uint32_t& vertexCount, float globalscale)
 {
 	vkglTF::Node *newNode = new Node{};
 	newNode->index = nodeIndex;
@@ -791,13 +1034,13 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 	// Node with children
 	if (node.children.size() > 0) {
 		for (auto i = 0; i < node.children.size(); i++) {
-			loadNode(newNode, model.nodes[node.children[i]], node.children[i], model, indexBuffer, vertexBuffer, globalscale);
+			loadNode(newNode, model.nodes[node.children[i]], node.children[i], model, indexCount, vertexCount, globalscale);
 		}
 	}
 
-	// Node contains mesh data
+	// Node contains mesh data, its vertices and indices are decoded by decodePrimitives once all nodes have been loaded
 	if (node.mesh > -1) {
-		const tinygltf::Mesh mesh = model.meshes[node.mesh];
+		const tinygltf::Mesh &mesh = model.meshes[node.mesh];
 		Mesh *newMesh = new Mesh(device, newNode->matrix);
 		newMesh->name = mesh.name;
 		for (size_t j = 0; j < mesh.primitives.size(); j++) {
@@ -805,147 +1048,32 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 			if (primitive.indices < 0) {
 				continue;
 			}
-			uint32_t indexStart = static_cast<uint32_t>(indexBuffer.size());
-			uint32_t vertexStart = static_cast<uint32_t>(vertexBuffer.size());
-			uint32_t indexCount = 0;
-			uint32_t vertexCount = 0;
-			glm::vec3 posMin{};
-			glm::vec3 posMax{};
-			bool hasSkin = false;
-			// Vertices
-			{
-				const float *bufferPos = nullptr;
-				const float *bufferNormals = nullptr;
-				const float *bufferTexCoords = nullptr;
-				const float* bufferColors = nullptr;
-				const float *bufferTangents = nullptr;
-				uint32_t numColorComponents;
-				const uint16_t *bufferJoints = nullptr;
-				const float *bufferWeights = nullptr;
-
-				// Position attribute is required
-				assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
-
-				const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-				const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
-				bufferPos = reinterpret_cast<const float *>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
-				posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
-				posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
-
-				if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-					const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-					const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
-					bufferNormals = reinterpret_cast<const float *>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
-				}
-
-				if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferTexCoords = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
-
-				if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-					const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
-					// Color buffer are either of type vec3 or vec4
-					numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
-					bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
-				}
-
-				if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor &tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
-					const tinygltf::BufferView &tangentView = model.bufferViews[tangentAccessor.bufferView];
-					bufferTangents = reinterpret_cast<const float *>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
-				}
-
-				// Skinning
-				// Joints
-				if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-					const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
-					bufferJoints = reinterpret_cast<const uint16_t *>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
-				}
-
-				if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferWeights = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
-
-				hasSkin = (bufferJoints && bufferWeights);
-
-				vertexCount = static_cast<uint32_t>(posAccessor.count);
-
-				for (size_t v = 0; v < posAccessor.count; v++) {
-					Vertex vert{};
-					vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
-					vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
-					vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
-					if (bufferColors) {
-						switch (numColorComponents) {
-							case 3: 
-								vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * 3]), 1.0f);
-							case 4:
-								vert.color = glm::make_vec4(&bufferColors[v * 4]);
-						}
-					}
-					else {
-						vert.color = glm::vec4(1.0f);
-					}
-					vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * 4])) : glm::vec4(0.0f);
-					vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
-					vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
-					vertexBuffer.push_back(vert);
-				}
-			}
-			// Indices
-			{
-				const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
-				const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
-
-				indexCount = static_cast<uint32_t>(accessor.count);
-
-				switch (accessor.componentType) {
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-					uint32_t *buf = new uint32_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-                    delete[] buf;
-					break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-					uint16_t *buf = new uint16_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-                    delete[] buf;
-                    break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-					uint8_t *buf = new uint8_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-                    delete[] buf;
-                    break;
-				}
-				default:
-					std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-					return;
-				}
+			// Position attribute is required
+			assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
+			const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+			const tinygltf::Accessor &indexAccessor = model.accessors[primitive.indices];
+			switch (indexAccessor.componentType) {
+			case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+			case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+			case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
+				break;
+			default:
+				std::cerr << "Index component type " << indexAccessor.componentType << " not supported!" << std::endl;
+				continue;
 			}
-			Primitive *newPrimitive = new Primitive(indexStart, indexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
-			newPrimitive->firstVertex = vertexStart;
-			newPrimitive->vertexCount = vertexCount;
-			newPrimitive->setDimensions(posMin, posMax);
+			Primitive *newPrimitive = new Primitive(indexCount, static_cast<uint32_t>(indexAccessor.count), primitive.material > -1 ? materials[primitive.material] : materials.back());
+			newPrimitive->firstVertex = vertexCount;
+			newPrimitive->vertexCount = static_cast<uint32_t>(posAccessor.count);
+			newPrimitive->setDimensions(glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]), glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]));
 			newMesh->primitives.push_back(newPrimitive);
+			indexCount += newPrimitive->indexCount;
+			vertexCount += newPrimitive->vertexCount;
+
+			PrimitiveSource source;
+			source.primitive = &primitive;
+			source.node = newNode;
+			source.target = newPrimitive;
+			primitiveSources.push_back(source);
 		}
 		newNode->mesh = newMesh;
 	}
@@ -979,22 +1107,20 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 		// Get inverse bind matrices from buffer
 		if (source.inverseBindMatrices > -1) {
 			const tinygltf::Accessor &accessor = gltfModel.accessors[source.inverseBindMatrices];
-			const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-			const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
 			newSkin->inverseBindMatrices.resize(accessor.count);
-			memcpy(newSkin->inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
+			memcpy(newSkin->inverseBindMatrices.data(), getAccessorData(gltfModel, accessor), accessor.count * sizeof(glm::mat4));
 		}
 
 		skins.push_back(newSkin);
 	}
 }
 
-void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
+void vkglTF::Model::loadImages(std::vector<tinygltf::Image> &images, vks::VulkanDevice *device, VkQueue transferQueue, bool asyncUpload)
 {
-	for (tinygltf::Image &image : gltfModel.images) {
-		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, device, transferQueue);
-		textures.push_back(texture);
+	assert(textures.size() == images.size());
+	for (size_t i = 0; i < images.size(); i++) {
+		textures[i].fromglTfImage(images[i], path, device, transferQueue, asyncUpload);
+		uploadTicket = std::max(uploadTicket, textures[i].uploadTicket);
 	}
 	// Create an empty texture to be used for empty material images
 	createEmptyTexture(transferQueue);
@@ -1076,13 +1202,11 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 			// Read sampler input time values
 			{
 				const tinygltf::Accessor &accessor = gltfModel.accessors[samp.input];
-				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
 
 				assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
 				float *buf = new float[accessor.count];
-				memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(float));
+				memcpy(buf, getAccessorData(gltfModel, accessor), accessor.count * sizeof(float));
 				for (size_t index = 0; index < accessor.count; index++) {
 					sampler.inputs.push_back(buf[index]);
 				}
@@ -1100,15 +1224,13 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 			// Read sampler output T/R/S values 
 			{
 				const tinygltf::Accessor &accessor = gltfModel.accessors[samp.output];
-				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
 
 				assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
 				switch (accessor.type) {
 				case TINYGLTF_TYPE_VEC3: {
 					glm::vec3 *buf = new glm::vec3[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec3));
+					memcpy(buf, getAccessorData(gltfModel, accessor), accessor.count * sizeof(glm::vec3));
 					for (size_t index = 0; index < accessor.count; index++) {
 						sampler.outputsVec4.push_back(glm::vec4(buf[index], 0.0f));
 					}
@@ -1117,7 +1239,7 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 				}
 				case TINYGLTF_TYPE_VEC4: {
 					glm::vec4 *buf = new glm::vec4[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec4));
+					memcpy(buf, getAccessorData(gltfModel, accessor), accessor.count * sizeof(glm::vec4));
 					for (size_t index = 0; index < accessor.count; index++) {
 						sampler.outputsVec4.push_back(buf[index]);
 					}
@@ -1164,99 +1286,490 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 	}
 }
 
-void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
+const unsigned char* vkglTF::Model::getAccessorData(const tinygltf::Model &model, const tinygltf::Accessor &accessor) const
 {
-	tinygltf::Model gltfModel;
-	tinygltf::TinyGLTF gltfContext;
-	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
-		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
-	} else {
-		gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
-	}
-#if defined(__ANDROID__)
-	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
-	// We let tinygltf handle this, by passing the asset manager of our app
-	tinygltf::asset_manager = androidApp->activity->assetManager;
-#endif
-	size_t pos = filename.find_last_of('/');
-	path = filename.substr(0, pos);
-
-	std::string error, warning;
-
-	this->device = device;
-
-#if defined(__ANDROID__)
-	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
-	// We let tinygltf handle this, by passing the asset manager of our app
-	tinygltf::asset_manager = androidApp->activity->assetManager;
-#endif
-	bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+	const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
+	return bufferData[bufferView.buffer] + bufferView.byteOffset + accessor.byteOffset;
+}
 
-	std::vector<uint32_t> indexBuffer;
-	std::vector<Vertex> vertexBuffer;
+vkglTF::AccessorStream vkglTF::Model::getAccessorStream(const tinygltf::Model &model, int accessorIndex) const
+{
+	const tinygltf::Accessor &accessor = model.accessors[accessorIndex];
+	const int byteStride = accessor.ByteStride(model.bufferViews[accessor.bufferView]);
+	assert(byteStride > 0);
+	AccessorStream stream;
+	stream.data = getAccessorData(model, accessor);
+	stream.count = accessor.count;
+	stream.stride = static_cast<size_t>(byteStride);
+	stream.componentType = accessor.componentType;
+	stream.componentCount = static_cast<uint32_t>(tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type)));
+	stream.normalized = accessor.normalized;
+	return stream;
+}
 
-	if (fileLoaded) {
-		if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
-			loadImages(gltfModel, device, transferQueue);
-		}
-		loadMaterials(gltfModel);
-		const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
-		for (size_t i = 0; i < scene.nodes.size(); i++) {
-			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-			loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
+void vkglTF::Model::decodePrimitives(const tinygltf::Model &model, uint8_t *indexData, std::vector<Vertex> &vertexBuffer, uint32_t fileLoadingFlags)
+{
+	const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+	const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
+	const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
+
+	// Large primitives are split into several jobs, so a single scanned mesh doesn't end up on one thread
+	struct DecodeRange {
+		uint32_t source;
+		uint32_t first;
+		uint32_t last;
+		bool indices;
+	};
+	const uint32_t verticesPerRange = 16384;
+	const uint32_t indicesPerRange = 65536;
+	std::vector<DecodeRange> ranges;
+	std::vector<glm::mat4> matrices(primitiveSources.size());
+	for (uint32_t i = 0; i < static_cast<uint32_t>(primitiveSources.size()); i++) {
+		const Primitive *target = primitiveSources[i].target;
+		if (preTransform) {
+			matrices[i] = primitiveSources[i].node->getMatrix();
 		}
-		if (gltfModel.animations.size() > 0) {
-			loadAnimations(gltfModel);
+		for (uint32_t first = 0; first < target->vertexCount; first += verticesPerRange) {
+			ranges.push_back({ i, first, std::min(first + verticesPerRange, target->vertexCount), false });
 		}
-		loadSkins(gltfModel);
-
-		for (auto node : linearNodes) {
-			// Assign skins
-			if (node->skinIndex > -1) {
-				node->skin = skins[node->skinIndex];
-			}
-			// Initial pose
-			if (node->mesh) {
-				node->update();
-			}
+		for (uint32_t first = 0; first < target->indexCount; first += indicesPerRange) {
+			ranges.push_back({ i, first, std::min(first + indicesPerRange, target->indexCount), true });
 		}
 	}
-	else {
-		// TODO: throw
-		vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
-		return;
-	}
 
-	// Pre-Calculations for requested features
-	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
-		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
-		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
-		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
-		for (Node* node : linearNodes) {
-			if (node->mesh) {
-				const glm::mat4 localMatrix = node->getMatrix();
-				for (Primitive* primitive : node->mesh->primitives) {
-					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
-						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
-						// Pre-transform vertex positions by node-hierarchy
-						if (preTransform) {
-							vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
-							vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
-						}
-						// Flip Y-Axis of vertex positions
-						if (flipY) {
-							vertex.pos.y *= -1.0f;
-							vertex.normal.y *= -1.0f;
-						}
-						// Pre-Multiply vertex colors with material base color
-						if (preMultiplyColor) {
-							vertex.color = primitive->material.baseColorFactor * vertex.color;
-						}
-					}
+	vks::JobSystem &jobSystem = vks::JobSystem::instance();
+	jobSystem.wait(jobSystem.parallelFor(static_cast<uint32_t>(ranges.size()), 1, [&](uint32_t firstRange, uint32_t lastRange) {
+		for (uint32_t r = firstRange; r < lastRange; r++) {
+			const DecodeRange &range = ranges[r];
+			const PrimitiveSource &source = primitiveSources[range.source];
+			const Primitive &target = *source.target;
+			if (range.indices) {
+				const AccessorStream stream = getAccessorStream(model, source.primitive->indices);
+				if (indices.type == VK_INDEX_TYPE_UINT16) {
+					readIndices(stream, range.first, range.last, reinterpret_cast<uint16_t*>(indexData) + target.firstIndex + range.first);
 				}
+				else {
+					readIndices(stream, range.first, range.last, reinterpret_cast<uint32_t*>(indexData) + target.firstIndex + range.first, 0);
+				}
+				continue;
 			}
-		}
-	}
+
+			// The buffer is zero initialized, so only attributes present in the primitive (and the default color) have to be written
+			Vertex *vertices = vertexBuffer.data() + target.firstVertex + range.first;
+			const size_t count = range.last - range.first;
+			const std::map<std::string, int> &attributes = source.primitive->attributes;
+			auto findAttribute = [&attributes](const char *name) {
+				const auto attribute = attributes.find(name);
+				return (attribute != attributes.end()) ? attribute->second : -1;
+			};
+			readFloats(getAccessorStream(model, findAttribute("POSITION")), range.first, range.last, &vertices->pos.x, sizeof(Vertex), 3);
+			const int normals = findAttribute("NORMAL");
+			if (normals > -1) {
+				readFloats(getAccessorStream(model, normals), range.first, range.last, &vertices->normal.x, sizeof(Vertex), 3);
+			}
+			const int texCoords = findAttribute("TEXCOORD_0");
+			if (texCoords > -1) {
+				readFloats(getAccessorStream(model, texCoords), range.first, range.last, &vertices->uv.x, sizeof(Vertex), 2);
+			}
+			// Color buffers are either of type vec3 or vec4, missing alpha defaults to one
+			const int colors = findAttribute("COLOR_0");
+			const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			if (colors > -1) {
+				readFloats(getAccessorStream(model, colors), range.first, range.last, &vertices->color.x, sizeof(Vertex), 4, white);
+			}
+			else {
+				for (size_t v = 0; v < count; v++) {
+					vertices[v].color = glm::vec4(1.0f);
+				}
+			}
+			const int tangents = findAttribute("TANGENT");
+			if (tangents > -1) {
+				readFloats(getAccessorStream(model, tangents), range.first, range.last, &vertices->tangent.x, sizeof(Vertex), 4);
+			}
+			// Skinning
+			const int joints = findAttribute("JOINTS_0");
+			const int weights = findAttribute("WEIGHTS_0");
+			if ((joints > -1) && (weights > -1)) {
+				readFloats(getAccessorStream(model, joints), range.first, range.last, &vertices->joint0.x, sizeof(Vertex), 4);
+				readFloats(getAccessorStream(model, weights), range.first, range.last, &vertices->weight0.x, sizeof(Vertex), 4);
+			}
+
+			// Pre-transform vertex positions by node-hierarchy, normals are normalized exactly once, after the optional transformation
+			if (preTransform) {
+				transformPositions(&vertices->pos.x, sizeof(Vertex), count, matrices[range.source]);
+			}
+			if (normals > -1) {
+				transformNormals(&vertices->normal.x, sizeof(Vertex), count, preTransform ? &matrices[range.source] : nullptr);
+			}
+			if (flipY || preMultiplyColor) {
+				for (size_t v = 0; v < count; v++) {
+					// Flip Y-Axis of vertex positions
+					if (flipY) {
+						vertices[v].pos.y *= -1.0f;
+						vertices[v].normal.y *= -1.0f;
+					}
+					// Pre-Multiply vertex colors with material base color
+					if (preMultiplyColor) {
+						vertices[v].color = target.material.baseColorFactor * vertices[v].color;
+					}
+				}
+			}
+		}
+	}));
+}
+
+bool vkglTF::Model::getPrimitiveIndices(const uint8_t *indexData, const Primitive &primitive, std::vector<uint32_t> &primitiveIndices) const
+{
+	primitiveIndices.resize(primitive.indexCount);
+	if (indices.type == VK_INDEX_TYPE_UINT16) {
+		const uint16_t *src = reinterpret_cast<const uint16_t*>(indexData) + primitive.firstIndex;
+		std::copy(src, src + primitive.indexCount, primitiveIndices.begin());
+	} else {
+		const uint32_t *src = reinterpret_cast<const uint32_t*>(indexData) + primitive.firstIndex;
+		std::copy(src, src + primitive.indexCount, primitiveIndices.begin());
+	}
+	const uint32_t vertexCount = primitive.vertexCount;
+	return std::all_of(primitiveIndices.begin(), primitiveIndices.end(), [vertexCount](uint32_t index) { return index < vertexCount; });
+}
+
+void vkglTF::Model::optimizePrimitives(uint8_t *indexData, std::vector<Vertex> &vertexBuffer, float &acmrBefore, float &acmrAfter)
+{
+	std::atomic<uint64_t> missesBefore(0);
+	std::atomic<uint64_t> missesAfter(0);
+	uint64_t triangleCount = 0;
+	for (const PrimitiveSource &source : primitiveSources) {
+		triangleCount += source.target->indexCount / 3;
+	}
+
+	// Primitives are independent, each job optimizes one of them on its own copy of the indices
+	vks::JobSystem &jobSystem = vks::JobSystem::instance();
+	jobSystem.wait(jobSystem.parallelFor(static_cast<uint32_t>(primitiveSources.size()), 1, [&](uint32_t first, uint32_t last) {
+		for (uint32_t p = first; p < last; p++) {
+			const PrimitiveSource &source = primitiveSources[p];
+			const Primitive *target = source.target;
+			std::vector<uint32_t> primitiveIndices;
+			const bool valid = getPrimitiveIndices(indexData, *target, primitiveIndices);
+			const size_t misses = countCacheMisses(primitiveIndices.data(), primitiveIndices.size(), target->vertexCount);
+			missesBefore += misses;
+			// Only triangle lists can be reordered
+			const bool triangles = (source.primitive->mode == TINYGLTF_MODE_TRIANGLES) && (target->indexCount % 3 == 0);
+			if (!triangles || !valid) {
+				missesAfter += misses;
+				continue;
+			}
+
+			Vertex *vertices = vertexBuffer.data() + target->firstVertex;
+			optimizeTriangleOrder(primitiveIndices.data(), primitiveIndices.size(), &vertices[0].pos.x, sizeof(Vertex), target->vertexCount);
+			// The overdraw sort may cost more cache misses than an already well ordered primitive had, keep its original order in that case
+			const size_t optimizedMisses = countCacheMisses(primitiveIndices.data(), primitiveIndices.size(), target->vertexCount);
+			if (optimizedMisses > misses) {
+				missesAfter += misses;
+				continue;
+			}
+			missesAfter += optimizedMisses;
+
+			// Renaming the vertices doesn't change which of them are in the cache, so this leaves the miss count as it is
+			std::vector<uint32_t> remap(target->vertexCount);
+			optimizeVertexFetch(primitiveIndices.data(), primitiveIndices.size(), target->vertexCount, remap.data());
+			const std::vector<Vertex> sourceVertices(vertices, vertices + target->vertexCount);
+			for (uint32_t v = 0; v < target->vertexCount; v++) {
+				vertices[remap[v]] = sourceVertices[v];
+			}
+
+			if (indices.type == VK_INDEX_TYPE_UINT16) {
+				std::copy(primitiveIndices.begin(), primitiveIndices.end(), reinterpret_cast<uint16_t*>(indexData) + target->firstIndex);
+			} else {
+				std::copy(primitiveIndices.begin(), primitiveIndices.end(), reinterpret_cast<uint32_t*>(indexData) + target->firstIndex);
+			}
+		}
+	}));
+
+	acmrBefore = (triangleCount > 0) ? static_cast<float>(missesBefore) / static_cast<float>(triangleCount) : 0.0f;
+	acmrAfter = (triangleCount > 0) ? static_cast<float>(missesAfter) / static_cast<float>(triangleCount) : 0.0f;
+}
+
+/*
+	Vertex, index and image data of a parsed glTF file
+*/
+struct vkglTF::Model::SourceData
+{
+	std::vector<Vertex> vertices;
+	/** @brief Vertices laid out by the model's vertex layout, empty for the full Vertex layout */
+	std::vector<uint8_t> packedVertices;
+	std::vector<uint8_t> indices;
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+	std::vector<tinygltf::Image> images;
+	/** @brief External buffer and image files referenced by the glTF file, relative to the model's path */
+	std::vector<std::string> externalFiles;
+	/** @brief Skins and animations reference nodes by their glTF index and aren't stored in mesh caches */
+	bool cacheable = true;
+};
+
+void vkglTF::Model::generateMeshlets(SourceData &source)
+{
+	struct PrimitiveMeshlets {
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> vertices;
+		std::vector<uint8_t> triangles;
+	};
+	std::vector<PrimitiveMeshlets> primitiveMeshlets(primitiveSources.size());
+
+	vks::JobSystem &jobSystem = vks::JobSystem::instance();
+	jobSystem.wait(jobSystem.parallelFor(static_cast<uint32_t>(primitiveSources.size()), 1, [&](uint32_t first, uint32_t last) {
+		for (uint32_t p = first; p < last; p++) {
+			const PrimitiveSource &primitiveSource = primitiveSources[p];
+			const Primitive *target = primitiveSource.target;
+			// Only triangle lists can be split into meshlets
+			if ((primitiveSource.primitive->mode != TINYGLTF_MODE_TRIANGLES) || (target->indexCount % 3 != 0)) {
+				continue;
+			}
+			std::vector<uint32_t> primitiveIndices;
+			if (!getPrimitiveIndices(source.indices.data(), *target, primitiveIndices)) {
+				continue;
+			}
+			PrimitiveMeshlets &result = primitiveMeshlets[p];
+			buildMeshlets(primitiveIndices.data(), primitiveIndices.size(), &source.vertices[target->firstVertex].pos.x, sizeof(Vertex), target->vertexCount, target->firstVertex, result.meshlets, result.vertices, result.triangles);
+		}
+	}));
+
+	// Meshlets of each primitive were built with offsets relative to its own arrays
+	for (size_t p = 0; p < primitiveSources.size(); p++) {
+		PrimitiveMeshlets &result = primitiveMeshlets[p];
+		Primitive *target = primitiveSources[p].target;
+		target->firstMeshlet = static_cast<uint32_t>(source.meshlets.size());
+		target->meshletCount = static_cast<uint32_t>(result.meshlets.size());
+		for (Meshlet &meshlet : result.meshlets) {
+			meshlet.vertexOffset += static_cast<uint32_t>(source.meshletVertices.size());
+			meshlet.triangleOffset += static_cast<uint32_t>(source.meshletTriangles.size());
+			source.meshlets.push_back(meshlet);
+		}
+		source.meshletVertices.insert(source.meshletVertices.end(), result.vertices.begin(), result.vertices.end());
+		source.meshletTriangles.insert(source.meshletTriangles.end(), result.triangles.begin(), result.triangles.end());
+	}
+}
+
+void vkglTF::Model::generateLods(SourceData &source, uint32_t fileLoadingFlags)
+{
+	const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+	const bool optimize = fileLoadingFlags & FileLoadingFlags::OptimizeMesh;
+	// Each level aims for half the triangles of the previous one, the chain ends once a level removes too little or strays too far
+	const uint32_t maxLodCount = 6;
+	const float minLodReduction = 0.8f;
+	const float maxLodErrorFactor = 0.1f;
+	std::vector<std::vector<std::vector<uint32_t>>> primitiveLods(primitiveSources.size());
+
+	vks::JobSystem &jobSystem = vks::JobSystem::instance();
+	jobSystem.wait(jobSystem.parallelFor(static_cast<uint32_t>(primitiveSources.size()), 1, [&](uint32_t first, uint32_t last) {
+		for (uint32_t p = first; p < last; p++) {
+			const PrimitiveSource &primitiveSource = primitiveSources[p];
+			Primitive *target = primitiveSource.target;
+			// Only triangle lists can be simplified
+			if ((primitiveSource.primitive->mode != TINYGLTF_MODE_TRIANGLES) || (target->indexCount % 3 != 0)) {
+				continue;
+			}
+			std::vector<uint32_t> primitiveIndices;
+			if (!getPrimitiveIndices(source.indices.data(), *target, primitiveIndices)) {
+				continue;
+			}
+
+			const float *positions = &source.vertices[target->firstVertex].pos.x;
+			// Errors are stored in the space of the primitive's bounds, pre-transformed vertices are scaled by their node's matrix
+			float scale = 1.0f;
+			if (preTransform && (primitiveSource.node->getMatrix() != glm::mat4(0.0f))) {
+				const glm::mat4 matrix = primitiveSource.node->getMatrix();
+				scale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+			}
+			const float maxError = maxLodErrorFactor * target->dimensions.radius * scale;
+			// Levels are simplified from the previous one, so their errors add up
+			float error = 0.0f;
+			std::vector<uint32_t> lodIndices(primitiveIndices.size());
+			for (uint32_t level = 0; (level < maxLodCount) && (error < maxError); level++) {
+				const size_t targetIndexCount = primitiveIndices.size() / 6 * 3;
+				float levelError = 0.0f;
+				const size_t lodIndexCount = simplifyTriangles(lodIndices.data(), primitiveIndices.data(), primitiveIndices.size(), positions, sizeof(Vertex), target->vertexCount, targetIndexCount, maxError - error, levelError);
+				if ((lodIndexCount == 0) || (lodIndexCount > minLodReduction * primitiveIndices.size())) {
+					break;
+				}
+				primitiveIndices.assign(lodIndices.begin(), lodIndices.begin() + lodIndexCount);
+				if (optimize) {
+					optimizeTriangleOrder(primitiveIndices.data(), primitiveIndices.size(), positions, sizeof(Vertex), target->vertexCount);
+				}
+				error += levelError;
+				target->lods.push_back({ 0, static_cast<uint32_t>(lodIndexCount), error / scale });
+				primitiveLods[p].push_back(primitiveIndices);
+			}
+		}
+	}));
+
+	// The levels are appended behind the indices of all primitives, the index type doesn't change as they use the same vertices
+	const size_t indexSize = (indices.type == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
+	for (size_t p = 0; p < primitiveSources.size(); p++) {
+		Primitive *target = primitiveSources[p].target;
+		for (size_t level = 0; level < primitiveLods[p].size(); level++) {
+			const std::vector<uint32_t> &lodIndices = primitiveLods[p][level];
+			const size_t firstIndex = source.indices.size() / indexSize;
+			target->lods[level].firstIndex = static_cast<uint32_t>(firstIndex);
+			source.indices.resize(source.indices.size() + lodIndices.size() * indexSize);
+			if (indices.type == VK_INDEX_TYPE_UINT16) {
+				std::copy(lodIndices.begin(), lodIndices.end(), reinterpret_cast<uint16_t*>(source.indices.data()) + firstIndex);
+			} else {
+				std::copy(lodIndices.begin(), lodIndices.end(), reinterpret_cast<uint32_t*>(source.indices.data()) + firstIndex);
+			}
+		}
+	}
+}
+
+namespace
+{
+	/** @brief Maps a mesh cache and checks that it was written for the same file, its external files and loading parameters */
+	bool openMeshCache(const std::string &filename, const std::string &path, uint64_t key, vks::MappedFile &file, vkglTF::CachedModel &cache)
+	{
+		std::string error;
+		if (!file.open(filename) || !vkglTF::readMeshCache(file.data(), file.size(), &cache, &error) || (cache.key != key)) {
+			return false;
+		}
+		for (const vkglTF::CachedModel::Dependency &dependency : cache.dependencies) {
+			vks::MappedFile dependencyFile;
+			if (!dependencyFile.open(path + "/" + dependency.uri) || (vks::tools::hashData(dependencyFile.data(), dependencyFile.size()) != dependency.hash)) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool vkglTF::Model::loadSource(const std::string &filename, uint32_t fileLoadingFlags, float scale, SourceData &source, std::string &error)
+{
+	tinygltf::Model gltfModel;
+	tinygltf::TinyGLTF gltfContext;
+	DeferredImages deferredImages;
+	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
+		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
+	} else {
+		gltfContext.SetImageLoader(deferImageDataFunc, &deferredImages);
+	}
+#if defined(__ANDROID__)
+	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
+	// We let tinygltf handle this, by passing the asset manager of our app
+	tinygltf::asset_manager = androidApp->activity->assetManager;
+#endif
+	std::string warning;
+
+	// Binary glTF files are read in place and base64 data URIs of text glTF files are decoded with vks::base64,
+	// tinygltf only parses the JSON while buffer and image data are used straight from that memory
+	const bool binary = (filename.size() > 4) && (filename.compare(filename.size() - 4, 4, ".glb") == 0);
+	vkglTF::GltfContents contents;
+#if defined(__ANDROID__)
+	std::vector<uint8_t> file;
+	bool fileOpened = false;
+	AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_BUFFER);
+	if (asset) {
+		file.resize(AAsset_getLength(asset));
+		AAsset_read(asset, file.data(), file.size());
+		AAsset_close(asset);
+		fileOpened = true;
+	}
+#else
+	vks::MappedFile file;
+	const bool fileOpened = file.open(filename);
+#endif
+	bool fileLoaded = false;
+	if (fileOpened) {
+		if (binary) {
+			fileLoaded = vkglTF::readGlb(file.data(), file.size(), &contents, &error);
+		}
+		else {
+			fileLoaded = vkglTF::readGltf(reinterpret_cast<const char*>(file.data()), file.size(), &contents, &error);
+		}
+	}
+	else {
+		error = "Could not open file";
+	}
+	if (fileLoaded) {
+		deferredImages.embedded = &contents.images;
+		fileLoaded = gltfContext.LoadASCIIFromString(&gltfModel, &error, &warning, contents.json.c_str(), static_cast<unsigned int>(contents.json.size()), path);
+	}
+	if (!fileLoaded) {
+		return false;
+	}
+	// Images are decoded on the job system while the primitives are processed
+	bool imagesDecoded = true;
+	std::string imageError;
+	// Declared after everything the job refers to, so it is waited for before any of that is destroyed
+	JobWaitGuard imageJob;
+	if (!deferredImages.images.empty()) {
+		imageJob.job = vks::JobSystem::instance().schedule([&]() {
+			imagesDecoded = decodeImages(deferredImages, gltfModel.images, imageError);
+		});
+	}
+
+	bufferData.resize(gltfModel.buffers.size());
+	for (size_t i = 0; i < gltfModel.buffers.size(); i++) {
+		bufferData[i] = ((i < contents.buffers.size()) && contents.buffers[i].data) ? contents.buffers[i].data : gltfModel.buffers[i].data.data();
+	}
+	// Materials reference the textures, which are uploaded by loadImages once the model has been parsed
+	if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+		textures.resize(gltfModel.images.size());
+	}
+	loadMaterials(gltfModel);
+	const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+	uint32_t indexCount = 0;
+	uint32_t vertexCount = 0;
+	for (size_t i = 0; i < scene.nodes.size(); i++) {
+		const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
+		loadNode(nullptr, node, scene.nodes[i], gltfModel, indexCount, vertexCount, scale);
+	}
+	// Indices are relative to their primitive, so the index width only depends on the largest primitive
+	indices.type = VK_INDEX_TYPE_UINT16;
+	for (const PrimitiveSource &primitiveSource : primitiveSources) {
+		if (primitiveSource.target->vertexCount > 65536) {
+			indices.type = VK_INDEX_TYPE_UINT32;
+		}
+	}
+	// All ranges are known now, so the buffers are sized once and the primitives are decoded in parallel
+	source.indices.resize(static_cast<size_t>(indexCount) * ((indices.type == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t)));
+	source.vertices.resize(vertexCount);
+	decodePrimitives(gltfModel, source.indices.data(), source.vertices, fileLoadingFlags);
+	if (fileLoadingFlags & FileLoadingFlags::OptimizeMesh) {
+		float acmrBefore = 0.0f;
+		float acmrAfter = 0.0f;
+		optimizePrimitives(source.indices.data(), source.vertices, acmrBefore, acmrAfter);
+		std::cout << "Optimized \"" << filename << "\": ACMR " << acmrBefore << " -> " << acmrAfter << std::endl;
+	}
+	if (fileLoadingFlags & FileLoadingFlags::GenerateMeshlets) {
+		generateMeshlets(source);
+	}
+	if (fileLoadingFlags & FileLoadingFlags::GenerateLods) {
+		generateLods(source, fileLoadingFlags);
+	}
+	primitiveSources.clear();
+	if (imageJob.job) {
+		vks::JobSystem::instance().wait(imageJob.job);
+		imageJob.job.reset();
+		if (!imagesDecoded) {
+			error = imageError;
+			return false;
+		}
+	}
+	if (gltfModel.animations.size() > 0) {
+		loadAnimations(gltfModel);
+	}
+	loadSkins(gltfModel);
+
+	for (auto node : linearNodes) {
+		// Assign skins
+		if (node->skinIndex > -1) {
+			node->skin = skins[node->skinIndex];
+		}
+		// Initial pose
+		if (node->mesh) {
+			node->update();
+		}
+	}
+	// Buffer data may point into the mapped file or the decoded data URIs, which are released once loading has finished
+	bufferData.clear();
 
 	for (auto extension : gltfModel.extensionsUsed) {
 		if (extension == "KHR_materials_pbrSpecularGlossiness") {
@@ -1265,78 +1778,564 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		}
 	}
 
-	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-	indices.count = static_cast<uint32_t>(indexBuffer.size());
-	vertices.count = static_cast<uint32_t>(vertexBuffer.size());
+	// Levels of detail are stored behind the indices of the primitives
+	indices.count = static_cast<int>(source.indices.size() / ((indices.type == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t)));
+	vertices.count = static_cast<int>(vertexCount);
+
+	// Only the components of the requested layout are uploaded, the full Vertex layout is uploaded as is
+	if (!vertexLayout.components.empty()) {
+		const VertexLayout &layout = vertexLayout;
+		if (layout.quantized && (std::find(layout.components.begin(), layout.components.end(), VertexComponent::Joint0) != layout.components.end())) {
+			for (const Vertex &vertex : source.vertices) {
+				if (glm::any(glm::greaterThan(vertex.joint0, glm::vec4(255.0f)))) {
+					error = "Joint indices exceed the 8 bit range of quantized vertex layouts";
+					return false;
+				}
+			}
+		}
+		source.packedVertices.resize(static_cast<size_t>(vertexCount) * layout.getVertexSize());
+		vks::JobSystem &jobSystem = vks::JobSystem::instance();
+		jobSystem.wait(jobSystem.parallelFor(vertexCount, 16384, [&](uint32_t first, uint32_t last) {
+			layout.pack(source.vertices.data(), first, last, vertexCount, source.packedVertices.data());
+		}));
+	}
+
+	if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+		source.images = std::move(gltfModel.images);
+	}
+	for (const tinygltf::Buffer &buffer : gltfModel.buffers) {
+		if (!buffer.uri.empty() && (buffer.uri.compare(0, 5, "data:") != 0)) {
+			source.externalFiles.push_back(buffer.uri);
+		}
+	}
+	for (const tinygltf::Image &image : source.images) {
+		if (!image.uri.empty() && (image.uri.compare(0, 5, "data:") != 0)) {
+			source.externalFiles.push_back(image.uri);
+		}
+	}
+	source.cacheable = gltfModel.skins.empty() && gltfModel.animations.empty();
+	return true;
+}
+
+bool vkglTF::Model::getMeshCacheKey(const std::string &filename, uint32_t fileLoadingFlags, float scale, const VertexLayout &vertexLayout, uint64_t &key)
+{
+	vks::MappedFile file;
+	if (!file.open(filename)) {
+		return false;
+	}
+	// Flags that only change how the data is uploaded don't change the cached data
+	const uint32_t flags = fileLoadingFlags & (FileLoadingFlags::PreTransformVertices | FileLoadingFlags::PreMultiplyVertexColors | FileLoadingFlags::FlipY | FileLoadingFlags::DontLoadImages | FileLoadingFlags::OptimizeMesh | FileLoadingFlags::GenerateMeshlets | FileLoadingFlags::GenerateLods);
+	key = vks::tools::hashData(file.data(), file.size());
+	key = vks::tools::hashData(&flags, sizeof(flags), key);
+	key = vks::tools::hashData(&scale, sizeof(scale), key);
+	for (VertexComponent component : vertexLayout.components) {
+		const uint32_t value = static_cast<uint32_t>(component);
+		key = vks::tools::hashData(&value, sizeof(value), key);
+	}
+	const uint8_t layoutFlags = (vertexLayout.deinterleaved ? 1 : 0) | (vertexLayout.quantized ? 2 : 0);
+	key = vks::tools::hashData(&layoutFlags, sizeof(layoutFlags), key);
+	return true;
+}
 
-	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
+bool vkglTF::Model::writeMeshCache(const std::string &filename, const SourceData &source, uint64_t key, std::string &error) const
+{
+	CachedModel cache;
+	cache.key = key;
+	for (const std::string &uri : source.externalFiles) {
+		vks::MappedFile file;
+		if (!file.open(path + "/" + uri)) {
+			error = "Could not open " + uri;
+			return false;
+		}
+		CachedModel::Dependency dependency;
+		dependency.uri = uri;
+		dependency.hash = vks::tools::hashData(file.data(), file.size());
+		cache.dependencies.push_back(dependency);
+	}
 
-	struct StagingBuffer {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} vertexStaging, indexStaging;
+	std::map<const Node*, int32_t> nodeIndices;
+	for (size_t i = 0; i < linearNodes.size(); i++) {
+		nodeIndices[linearNodes[i]] = static_cast<int32_t>(i);
+	}
+	for (const Node *node : linearNodes) {
+		CachedModel::Node cachedNode;
+		cachedNode.parent = node->parent ? nodeIndices[node->parent] : -1;
+		cachedNode.index = node->index;
+		cachedNode.name = node->name;
+		cachedNode.matrix = node->matrix;
+		cachedNode.translation = node->translation;
+		cachedNode.scale = node->scale;
+		cachedNode.rotation = node->rotation;
+		if (node->mesh) {
+			cachedNode.hasMesh = true;
+			cachedNode.meshName = node->mesh->name;
+			cachedNode.firstPrimitive = static_cast<uint32_t>(cache.primitives.size());
+			cachedNode.primitiveCount = static_cast<uint32_t>(node->mesh->primitives.size());
+			for (const Primitive *primitive : node->mesh->primitives) {
+				CachedModel::Primitive cachedPrimitive;
+				cachedPrimitive.firstIndex = primitive->firstIndex;
+				cachedPrimitive.indexCount = primitive->indexCount;
+				cachedPrimitive.firstVertex = primitive->firstVertex;
+				cachedPrimitive.vertexCount = primitive->vertexCount;
+				cachedPrimitive.firstMeshlet = primitive->firstMeshlet;
+				cachedPrimitive.meshletCount = primitive->meshletCount;
+				cachedPrimitive.firstLod = static_cast<uint32_t>(cache.lods.size());
+				cachedPrimitive.lodCount = static_cast<uint32_t>(primitive->lods.size());
+				for (const PrimitiveLod &lod : primitive->lods) {
+					CachedModel::Lod cachedLod;
+					cachedLod.firstIndex = lod.firstIndex;
+					cachedLod.indexCount = lod.indexCount;
+					cachedLod.error = lod.error;
+					cache.lods.push_back(cachedLod);
+				}
+				cachedPrimitive.material = static_cast<uint32_t>(&primitive->material - materials.data());
+				cachedPrimitive.min = primitive->dimensions.min;
+				cachedPrimitive.max = primitive->dimensions.max;
+				cache.primitives.push_back(cachedPrimitive);
+			}
+		}
+		cache.nodes.push_back(cachedNode);
+	}
 
-	// Create staging buffers
-	// Vertex data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		vertexBufferSize,
-		&vertexStaging.buffer,
-		&vertexStaging.memory,
-		vertexBuffer.data()));
-	// Index data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		indexBufferSize,
-		&indexStaging.buffer,
-		&indexStaging.memory,
-		indexBuffer.data()));
+	auto getTextureIndex = [this](const Texture *texture) -> int32_t {
+		if (!texture) {
+			return CachedModel::Material::NoTexture;
+		}
+		if (texture == &emptyTexture) {
+			return CachedModel::Material::EmptyTexture;
+		}
+		return static_cast<int32_t>(texture - textures.data());
+	};
+	for (const Material &material : materials) {
+		CachedModel::Material cachedMaterial;
+		cachedMaterial.alphaMode = static_cast<uint32_t>(material.alphaMode);
+		cachedMaterial.alphaCutoff = material.alphaCutoff;
+		cachedMaterial.metallicFactor = material.metallicFactor;
+		cachedMaterial.roughnessFactor = material.roughnessFactor;
+		cachedMaterial.baseColorFactor = material.baseColorFactor;
+		cachedMaterial.baseColorTexture = getTextureIndex(material.baseColorTexture);
+		cachedMaterial.metallicRoughnessTexture = getTextureIndex(material.metallicRoughnessTexture);
+		cachedMaterial.normalTexture = getTextureIndex(material.normalTexture);
+		cachedMaterial.occlusionTexture = getTextureIndex(material.occlusionTexture);
+		cachedMaterial.emissiveTexture = getTextureIndex(material.emissiveTexture);
+		cache.materials.push_back(cachedMaterial);
+	}
+
+	// Decoded images are stored as pixels, images loaded from external KTX files at upload time only by their URI
+	for (const tinygltf::Image &image : source.images) {
+		CachedModel::Image cachedImage;
+		if (image.image.empty()) {
+			cachedImage.uri = image.uri;
+		}
+		else {
+			cachedImage.width = static_cast<uint32_t>(image.width);
+			cachedImage.height = static_cast<uint32_t>(image.height);
+			cachedImage.component = static_cast<uint32_t>(image.component);
+			cachedImage.pixels.data = image.image.data();
+			cachedImage.pixels.size = image.image.size();
+		}
+		cache.images.push_back(cachedImage);
+	}
+
+	cache.metallicRoughnessWorkflow = metallicRoughnessWorkflow;
+	cache.indexSize = (indices.type == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
+	cache.vertexCount = static_cast<uint32_t>(vertices.count);
+	if (source.packedVertices.empty()) {
+		cache.vertexData.data = reinterpret_cast<const uint8_t*>(source.vertices.data());
+		cache.vertexData.size = source.vertices.size() * sizeof(Vertex);
+	}
+	else {
+		cache.vertexData.data = source.packedVertices.data();
+		cache.vertexData.size = source.packedVertices.size();
+	}
+	cache.indexData.data = source.indices.data();
+	cache.indexData.size = source.indices.size();
+	cache.meshletData.data = reinterpret_cast<const uint8_t*>(source.meshlets.data());
+	cache.meshletData.size = source.meshlets.size() * sizeof(Meshlet);
+	cache.meshletVertexData.data = reinterpret_cast<const uint8_t*>(source.meshletVertices.data());
+	cache.meshletVertexData.size = source.meshletVertices.size() * sizeof(uint32_t);
+	cache.meshletTriangleData.data = source.meshletTriangles.data();
+	cache.meshletTriangleData.size = source.meshletTriangles.size();
+	return vkglTF::writeMeshCache(filename, cache, &error);
+}
+
+void vkglTF::Model::loadMeshCache(const CachedModel &cache)
+{
+	textures.resize(cache.images.size());
+	auto getTexture = [this](int32_t index) -> Texture* {
+		if (index == CachedModel::Material::NoTexture) {
+			return nullptr;
+		}
+		if (index == CachedModel::Material::EmptyTexture) {
+			return &emptyTexture;
+		}
+		return &textures[index];
+	};
+	for (const CachedModel::Material &cachedMaterial : cache.materials) {
+		vkglTF::Material material(device);
+		material.alphaMode = static_cast<Material::AlphaMode>(cachedMaterial.alphaMode);
+		material.alphaCutoff = cachedMaterial.alphaCutoff;
+		material.metallicFactor = cachedMaterial.metallicFactor;
+		material.roughnessFactor = cachedMaterial.roughnessFactor;
+		material.baseColorFactor = cachedMaterial.baseColorFactor;
+		material.baseColorTexture = getTexture(cachedMaterial.baseColorTexture);
+		material.metallicRoughnessTexture = getTexture(cachedMaterial.metallicRoughnessTexture);
+		material.normalTexture = getTexture(cachedMaterial.normalTexture);
+		material.occlusionTexture = getTexture(cachedMaterial.occlusionTexture);
+		material.emissiveTexture = getTexture(cachedMaterial.emissiveTexture);
+		materials.push_back(material);
+	}
+
+	// Children are stored before their parents, so all nodes are created before the hierarchy is linked
+	std::vector<Node*> cachedNodes(cache.nodes.size());
+	for (size_t i = 0; i < cache.nodes.size(); i++) {
+		const CachedModel::Node &cachedNode = cache.nodes[i];
+		Node *node = new Node{};
+		node->index = cachedNode.index;
+		node->name = cachedNode.name;
+		node->matrix = cachedNode.matrix;
+		node->translation = cachedNode.translation;
+		node->scale = cachedNode.scale;
+		node->rotation = cachedNode.rotation;
+		if (cachedNode.hasMesh) {
+			Mesh *mesh = new Mesh(device, node->matrix);
+			mesh->name = cachedNode.meshName;
+			for (uint32_t j = 0; j < cachedNode.primitiveCount; j++) {
+				const CachedModel::Primitive &cachedPrimitive = cache.primitives[cachedNode.firstPrimitive + j];
+				Primitive *primitive = new Primitive(cachedPrimitive.firstIndex, cachedPrimitive.indexCount, materials[cachedPrimitive.material]);
+				primitive->firstVertex = cachedPrimitive.firstVertex;
+				primitive->vertexCount = cachedPrimitive.vertexCount;
+				primitive->firstMeshlet = cachedPrimitive.firstMeshlet;
+				primitive->meshletCount = cachedPrimitive.meshletCount;
+				for (uint32_t i = 0; i < cachedPrimitive.lodCount; i++) {
+					const CachedModel::Lod &cachedLod = cache.lods[cachedPrimitive.firstLod + i];
+					primitive->lods.push_back({ cachedLod.firstIndex, cachedLod.indexCount, cachedLod.error });
+				}
+				primitive->setDimensions(cachedPrimitive.min, cachedPrimitive.max);
+				mesh->primitives.push_back(primitive);
+			}
+			node->mesh = mesh;
+		}
+		cachedNodes[i] = node;
+	}
+	for (size_t i = 0; i < cache.nodes.size(); i++) {
+		Node *node = cachedNodes[i];
+		if (cache.nodes[i].parent > -1) {
+			node->parent = cachedNodes[cache.nodes[i].parent];
+			node->parent->children.push_back(node);
+		} else {
+			nodes.push_back(node);
+		}
+		linearNodes.push_back(node);
+	}
+	for (auto node : linearNodes) {
+		if (node->mesh) {
+			node->update();
+		}
+	}
+
+	metallicRoughnessWorkflow = cache.metallicRoughnessWorkflow;
+	indices.type = (cache.indexSize == sizeof(uint16_t)) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	indices.count = static_cast<int>(cache.indexData.size / cache.indexSize);
+	vertices.count = static_cast<int>(cache.vertexCount);
+}
+
+bool vkglTF::Model::bakeMeshCache(const std::string &filename, uint32_t fileLoadingFlags, float scale, const VertexLayout &vertexLayout, std::string *error)
+{
+	Model model;
+	model.vertexLayout = vertexLayout;
+	model.path = filename.substr(0, filename.find_last_of('/'));
+	uint64_t key = 0;
+	if (!getMeshCacheKey(filename, fileLoadingFlags, scale, vertexLayout, key)) {
+		*error = "Could not open " + filename;
+		return false;
+	}
+	SourceData source;
+	if (!model.loadSource(filename, fileLoadingFlags, scale, source, *error)) {
+		return false;
+	}
+	if (!source.cacheable) {
+		*error = "Models with skins or animations can't be cached";
+		return false;
+	}
+	return model.writeMeshCache(getMeshCacheFileName(filename), source, key, *error);
+}
+
+/*
+	State of a model being loaded, filled by prepareLoad and consumed by finishLoad
+*/
+struct vkglTF::Model::LoadState
+{
+	std::string filename;
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	uint32_t fileLoadingFlags = 0;
+	float scale = 1.0f;
+	/** @brief A matching mesh cache is used straight from the mapped file, its data is copied from there into staging memory */
+	vks::MappedFile cacheFile;
+	CachedModel cache;
+	bool cacheLoaded = false;
+	SourceData source;
+	bool loaded = false;
+	std::string error;
+};
+
+void vkglTF::Model::prepareLoad(LoadState &state)
+{
+	const std::string &filename = state.filename;
+	uint64_t cacheKey = 0;
+	bool writeCache = false;
+#if !defined(__ANDROID__)
+	// Assets are packed into the apk on Android, so there's no place to store caches next to them
+	if (state.fileLoadingFlags & FileLoadingFlags::MeshCache) {
+		writeCache = getMeshCacheKey(filename, state.fileLoadingFlags, state.scale, vertexLayout, cacheKey);
+		state.cacheLoaded = writeCache && openMeshCache(getMeshCacheFileName(filename), path, cacheKey, state.cacheFile, state.cache);
+	}
+#endif
+
+	SourceData &source = state.source;
+	if (state.cacheLoaded) {
+		const CachedModel &cache = state.cache;
+		loadMeshCache(cache);
+		if (!(state.fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+			source.images.resize(cache.images.size());
+			for (size_t i = 0; i < cache.images.size(); i++) {
+				const CachedModel::Image &cachedImage = cache.images[i];
+				tinygltf::Image &image = source.images[i];
+				image.uri = cachedImage.uri;
+				image.width = static_cast<int>(cachedImage.width);
+				image.height = static_cast<int>(cachedImage.height);
+				image.component = static_cast<int>(cachedImage.component);
+				image.bits = 8;
+				image.image.assign(cachedImage.pixels.data, cachedImage.pixels.data + cachedImage.pixels.size);
+			}
+		}
+	}
+	else {
+		if (!loadSource(filename, state.fileLoadingFlags, state.scale, source, state.error)) {
+			return;
+		}
+		// The cache is only an optimization, so failing to write it doesn't fail loading
+		std::string error;
+		if (writeCache && source.cacheable && !writeMeshCache(getMeshCacheFileName(filename), source, cacheKey, error)) {
+			std::cerr << "Could not write mesh cache for \"" << filename << "\": " << error << std::endl;
+		}
+	}
+	state.loaded = true;
+}
+
+void vkglTF::Model::finishLoad(LoadState &state)
+{
+	if (!state.loaded) {
+		// TODO: throw
+		vks::tools::exitFatal("Could not load glTF file \"" + state.filename + "\": " + state.error, -1);
+		return;
+	}
+
+	const bool asyncUpload = (state.fileLoadingFlags & FileLoadingFlags::AsyncUpload) != 0;
+	const SourceData &source = state.source;
+	DataRange vertexData;
+	DataRange indexData;
+	DataRange meshletData;
+	DataRange meshletVertexData;
+	DataRange meshletTriangleData;
+	if (state.cacheLoaded) {
+		vertexData = state.cache.vertexData;
+		indexData = state.cache.indexData;
+		meshletData = state.cache.meshletData;
+		meshletVertexData = state.cache.meshletVertexData;
+		meshletTriangleData = state.cache.meshletTriangleData;
+	}
+	else {
+		if (source.packedVertices.empty()) {
+			vertexData.data = reinterpret_cast<const uint8_t*>(source.vertices.data());
+			vertexData.size = source.vertices.size() * sizeof(Vertex);
+		}
+		else {
+			vertexData.data = source.packedVertices.data();
+			vertexData.size = source.packedVertices.size();
+		}
+		indexData.data = source.indices.data();
+		indexData.size = source.indices.size();
+		meshletData.data = reinterpret_cast<const uint8_t*>(source.meshlets.data());
+		meshletData.size = source.meshlets.size() * sizeof(Meshlet);
+		meshletVertexData.data = reinterpret_cast<const uint8_t*>(source.meshletVertices.data());
+		meshletVertexData.size = source.meshletVertices.size() * sizeof(uint32_t);
+		meshletTriangleData.data = source.meshletTriangles.data();
+		meshletTriangleData.size = source.meshletTriangles.size();
+	}
+
+	if (!(state.fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+		loadImages(state.source.images, device, state.transferQueue, asyncUpload);
+	}
+	if (meshletData.size > 0) {
+		createMeshletBuffer(meshletData.data, meshletData.size, meshletVertexData.data, meshletVertexData.size, meshletTriangleData.data, meshletTriangleData.size, state.transferQueue, asyncUpload);
+	}
+	createBuffers(vertexData.data, vertexData.size, indexData.data, indexData.size, state.transferQueue, asyncUpload);
+	getSceneDimensions();
+	setupDescriptors();
+}
+
+std::shared_ptr<vkglTF::Model::LoadState> vkglTF::Model::beginLoad(const std::string &filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale, const VertexLayout &vertexLayout)
+{
+	this->device = device;
+	this->vertexLayout = vertexLayout;
+	size_t pos = filename.find_last_of('/');
+	path = filename.substr(0, pos);
+
+	std::shared_ptr<LoadState> state = std::make_shared<LoadState>();
+	state->filename = filename;
+	state->transferQueue = transferQueue;
+	state->fileLoadingFlags = fileLoadingFlags;
+	state->scale = scale;
+	return state;
+}
+
+void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale, const VertexLayout& vertexLayout)
+{
+	std::shared_ptr<LoadState> state = beginLoad(filename, device, transferQueue, fileLoadingFlags, scale, vertexLayout);
+	prepareLoad(*state);
+	finishLoad(*state);
+}
+
+vks::JobHandle vkglTF::Model::loadFromFileAsync(const std::string &filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale, const VertexLayout &vertexLayout)
+{
+	assert(!loadJob);
+	loadState = beginLoad(filename, device, transferQueue, fileLoadingFlags, scale, vertexLayout);
+	// The job only touches the model's CPU side data, which isn't used by anyone else until pollLoad has finished the load
+	std::shared_ptr<LoadState> state = loadState;
+	loadJob = vks::JobSystem::instance().schedule([this, state]() {
+		prepareLoad(*state);
+	});
+	return loadJob;
+}
+
+bool vkglTF::Model::pollLoad()
+{
+	if (loadState) {
+		if (!loadJob->finished) {
+			return false;
+		}
+		// Only rethrows exceptions of the finished job
+		vks::JobSystem::instance().wait(loadJob);
+		finishLoad(*loadState);
+		loadState.reset();
+		loadJob.reset();
+	}
+	return isReady();
+}
+
+void vkglTF::Model::createBuffers(const void *vertexData, size_t vertexDataSize, const void *indexData, size_t indexDataSize, VkQueue transferQueue, bool asyncUpload)
+{
+	assert((vertexDataSize > 0) && (indexDataSize > 0));
 
 	// Create device local buffers
 	// Vertex buffer
 	VK_CHECK_RESULT(device->createBuffer(
 	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vertexBufferSize,
+		vertexDataSize,
 		&vertices.buffer,
 		&vertices.memory));
 	// Index buffer
 	VK_CHECK_RESULT(device->createBuffer(
 	    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		indexBufferSize,
+		indexDataSize,
 		&indices.buffer,
 		&indices.memory));
 
-	// Copy from staging buffers
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-	VkBufferCopy copyRegion = {};
-
-	copyRegion.size = vertexBufferSize;
-	vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
-
-	copyRegion.size = indexBufferSize;
-	vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
-
-	device->flushCommandBuffer(copyCmd, transferQueue, true);
+	if (asyncUpload) {
+		device->asyncTransfer.uploadBuffer(vertices.buffer, 0, vertexData, vertexDataSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+		// Tickets grow monotonically, so the last upload's ticket covers the whole model
+		uploadTicket = device->asyncTransfer.uploadBuffer(indices.buffer, 0, indexData, indexDataSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+	}
+	else {
+		// Copy through the staging ring, each copy has to be recorded before the next region is allocated
+		VkBufferCopy copyRegion = {};
+		vks::StagingRegion staging = device->stagingRing.upload(transferQueue, vertexData, vertexDataSize);
+		copyRegion.srcOffset = staging.offset;
+		copyRegion.size = vertexDataSize;
+		vkCmdCopyBuffer(device->stagingRing.getCommandBuffer(transferQueue), staging.buffer, vertices.buffer, 1, &copyRegion);
+
+		staging = device->stagingRing.upload(transferQueue, indexData, indexDataSize);
+		copyRegion.srcOffset = staging.offset;
+		copyRegion.size = indexDataSize;
+		VkCommandBuffer copyCmd = device->stagingRing.getCommandBuffer(transferQueue);
+		vkCmdCopyBuffer(copyCmd, staging.buffer, indices.buffer, 1, &copyRegion);
+
+		// Make the copies visible to vertex input, the barrier also covers the vertex copy if the index upload started a new batch
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Submit all uploads of the model, rendering on the same queue waits for them through the barriers above
+		device->stagingRing.submit();
+	}
+}
 
-	vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+void vkglTF::Model::createMeshletBuffer(const void *meshletData, size_t meshletDataSize, const void *vertexData, size_t vertexDataSize, const void *triangleData, size_t triangleDataSize, VkQueue transferQueue, bool asyncUpload)
+{
+	// The ranges are bound with their own descriptors, so each one has to start at a valid storage buffer offset
+	const VkDeviceSize alignment = std::max<VkDeviceSize>(device->properties.limits.minStorageBufferOffsetAlignment, 4);
+	auto alignOffset = [alignment](VkDeviceSize offset) { return (offset + alignment - 1) / alignment * alignment; };
+	meshlets.count = static_cast<int>(meshletDataSize / sizeof(Meshlet));
+	meshlets.meshletDescriptor = { VK_NULL_HANDLE, 0, meshletDataSize };
+	meshlets.vertexDescriptor = { VK_NULL_HANDLE, alignOffset(meshletDataSize), std::max<VkDeviceSize>(vertexDataSize, 4) };
+	meshlets.triangleDescriptor = { VK_NULL_HANDLE, alignOffset(meshlets.vertexDescriptor.offset + meshlets.vertexDescriptor.range), std::max<VkDeviceSize>(triangleDataSize, 4) };
+	const VkDeviceSize bufferSize = meshlets.triangleDescriptor.offset + meshlets.triangleDescriptor.range;
 
-	getSceneDimensions();
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		bufferSize,
+		&meshlets.buffer,
+		&meshlets.memory));
+	meshlets.meshletDescriptor.buffer = meshlets.buffer;
+	meshlets.vertexDescriptor.buffer = meshlets.buffer;
+	meshlets.triangleDescriptor.buffer = meshlets.buffer;
+
+	const void *data[] = { meshletData, vertexData, triangleData };
+	const size_t sizes[] = { meshletDataSize, vertexDataSize, triangleDataSize };
+	const VkDescriptorBufferInfo *ranges[] = { &meshlets.meshletDescriptor, &meshlets.vertexDescriptor, &meshlets.triangleDescriptor };
+	// Culling passes may run in compute or in the vertex stage
+	const VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+	VkCommandBuffer copyCmd = VK_NULL_HANDLE;
+	for (uint32_t i = 0; i < 3; i++) {
+		if (sizes[i] == 0) {
+			continue;
+		}
+		if (asyncUpload) {
+			uploadTicket = device->asyncTransfer.uploadBuffer(meshlets.buffer, ranges[i]->offset, data[i], sizes[i], dstStageMask, VK_ACCESS_SHADER_READ_BIT);
+		}
+		else {
+			// Each copy has to be recorded before the next region of the staging ring is allocated
+			VkBufferCopy copyRegion = {};
+			vks::StagingRegion staging = device->stagingRing.upload(transferQueue, data[i], sizes[i]);
+			copyRegion.srcOffset = staging.offset;
+			copyRegion.dstOffset = ranges[i]->offset;
+			copyRegion.size = sizes[i];
+			copyCmd = device->stagingRing.getCommandBuffer(transferQueue);
+			vkCmdCopyBuffer(copyCmd, staging.buffer, meshlets.buffer, 1, &copyRegion);
+		}
+	}
+	if (copyCmd != VK_NULL_HANDLE) {
+		// Also covers copies recorded into an earlier batch of the staging ring, which was submitted to the same queue before
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+}
 
+void vkglTF::Model::setupDescriptors()
+{
 	// Setup descriptors
-	uint32_t uboCount{ 0 };
+	uint32_t meshCount{ 0 };
 	uint32_t imageCount{ 0 };
 	for (auto node : linearNodes) {
 		if (node->mesh) {
-			uboCount++;
+			meshCount++;
 		}
 	}
 	for (auto material : materials) {
@@ -1345,7 +2344,8 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		}
 	}
 	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uboCount },
+		// All meshes share one dynamic uniform buffer descriptor
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
 	};
 	if (imageCount > 0) {
 		if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
@@ -1359,15 +2359,15 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	descriptorPoolCI.pPoolSizes = poolSizes.data();
-	descriptorPoolCI.maxSets = uboCount + imageCount;
+	descriptorPoolCI.maxSets = 1 + imageCount;
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
 
-	// Descriptors for per-node uniform buffers
+	// Descriptor for the per-mesh uniform data, which is written to the device's uniform allocator every frame
 	{
 		// Layout is global, so only create if it hasn't already been created before
 		if (descriptorSetLayoutUbo == VK_NULL_HANDLE) {
 			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0),
 			};
 			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
 			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1375,8 +2375,10 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 			descriptorLayoutCI.pBindings = setLayoutBindings.data();
 			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutUbo));
 		}
-		for (auto node : nodes) {
-			prepareNodeDescriptor(node, descriptorSetLayoutUbo);
+		if ((meshCount > 0) && device->uniformAllocator.isCreated()) {
+			VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayoutUbo, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &uniformDescriptorSet));
+			updateUniformDescriptor();
 		}
 	}
 
@@ -1405,15 +2407,47 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	}
 }
 
+void vkglTF::Model::updateUniformDescriptor()
+{
+	if (uniformDescriptorSet == VK_NULL_HANDLE) {
+		return;
+	}
+	// Bound with the full block size, allocations of unskinned meshes are smaller but their joint matrices are never read
+	VkDescriptorBufferInfo descriptor = device->uniformAllocator.getDescriptor(sizeof(Mesh::UniformBlock));
+	VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(uniformDescriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &descriptor);
+	vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+}
+
+bool vkglTF::Model::isReady() const
+{
+	return device->asyncTransfer.isReady(uploadTicket);
+}
+
+void vkglTF::Model::bindVertexBuffer(VkCommandBuffer commandBuffer)
+{
+	if (vertexLayout.deinterleaved && !vertexLayout.components.empty()) {
+		const uint32_t bindingCount = static_cast<uint32_t>(vertexLayout.components.size());
+		std::vector<VkBuffer> buffers(bindingCount, vertices.buffer);
+		std::vector<VkDeviceSize> offsets(bindingCount);
+		for (uint32_t i = 0; i < bindingCount; i++) {
+			offsets[i] = vertexLayout.getOffset(i, static_cast<uint32_t>(vertices.count));
+		}
+		vkCmdBindVertexBuffers(commandBuffer, 0, bindingCount, buffers.data(), offsets.data());
+	}
+	else {
+		const VkDeviceSize offsets[1] = {0};
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+	}
+}
+
 void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
 {
-	const VkDeviceSize offsets[1] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	bindVertexBuffer(commandBuffer);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
 	buffersBound = true;
 }
 
-void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, const LodView *lodView)
 {
 	if (node->mesh) {
 		for (Primitive* primitive : node->mesh->primitives) {
@@ -1432,27 +2466,61 @@ void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t
 				if (renderFlags & RenderFlags::BindImages) {
 					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
 				}
-				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+				const uint32_t lod = lodView ? selectLod(node, primitive, *lodView) : 0;
+				const uint32_t firstIndex = (lod > 0) ? primitive->lods[lod - 1].firstIndex : primitive->firstIndex;
+				const uint32_t indexCount = (lod > 0) ? primitive->lods[lod - 1].indexCount : primitive->indexCount;
+				vkCmdDrawIndexed(commandBuffer, indexCount, 1, firstIndex, static_cast<int32_t>(primitive->firstVertex), 0);
 			}
 		}
 	}
 	for (auto& child : node->children) {
-		drawNode(child, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+		drawNode(child, commandBuffer, renderFlags, pipelineLayout, bindImageSet, lodView);
 	}
 }
 
 void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
 {
 	if (!buffersBound) {
-		const VkDeviceSize offsets[1] = {0};
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		bindVertexBuffer(commandBuffer);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
 	}
 	for (auto& node : nodes) {
 		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
 	}
 }
 
+void vkglTF::Model::draw(VkCommandBuffer commandBuffer, const LodView &lodView, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	if (!buffersBound) {
+		bindVertexBuffer(commandBuffer);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
+	}
+	for (auto& node : nodes) {
+		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet, &lodView);
+	}
+}
+
+uint32_t vkglTF::Model::selectLod(Node *node, const Primitive *primitive, const LodView &lodView) const
+{
+	if (primitive->lods.empty()) {
+		return 0;
+	}
+	// The error is projected at the point of the primitive's bounding sphere closest to the camera
+	const glm::mat4 matrix = node->getMatrix();
+	const float scale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+	const glm::vec3 center = glm::vec3(matrix * glm::vec4(primitive->dimensions.center, 1.0f));
+	const float distance = glm::distance(lodView.cameraPosition, center) - primitive->dimensions.radius * scale;
+	if (distance <= 0.0f) {
+		return 0;
+	}
+	const float maxError = lodView.pixelError * distance / (lodView.projectionScale * scale);
+	uint32_t lod = 0;
+	while ((lod < primitive->lods.size()) && (primitive->lods[lod].error <= maxError)) {
+		lod++;
+	}
+	return lod;
+}
+
 void vkglTF::Model::getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max)
 {
 	if (node->mesh) {
@@ -1569,26 +2637,25 @@ vkglTF::Node* vkglTF::Model::nodeFromIndex(uint32_t index) {
 	return nodeFound;
 }
 
-void vkglTF::Model::prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout) {
-	if (node->mesh) {
-		VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-		descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		descriptorSetAllocInfo.descriptorPool = descriptorPool;
-		descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-		descriptorSetAllocInfo.descriptorSetCount = 1;
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet));
-
-		VkWriteDescriptorSet writeDescriptorSet{};
-		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = node->mesh->uniformBuffer.descriptorSet;
-		writeDescriptorSet.dstBinding = 0;
-		writeDescriptorSet.pBufferInfo = &node->mesh->uniformBuffer.descriptor;
-
-		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
-	}
-	for (auto& child : node->children) {
-		prepareNodeDescriptor(child, descriptorSetLayout);
+bool vkglTF::Model::updateUniforms(vks::UniformAllocator &allocator)
+{
+	bool offsetsChanged = false;
+	for (auto node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		Mesh *mesh = node->mesh;
+		const uint32_t jointCount = static_cast<uint32_t>(mesh->jointMatrices.size());
+		const VkDeviceSize size = offsetof(Mesh::UniformBlock, jointMatrix) + jointCount * sizeof(glm::mat4);
+		vks::UniformAllocation allocation = allocator.allocate(size, sizeof(Mesh::UniformBlock));
+		Mesh::UniformBlock *uniformBlock = static_cast<Mesh::UniformBlock*>(allocation.mapped);
+		uniformBlock->matrix = mesh->matrix;
+		uniformBlock->jointcount = static_cast<float>(jointCount);
+		if (jointCount > 0) {
+			memcpy(uniformBlock->jointMatrix, mesh->jointMatrices.data(), jointCount * sizeof(glm::mat4));
+		}
+		offsetsChanged |= (mesh->uniformOffset != allocation.dynamicOffset);
+		mesh->uniformOffset = allocation.dynamicOffset;
 	}
+	return offsetsChanged;
 }
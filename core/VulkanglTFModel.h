@@ -11,10 +11,12 @@
 #include <stdlib.h>
 #include <string>
 #include <fstream>
+#include <memory>
 #include <vector>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "JobSystem.h"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -30,11 +32,15 @@
 #define TINYGLTF_ANDROID_LOAD_FROM_ASSETS
 #endif
 #include "tiny_gltf.h"
+#include "VulkanglTFAccessor.h"
+#include "VulkanglTFMeshlet.h"
 
 #if defined(__ANDROID__)
 #include <android/asset_manager.h>
 #endif
 
+#define MAX_NUM_JOINTS 64u
+
 namespace vkglTF
 {
 	enum DescriptorBindingFlags {
@@ -48,6 +54,7 @@ namespace vkglTF
 	extern uint32_t descriptorBindingFlags;
 
 	struct Node;
+	struct CachedModel;
 
 	/*
 		glTF texture loading class
@@ -57,15 +64,18 @@ namespace vkglTF
 		VkImage image;
 		VkImageLayout imageLayout;
 		VkDeviceMemory deviceMemory;
+		vks::MemoryAllocation allocation;
 		VkImageView view;
 		uint32_t width, height;
 		uint32_t mipLevels;
 		uint32_t layerCount;
 		VkDescriptorImageInfo descriptor;
 		VkSampler sampler;
+		/** @brief Ticket of an async upload, see vks::AsyncTransfer::isReady */
+		uint64_t uploadTicket = 0;
 		void updateDescriptor();
 		void destroy();
-		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
+		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue, bool asyncUpload = false);
 	};
 
 	/*
@@ -94,6 +104,16 @@ namespace vkglTF
 		void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
 	};
 
+	/*
+		Simplified index range of a primitive, its indices reference the primitive's full resolution vertices
+	*/
+	struct PrimitiveLod {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		/** @brief Estimated distance between the simplified and the full resolution surface, in the space of the primitive's dimensions */
+		float error;
+	};
+
 	/*
 		glTF primitive
 	*/
@@ -102,6 +122,11 @@ namespace vkglTF
 		uint32_t indexCount;
 		uint32_t firstVertex;
 		uint32_t vertexCount;
+		/** @brief Range of the primitive's meshlets in Model::meshlets, empty unless the model was loaded with FileLoadingFlags::GenerateMeshlets */
+		uint32_t firstMeshlet = 0;
+		uint32_t meshletCount = 0;
+		/** @brief Levels of detail with increasing error, empty unless the model was loaded with FileLoadingFlags::GenerateLods */
+		std::vector<PrimitiveLod> lods;
 		Material& material;
 
 		struct Dimensions {
@@ -125,19 +150,18 @@ namespace vkglTF
 		std::vector<Primitive*> primitives;
 		std::string name;
 
-		struct UniformBuffer {
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-			VkDescriptorBufferInfo descriptor;
-			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-			void* mapped;
-		} uniformBuffer;
-
+		/** @brief Layout of the mesh's uniform data, the data of unskinned meshes ends before the joint matrices */
 		struct UniformBlock {
 			glm::mat4 matrix;
-			glm::mat4 jointMatrix[64]{};
 			float jointcount{ 0 };
-		} uniformBlock;
+			float padding[3];
+			glm::mat4 jointMatrix[MAX_NUM_JOINTS]{};
+		};
+
+		glm::mat4 matrix;
+		std::vector<glm::mat4> jointMatrices;
+		/** @brief Dynamic offset of the mesh's uniform data for the current frame, see Model::updateUniforms */
+		uint32_t uniformOffset = 0;
 
 		Mesh(vks::VulkanDevice* device, glm::mat4 matrix);
 		~Mesh();
@@ -228,12 +252,58 @@ namespace vkglTF
 		static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
 	};
 
+	/*
+		Vertex buffer layout that only contains the components requested by the pipelines drawing the model
+	*/
+	struct VertexLayout {
+		/** @brief Components in the order of their attribute locations, an empty layout selects the full Vertex layout */
+		std::vector<VertexComponent> components;
+		/** @brief Stores every component in its own stream with its own binding instead of interleaving them */
+		bool deinterleaved = false;
+		/**
+		* @brief Stores components in compact formats that the vertex input stage expands to floats
+		*
+		* Normals and tangents are 8 bit snorm, UVs half floats, colors 8 bit unorm and weights 16 bit unorm. Joint indices
+		* are 8 bit unsigned integers and have to be read as uvec4 by the shader. Positions always stay 32 bit floats.
+		*/
+		bool quantized = false;
+
+		VertexLayout() {};
+		VertexLayout(const std::vector<VertexComponent> components, bool deinterleaved = false, bool quantized = false) : components(components), deinterleaved(deinterleaved), quantized(quantized) {};
+		VkFormat getFormat(VertexComponent component) const;
+		uint32_t getSize(VertexComponent component) const;
+		/** @brief Size of a vertex summed over all streams */
+		uint32_t getVertexSize() const;
+		/** @brief Offset of the first element of a component in a vertex buffer holding vertexCount vertices */
+		VkDeviceSize getOffset(uint32_t componentIndex, uint32_t vertexCount) const;
+		/** @brief Distance between the elements of a component */
+		uint32_t getStride(uint32_t componentIndex) const;
+		/** @brief Writes the requested components of vertices [first, last) to a buffer laid out for vertexCount vertices */
+		void pack(const Vertex* vertices, uint32_t first, uint32_t last, uint32_t vertexCount, uint8_t* dst) const;
+		/** @brief Returns the pipeline vertex input state for this layout, valid as long as the layout isn't changed or destroyed */
+		VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState();
+	private:
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+		VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo{};
+	};
+
 	enum FileLoadingFlags {
 		None = 0x00000000,
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		// Streams buffers and images through the device's transfer queue, the model may only be drawn once isReady() returns true
+		AsyncUpload = 0x00000010,
+		// Loads the processed model from a mesh cache next to the file if it matches the file and the loading parameters, and writes the cache otherwise
+		MeshCache = 0x00000020,
+		// Reorders triangles for vertex cache locality and overdraw and vertices for fetch locality, the ACMR before and after is reported
+		OptimizeMesh = 0x00000040,
+		// Splits the primitives into meshlets with culling data, stored in Model::meshlets
+		GenerateMeshlets = 0x00000080,
+		// Builds a chain of simplified index ranges per primitive in the shared index buffer, selected by draw() when given a LodView
+		GenerateLods = 0x00000100
 	};
 
 	enum RenderFlags {
@@ -243,6 +313,18 @@ namespace vkglTF
 		RenderAlphaBlendedNodes = 0x00000008
 	};
 
+	/*
+		Camera parameters for selecting the level of detail of each primitive from its projected error
+	*/
+	struct LodView {
+		/** @brief Camera position in the model's space, i.e. before any transformation applied by the pipeline drawing it */
+		glm::vec3 cameraPosition = glm::vec3(0.0f);
+		/** @brief Pixels per unit at unit distance, viewport height / (2 * tan(fovy / 2)) */
+		float projectionScale = 1.0f;
+		/** @brief Largest error on screen, in pixels, at which a simplified level is drawn */
+		float pixelError = 1.0f;
+	};
+
 	/*
 		glTF model loading and rendering class
 	*/
@@ -251,20 +333,87 @@ namespace vkglTF
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
 		void createEmptyTexture(VkQueue transferQueue);
+		/** @brief Data of each glTF buffer while the model is loaded, points into the mapped .glb file or the decoded data URIs where tinygltf only saw a placeholder */
+		std::vector<const unsigned char*> bufferData;
+		const unsigned char* getAccessorData(const tinygltf::Model& model, const tinygltf::Accessor& accessor) const;
+		AccessorStream getAccessorStream(const tinygltf::Model& model, int accessorIndex) const;
+		/** @brief glTF primitive whose vertices and indices are decoded once the node hierarchy has been loaded */
+		struct PrimitiveSource {
+			const tinygltf::Primitive* primitive;
+			Node* node;
+			Primitive* target;
+		};
+		/** @brief Primitives collected by loadNode while the model is loaded */
+		std::vector<PrimitiveSource> primitiveSources;
+		/** @brief Vertex, index and image data of a parsed glTF file, uploaded by loadFromFile and stored in mesh caches */
+		struct SourceData;
+		/** @brief Decodes the vertices and indices of all collected primitives into their ranges of the buffers on the job system */
+		void decodePrimitives(const tinygltf::Model& model, uint8_t* indexData, std::vector<Vertex>& vertexBuffer, uint32_t fileLoadingFlags);
+		/** @brief Copies a primitive's indices as 32 bit values, returns false if any of them is out of the primitive's vertex range */
+		bool getPrimitiveIndices(const uint8_t* indexData, const Primitive& primitive, std::vector<uint32_t>& primitiveIndices) const;
+		/** @brief Optimizes the triangle and vertex order of all collected primitives on the job system unless that raises their ACMR, returns the ACMR before and after */
+		void optimizePrimitives(uint8_t* indexData, std::vector<Vertex>& vertexBuffer, float& acmrBefore, float& acmrAfter);
+		/** @brief Splits all collected primitives into meshlets on the job system */
+		void generateMeshlets(SourceData& source);
+		/** @brief Simplifies all collected primitives into chains of levels of detail on the job system, appended to the index data */
+		void generateLods(SourceData& source, uint32_t fileLoadingFlags);
+		/** @brief Creates the meshlet buffer and uploads the meshlets, their vertex indices and triangles into it */
+		void createMeshletBuffer(const void* meshletData, size_t meshletDataSize, const void* vertexData, size_t vertexDataSize, const void* triangleData, size_t triangleDataSize, VkQueue transferQueue, bool asyncUpload);
+		/** @brief Binds the vertex buffer, with one binding per stream for de-interleaved layouts */
+		void bindVertexBuffer(VkCommandBuffer commandBuffer);
+		/** @brief Parses a glTF file into the node hierarchy, materials and vertex and index data without creating any Vulkan resources */
+		bool loadSource(const std::string& filename, uint32_t fileLoadingFlags, float scale, SourceData& source, std::string& error);
+		/** @brief Creates the node hierarchy and materials from a mesh cache */
+		void loadMeshCache(const CachedModel& cache);
+		/** @brief Writes the parsed model to a mesh cache file */
+		bool writeMeshCache(const std::string& filename, const SourceData& source, uint64_t key, std::string& error) const;
+		/** @brief Hashes the file and all loading parameters that change the processed data, returns false if the file can't be read */
+		static bool getMeshCacheKey(const std::string& filename, uint32_t fileLoadingFlags, float scale, const VertexLayout& vertexLayout, uint64_t& key);
+		/** @brief Mesh cache or parsed data of a model being loaded, passed from prepareLoad to finishLoad */
+		struct LoadState;
+		/** @brief Load started by loadFromFileAsync that hasn't been finished by pollLoad yet */
+		std::shared_ptr<LoadState> loadState;
+		vks::JobHandle loadJob;
+		std::shared_ptr<LoadState> beginLoad(const std::string& filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale, const VertexLayout& vertexLayout);
+		/** @brief Reads the mesh cache or parses the file, doesn't create any Vulkan resources so it can run on the job system */
+		void prepareLoad(LoadState& state);
+		/** @brief Creates the Vulkan resources of a prepared load and uploads their data, exits if the file couldn't be loaded */
+		void finishLoad(LoadState& state);
+		/** @brief Creates the vertex and index buffers and uploads their data */
+		void createBuffers(const void* vertexData, size_t vertexDataSize, const void* indexData, size_t indexDataSize, VkQueue transferQueue, bool asyncUpload);
+		void setupDescriptors();
 	public:
-		vks::VulkanDevice* device;
+		vks::VulkanDevice* device = nullptr;
 		VkDescriptorPool descriptorPool;
 
 		struct Vertices {
 			int count;
 			VkBuffer buffer;
-			VkDeviceMemory memory;
+			vks::MemoryAllocation memory;
 		} vertices;
+		/** @brief Layout of the vertex buffer as passed to loadFromFile */
+		VertexLayout vertexLayout;
+		/** @brief Indices are stored relative to their primitive's firstVertex, so 16 bit indices suffice if no primitive has more than 65536 vertices */
 		struct Indices {
 			int count;
 			VkBuffer buffer;
-			VkDeviceMemory memory;
+			vks::MemoryAllocation memory;
+			VkIndexType type = VK_INDEX_TYPE_UINT32;
 		} indices;
+		/**
+		* @brief Meshlets of all primitives if the model was loaded with FileLoadingFlags::GenerateMeshlets
+		*
+		* A single storage buffer holds the Meshlet array, the meshlets' vertex indices into the vertex buffer (uint) and their triangles
+		* (three 8 bit local vertex indices each, four per uint), each range can be bound through its descriptor.
+		*/
+		struct Meshlets {
+			int count = 0;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			vks::MemoryAllocation memory;
+			VkDescriptorBufferInfo meshletDescriptor{};
+			VkDescriptorBufferInfo vertexDescriptor{};
+			VkDescriptorBufferInfo triangleDescriptor{};
+		} meshlets;
 
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
@@ -286,23 +435,56 @@ namespace vkglTF
 		bool metallicRoughnessWorkflow = true;
 		bool buffersBound = false;
 		std::string path;
+		/** @brief Ticket of the last upload if the model was loaded with FileLoadingFlags::AsyncUpload */
+		uint64_t uploadTicket = 0;
+		/** @brief Dynamic uniform buffer descriptor of the device's uniform allocator, bound with Mesh::uniformOffset */
+		VkDescriptorSet uniformDescriptorSet = VK_NULL_HANDLE;
 
 		Model() {};
 		~Model();
-		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
+		/** @brief Creates the node hierarchy and reserves index and vertex ranges for its primitives, advancing indexCount and vertexCount */
+		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, uint32_t& indexCount, uint32_t& vertexCount, float globalscale);
 		void loadSkins(tinygltf::Model& gltfModel);
-		void loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue);
+		/** @brief Uploads the images into the textures referenced by the materials, which have been created along with them */
+		void loadImages(std::vector<tinygltf::Image>& images, vks::VulkanDevice* device, VkQueue transferQueue, bool asyncUpload = false);
 		void loadMaterials(tinygltf::Model& gltfModel);
 		void loadAnimations(tinygltf::Model& gltfModel);
-		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
+		/** @brief Loads a glTF file, the vertex buffer contains the components of vertexLayout or the full Vertex layout if it's empty */
+		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f, const VertexLayout& vertexLayout = VertexLayout());
+		/**
+		* @brief Starts loading a glTF file on the job system and returns the parsing job
+		*
+		* The mesh cache or the file is read and decoded in the background, the Vulkan resources are created by pollLoad once that has
+		* finished. The model must not be used or moved before pollLoad returns true. Combined with FileLoadingFlags::AsyncUpload the
+		* buffers and images are streamed through the device's transfer queue as well.
+		*/
+		vks::JobHandle loadFromFileAsync(const std::string& filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f, const VertexLayout& vertexLayout = VertexLayout());
+		/** @brief Finishes an asynchronous load once its job is done, returns true once the model can be drawn. Must be called on the thread recording the uploads */
+		bool pollLoad();
+		/**
+		* @brief Parses a glTF file and writes its mesh cache (see FileLoadingFlags::MeshCache) without creating any Vulkan resources
+		*
+		* The flags, scale and vertex layout have to match those passed to loadFromFile for the cache to be used. Models with skins or
+		* animations can't be cached.
+		*/
+		static bool bakeMeshCache(const std::string& filename, uint32_t fileLoadingFlags, float scale, const VertexLayout& vertexLayout, std::string* error);
+		/** @brief Returns true once all buffers and images of the model can be used by the graphics queue */
+		bool isReady() const;
 		void bindBuffers(VkCommandBuffer commandBuffer);
-		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, const LodView* lodView = nullptr);
 		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		/** @brief Draws every primitive at the coarsest level of detail whose projected error stays below lodView.pixelError */
+		void draw(VkCommandBuffer commandBuffer, const LodView& lodView, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		/** @brief Returns the level of detail selected for a primitive of a node, 0 for the full resolution and i for Primitive::lods[i - 1] */
+		uint32_t selectLod(Node* node, const Primitive* primitive, const LodView& lodView) const;
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
-		void prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout);
+		/** @brief Writes the uniform data of all meshes for the current frame, returns true if a dynamic offset has changed so command buffers binding them have to be re-recorded */
+		bool updateUniforms(vks::UniformAllocator& allocator);
+		/** @brief Points the mesh uniform descriptor at the device's uniform allocator again, required after its buffer has been recreated */
+		void updateUniformDescriptor();
 	};
 }
\ No newline at end of file
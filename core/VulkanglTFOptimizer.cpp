@@ -0,0 +1,250 @@
+/*
+* glTF mesh optimization
+*
+* Reorders the triangles of indexed triangle lists for post-transform vertex cache locality and reduced overdraw, and their
+* vertices for vertex fetch locality
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanglTFOptimizer.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vkglTF
+{
+	namespace
+	{
+		/** @brief Run of consecutive triangles between two Tipsify dead ends */
+		struct Cluster
+		{
+			size_t firstTriangle;
+			size_t triangleCount;
+			float sortKey;
+		};
+
+		glm::vec3 getPosition(const float *positions, size_t positionStride, uint32_t vertex)
+		{
+			const float *position = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + vertex * positionStride);
+			return glm::vec3(position[0], position[1], position[2]);
+		}
+
+		/** @brief Emits the triangles in Tipsify order and returns the triangle index at which each cluster starts */
+		std::vector<size_t> tipsify(const uint32_t *indices, size_t triangleCount, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t> &order)
+		{
+			// Triangles adjacent to each vertex, stored by vertex with a counting sort
+			std::vector<uint32_t> liveTriangles(vertexCount, 0);
+			for (size_t i = 0; i < triangleCount * 3; i++) {
+				liveTriangles[indices[i]]++;
+			}
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (size_t v = 0; v < vertexCount; v++) {
+				adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+			}
+			std::vector<uint32_t> adjacency(triangleCount * 3);
+			{
+				std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t i = 0; i < triangleCount * 3; i++) {
+					adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+				}
+			}
+
+			std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+			std::vector<bool> emitted(triangleCount, false);
+			std::vector<uint32_t> deadEnds;
+			std::vector<uint32_t> candidates;
+			std::vector<size_t> clusterStarts;
+			uint32_t timestamp = cacheSize + 1;
+			size_t cursor = 0;
+			order.clear();
+			order.reserve(triangleCount);
+
+			int64_t fanningVertex = 0;
+			bool deadEnd = true;
+			while (fanningVertex >= 0) {
+				if (deadEnd && (clusterStarts.empty() || (clusterStarts.back() != order.size()))) {
+					clusterStarts.push_back(order.size());
+				}
+				candidates.clear();
+				const uint32_t fan = static_cast<uint32_t>(fanningVertex);
+				for (uint32_t a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; a++) {
+					const uint32_t triangle = adjacency[a];
+					if (emitted[triangle]) {
+						continue;
+					}
+					for (uint32_t c = 0; c < 3; c++) {
+						const uint32_t v = indices[triangle * 3 + c];
+						deadEnds.push_back(v);
+						candidates.push_back(v);
+						liveTriangles[v]--;
+						if (timestamp - cacheTimestamps[v] > cacheSize) {
+							cacheTimestamps[v] = timestamp++;
+						}
+					}
+					emitted[triangle] = true;
+					order.push_back(triangle);
+				}
+
+				// Continue with the candidate that stays in the cache while its remaining triangles are emitted, preferring older entries
+				fanningVertex = -1;
+				int64_t bestPriority = -1;
+				for (uint32_t v : candidates) {
+					if (liveTriangles[v] == 0) {
+						continue;
+					}
+					int64_t priority = 0;
+					if (timestamp - cacheTimestamps[v] + 2 * liveTriangles[v] <= cacheSize) {
+						priority = timestamp - cacheTimestamps[v];
+					}
+					if (priority > bestPriority) {
+						bestPriority = priority;
+						fanningVertex = v;
+					}
+				}
+				deadEnd = (fanningVertex < 0);
+				if (deadEnd) {
+					// Recently used vertices with live triangles are the closest to the cache, the input order is the last resort
+					while (!deadEnds.empty() && (fanningVertex < 0)) {
+						const uint32_t v = deadEnds.back();
+						deadEnds.pop_back();
+						if (liveTriangles[v] > 0) {
+							fanningVertex = v;
+						}
+					}
+					while ((cursor < vertexCount) && (fanningVertex < 0)) {
+						if (liveTriangles[cursor] > 0) {
+							fanningVertex = static_cast<int64_t>(cursor);
+						}
+						cursor++;
+					}
+				}
+			}
+			return clusterStarts;
+		}
+	}
+
+	size_t countCacheMisses(const uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+	{
+		std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+		uint32_t timestamp = cacheSize + 1;
+		size_t misses = 0;
+		for (size_t i = 0; i < indexCount; i++) {
+			const uint32_t v = indices[i];
+			if (timestamp - cacheTimestamps[v] > cacheSize) {
+				cacheTimestamps[v] = timestamp++;
+				misses++;
+			}
+		}
+		return misses;
+	}
+
+	void optimizeTriangleOrder(uint32_t *indices, size_t indexCount, const float *positions, size_t positionStride, size_t vertexCount, uint32_t cacheSize)
+	{
+		const size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0) {
+			return;
+		}
+		std::vector<uint32_t> order;
+		const std::vector<size_t> hardBoundaries = tipsify(indices, triangleCount, vertexCount, cacheSize, order);
+
+		// Tipsify rarely hits a dead end on connected meshes, so clusters are also split wherever their own ACMR, simulated with a
+		// cache that starts empty at the cluster, is within a few percent of that of the whole mesh. Their order can then change
+		// without losing much cache locality (the soft boundaries of Sander et al.).
+		std::vector<uint32_t> ordered(indexCount);
+		for (size_t t = 0; t < triangleCount; t++) {
+			std::copy(indices + order[t] * 3, indices + order[t] * 3 + 3, ordered.begin() + t * 3);
+		}
+		const float threshold = 1.05f * static_cast<float>(countCacheMisses(ordered.data(), indexCount, vertexCount, cacheSize)) / static_cast<float>(triangleCount);
+		// Small clusters would restart with a cold cache too often
+		const size_t minClusterTriangles = 256;
+		std::vector<size_t> clusterStarts;
+		{
+			std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+			uint32_t timestamp = cacheSize + 1;
+			for (size_t c = 0; c < hardBoundaries.size(); c++) {
+				const size_t end = (c + 1 < hardBoundaries.size()) ? hardBoundaries[c + 1] : triangleCount;
+				size_t start = hardBoundaries[c];
+				size_t misses = 0;
+				clusterStarts.push_back(start);
+				timestamp += cacheSize + 1;
+				for (size_t t = start; t < end; t++) {
+					for (uint32_t i = 0; i < 3; i++) {
+						const uint32_t v = ordered[t * 3 + i];
+						if (timestamp - cacheTimestamps[v] > cacheSize) {
+							cacheTimestamps[v] = timestamp++;
+							misses++;
+						}
+					}
+					if ((t + 1 < end) && (t + 1 - start >= minClusterTriangles) && (static_cast<float>(misses) <= threshold * static_cast<float>(t + 1 - start))) {
+						start = t + 1;
+						misses = 0;
+						clusterStarts.push_back(start);
+						timestamp += cacheSize + 1;
+					}
+				}
+			}
+		}
+
+		glm::vec3 min(std::numeric_limits<float>::max());
+		glm::vec3 max(-std::numeric_limits<float>::max());
+		for (size_t i = 0; i < indexCount; i++) {
+			const glm::vec3 position = getPosition(positions, positionStride, indices[i]);
+			min = glm::min(min, position);
+			max = glm::max(max, position);
+		}
+		const glm::vec3 center = (min + max) * 0.5f;
+
+		// Clusters whose area weighted normal points away from the center are more likely to occlude the others
+		std::vector<Cluster> clusters(clusterStarts.size());
+		for (size_t c = 0; c < clusterStarts.size(); c++) {
+			Cluster &cluster = clusters[c];
+			cluster.firstTriangle = clusterStarts[c];
+			cluster.triangleCount = ((c + 1 < clusterStarts.size()) ? clusterStarts[c + 1] : triangleCount) - cluster.firstTriangle;
+			glm::vec3 centroid(0.0f);
+			glm::vec3 normal(0.0f);
+			float area = 0.0f;
+			for (size_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++) {
+				const uint32_t *triangle = &ordered[t * 3];
+				const glm::vec3 p0 = getPosition(positions, positionStride, triangle[0]);
+				const glm::vec3 p1 = getPosition(positions, positionStride, triangle[1]);
+				const glm::vec3 p2 = getPosition(positions, positionStride, triangle[2]);
+				const glm::vec3 weightedNormal = glm::cross(p1 - p0, p2 - p0);
+				const float triangleArea = glm::length(weightedNormal);
+				centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+				normal += weightedNormal;
+				area += triangleArea;
+			}
+			const float normalLength = glm::length(normal);
+			cluster.sortKey = ((area > 0.0f) && (normalLength > 0.0f)) ? glm::dot(centroid / area - center, normal / normalLength) : 0.0f;
+		}
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+		uint32_t *dst = indices;
+		for (const Cluster &cluster : clusters) {
+			dst = std::copy(ordered.begin() + cluster.firstTriangle * 3, ordered.begin() + (cluster.firstTriangle + cluster.triangleCount) * 3, dst);
+		}
+	}
+
+	void optimizeVertexFetch(uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t *remap)
+	{
+		const uint32_t unused = ~0u;
+		std::fill(remap, remap + vertexCount, unused);
+		uint32_t next = 0;
+		for (size_t i = 0; i < indexCount; i++) {
+			uint32_t &target = remap[indices[i]];
+			if (target == unused) {
+				target = next++;
+			}
+			indices[i] = target;
+		}
+		for (size_t v = 0; v < vertexCount; v++) {
+			if (remap[v] == unused) {
+				remap[v] = next++;
+			}
+		}
+	}
+}
@@ -0,0 +1,39 @@
+/*
+* glTF mesh optimization
+*
+* Reorders the triangles of indexed triangle lists for post-transform vertex cache locality and reduced overdraw, and their
+* vertices for vertex fetch locality
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vkglTF
+{
+	/** @brief Number of entries of the FIFO post-transform cache assumed by the optimizations and cache miss counts */
+	const uint32_t defaultVertexCacheSize = 16;
+
+	/** @brief Returns the number of post-transform cache misses of a triangle list, divided by its triangle count this is the ACMR */
+	size_t countCacheMisses(const uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = defaultVertexCacheSize);
+
+	/**
+	* @brief Reorders the triangles of a triangle list for post-transform cache locality and reduced overdraw
+	*
+	* Triangles are ordered with Tipsify (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"), which
+	* fans around vertices still in the cache and only jumps to distant triangles at dead ends. The runs between these jumps are then
+	* sorted so that runs facing away from the center of the mesh's bounds, which tend to occlude the others, are drawn first.
+	* Positions are read as three floats, positionStride bytes apart.
+	*/
+	void optimizeTriangleOrder(uint32_t *indices, size_t indexCount, const float *positions, size_t positionStride, size_t vertexCount, uint32_t cacheSize = defaultVertexCacheSize);
+
+	/**
+	* @brief Orders vertices by their first use in a triangle list and rewrites its indices accordingly
+	*
+	* Writes the new position of each vertex to remap (vertexCount entries), vertices not referenced by any index are moved to the end.
+	*/
+	void optimizeVertexFetch(uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t *remap);
+}
@@ -0,0 +1,287 @@
+/*
+* glTF mesh simplification
+*
+* Reduces the triangle count of indexed triangle lists with quadric error metrics, collapsing edges onto existing vertices so
+* simplified index buffers can share the vertex buffer of the full resolution mesh
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanglTFSimplifier.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vkglTF
+{
+	namespace
+	{
+		/** @brief Sum of squared distances to a set of planes, weighted by the area of the triangles they belong to */
+		struct Quadric
+		{
+			double a00 = 0.0, a11 = 0.0, a22 = 0.0;
+			double a01 = 0.0, a02 = 0.0, a12 = 0.0;
+			double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+			double c = 0.0;
+			double weight = 0.0;
+
+			void addPlane(const glm::dvec3 &normal, double distance, double planeWeight)
+			{
+				a00 += planeWeight * normal.x * normal.x;
+				a11 += planeWeight * normal.y * normal.y;
+				a22 += planeWeight * normal.z * normal.z;
+				a01 += planeWeight * normal.x * normal.y;
+				a02 += planeWeight * normal.x * normal.z;
+				a12 += planeWeight * normal.y * normal.z;
+				b0 += planeWeight * normal.x * distance;
+				b1 += planeWeight * normal.y * distance;
+				b2 += planeWeight * normal.z * distance;
+				c += planeWeight * distance * distance;
+				weight += planeWeight;
+			}
+
+			Quadric &operator+=(const Quadric &other)
+			{
+				a00 += other.a00; a11 += other.a11; a22 += other.a22;
+				a01 += other.a01; a02 += other.a02; a12 += other.a12;
+				b0 += other.b0; b1 += other.b1; b2 += other.b2;
+				c += other.c;
+				weight += other.weight;
+				return *this;
+			}
+
+			/** @brief Returns the weighted mean of the squared distances from p to the planes */
+			double evaluate(const glm::dvec3 &p) const
+			{
+				const double error = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+					+ 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+					+ 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+				return (weight > 0.0) ? fabs(error) / weight : 0.0;
+			}
+		};
+
+		struct Collapse
+		{
+			uint32_t from;
+			uint32_t to;
+			double error;
+		};
+
+		glm::dvec3 getPosition(const float *positions, size_t positionStride, uint32_t vertex)
+		{
+			const float *position = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + vertex * positionStride);
+			return glm::dvec3(position[0], position[1], position[2]);
+		}
+
+		/** @brief Maps every vertex to the first vertex at the same position, the topology of the mesh is evaluated on these */
+		std::vector<uint32_t> getPositionIds(const float *positions, size_t positionStride, size_t vertexCount)
+		{
+			auto positionOf = [positions, positionStride](uint32_t vertex) {
+				return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + vertex * positionStride);
+			};
+			std::vector<uint32_t> order(vertexCount);
+			for (size_t v = 0; v < vertexCount; v++) {
+				order[v] = static_cast<uint32_t>(v);
+			}
+			std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+				const int compare = memcmp(positionOf(a), positionOf(b), sizeof(float) * 3);
+				return (compare < 0) || ((compare == 0) && (a < b));
+			});
+			std::vector<uint32_t> positionIds(vertexCount);
+			for (size_t i = 0; i < vertexCount; i++) {
+				const bool same = (i > 0) && (memcmp(positionOf(order[i]), positionOf(order[i - 1]), sizeof(float) * 3) == 0);
+				positionIds[order[i]] = same ? positionIds[order[i - 1]] : order[i];
+			}
+			return positionIds;
+		}
+
+		/** @brief Marks vertices that can't be moved without changing the outline or the attribute seams of the mesh */
+		std::vector<bool> getLockedVertices(const uint32_t *indices, size_t indexCount, const std::vector<uint32_t> &positionIds)
+		{
+			const size_t vertexCount = positionIds.size();
+			std::vector<bool> locked(vertexCount, false);
+
+			// Seams are positions shared by several referenced vertices
+			std::vector<uint32_t> wedges(vertexCount, ~0u);
+			for (size_t i = 0; i < indexCount; i++) {
+				uint32_t &wedge = wedges[positionIds[indices[i]]];
+				if (wedge == ~0u) {
+					wedge = indices[i];
+				}
+				else if (wedge != indices[i]) {
+					locked[positionIds[indices[i]]] = true;
+				}
+			}
+
+			// Borders have edges without an opposite edge, non-manifold edges are used more than once in the same direction
+			std::vector<uint64_t> edges;
+			edges.reserve(indexCount);
+			for (size_t i = 0; i < indexCount; i += 3) {
+				for (uint32_t e = 0; e < 3; e++) {
+					const uint32_t a = positionIds[indices[i + e]];
+					const uint32_t b = positionIds[indices[i + (e + 1) % 3]];
+					if (a != b) {
+						edges.push_back((static_cast<uint64_t>(a) << 32) | b);
+					}
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+			for (size_t e = 0; e < edges.size(); e++) {
+				const uint32_t a = static_cast<uint32_t>(edges[e] >> 32);
+				const uint32_t b = static_cast<uint32_t>(edges[e]);
+				const bool repeated = ((e > 0) && (edges[e - 1] == edges[e])) || ((e + 1 < edges.size()) && (edges[e + 1] == edges[e]));
+				if (repeated || !std::binary_search(edges.begin(), edges.end(), (static_cast<uint64_t>(b) << 32) | a)) {
+					locked[a] = true;
+					locked[b] = true;
+				}
+			}
+			return locked;
+		}
+	}
+
+	size_t simplifyTriangles(uint32_t *destination, const uint32_t *indices, size_t indexCount, const float *positions, size_t positionStride, size_t vertexCount,
+		size_t targetIndexCount, float targetError, float &resultError)
+	{
+		std::vector<uint32_t> result(indices, indices + indexCount - indexCount % 3);
+		const std::vector<uint32_t> positionIds = getPositionIds(positions, positionStride, vertexCount);
+		const std::vector<bool> locked = getLockedVertices(result.data(), result.size(), positionIds);
+		const double maxError = static_cast<double>(targetError) * targetError;
+		double error = 0.0;
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < result.size(); i += 3) {
+			const glm::dvec3 p0 = getPosition(positions, positionStride, result[i]);
+			const glm::dvec3 p1 = getPosition(positions, positionStride, result[i + 1]);
+			const glm::dvec3 p2 = getPosition(positions, positionStride, result[i + 2]);
+			const glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const double length = glm::length(normal);
+			if (length == 0.0) {
+				continue;
+			}
+			const glm::dvec3 unitNormal = normal / length;
+			for (uint32_t c = 0; c < 3; c++) {
+				quadrics[positionIds[result[i + c]]].addPlane(unitNormal, -glm::dot(unitNormal, p0), length * 0.5);
+			}
+		}
+
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+		std::vector<uint32_t> adjacency;
+		std::vector<bool> touched(vertexCount);
+		std::vector<uint32_t> remap(vertexCount);
+		while (result.size() > targetIndexCount) {
+			// Triangles around each position, used to reject collapses that would flip one of them
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (uint32_t index : result) {
+				adjacencyOffsets[positionIds[index] + 1]++;
+			}
+			for (size_t v = 0; v < vertexCount; v++) {
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+			}
+			adjacency.resize(result.size());
+			{
+				std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t i = 0; i < result.size(); i++) {
+					adjacency[fill[positionIds[result[i]]]++] = static_cast<uint32_t>(i / 3);
+				}
+			}
+
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3) {
+				for (uint32_t e = 0; e < 3; e++) {
+					const uint32_t a = result[i + e];
+					const uint32_t b = result[i + (e + 1) % 3];
+					if (positionIds[a] == positionIds[b]) {
+						continue;
+					}
+					if (!locked[positionIds[a]]) {
+						collapses.push_back({ a, b, 0.0 });
+					}
+					if (!locked[positionIds[b]]) {
+						collapses.push_back({ b, a, 0.0 });
+					}
+				}
+			}
+			for (Collapse &collapse : collapses) {
+				Quadric quadric = quadrics[positionIds[collapse.from]];
+				quadric += quadrics[positionIds[collapse.to]];
+				collapse.error = quadric.evaluate(getPosition(positions, positionStride, collapse.to));
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return (a.error < b.error) || ((a.error == b.error) && ((a.from < b.from) || ((a.from == b.from) && (a.to < b.to)))); });
+
+			// Collapses of a pass must not overlap, so every triangle is changed by at most one of them. An interior collapse removes two triangles.
+			const size_t collapseGoal = (result.size() - targetIndexCount) / 6 + 1;
+			size_t collapseCount = 0;
+			std::fill(touched.begin(), touched.end(), false);
+			for (size_t v = 0; v < vertexCount; v++) {
+				remap[v] = static_cast<uint32_t>(v);
+			}
+			for (const Collapse &collapse : collapses) {
+				if ((collapse.error > maxError) || (collapseCount >= collapseGoal)) {
+					break;
+				}
+				const uint32_t from = positionIds[collapse.from];
+				const uint32_t to = positionIds[collapse.to];
+				if (touched[from] || touched[to]) {
+					continue;
+				}
+				const glm::dvec3 target = getPosition(positions, positionStride, collapse.to);
+				bool flipped = false;
+				for (uint32_t a = adjacencyOffsets[from]; (a < adjacencyOffsets[from + 1]) && !flipped; a++) {
+					const uint32_t *triangle = &result[adjacency[a] * 3];
+					glm::dvec3 before[3];
+					glm::dvec3 after[3];
+					bool removed = false;
+					for (uint32_t c = 0; c < 3; c++) {
+						before[c] = getPosition(positions, positionStride, triangle[c]);
+						after[c] = (positionIds[triangle[c]] == from) ? target : before[c];
+						removed = removed || (positionIds[triangle[c]] == to);
+					}
+					if (!removed) {
+						const glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+						const glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+						flipped = (glm::dot(normalBefore, normalAfter) <= 0.0);
+					}
+				}
+				if (flipped) {
+					continue;
+				}
+				// The neighbourhood is locked for the rest of the pass, as its triangles change with this collapse
+				for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++) {
+					for (uint32_t c = 0; c < 3; c++) {
+						touched[positionIds[result[adjacency[a] * 3 + c]]] = true;
+					}
+				}
+				// Unlocked positions are used by a single vertex, so only that one has to be redirected
+				remap[collapse.from] = collapse.to;
+				quadrics[to] += quadrics[from];
+				error = std::max(error, collapse.error);
+				collapseCount++;
+			}
+			if (collapseCount == 0) {
+				break;
+			}
+
+			size_t count = 0;
+			for (size_t i = 0; i < result.size(); i += 3) {
+				const uint32_t a = remap[result[i]];
+				const uint32_t b = remap[result[i + 1]];
+				const uint32_t c = remap[result[i + 2]];
+				if ((positionIds[a] != positionIds[b]) && (positionIds[b] != positionIds[c]) && (positionIds[c] != positionIds[a])) {
+					result[count++] = a;
+					result[count++] = b;
+					result[count++] = c;
+				}
+			}
+			result.resize(count);
+		}
+
+		resultError = static_cast<float>(sqrt(error));
+		std::copy(result.begin(), result.end(), destination);
+		return result.size();
+	}
+}
@@ -0,0 +1,28 @@
+/*
+* glTF mesh simplification
+*
+* Reduces the triangle count of indexed triangle lists with quadric error metrics, collapsing edges onto existing vertices so
+* simplified index buffers can share the vertex buffer of the full resolution mesh
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vkglTF
+{
+	/**
+	* @brief Simplifies a triangle list until it has at most targetIndexCount indices or no collapse stays below targetError
+	*
+	* Edges are collapsed onto one of their vertices in order of their quadric error (Garland and Heckbert, "Surface Simplification
+	* Using Quadric Error Metrics"), so the result only references vertices of the input. Vertices on open borders, on attribute
+	* seams (several vertices at the same position) and on non-manifold edges are never moved. Positions are read as three floats,
+	* positionStride bytes apart. Writes the simplified indices to destination, which needs room for indexCount indices, and returns
+	* their count. resultError receives the estimated distance between the simplified and the input surface in position units.
+	*/
+	size_t simplifyTriangles(uint32_t *destination, const uint32_t *indices, size_t indexCount, const float *positions, size_t positionStride, size_t vertexCount,
+		size_t targetIndexCount, float targetError, float &resultError);
+}
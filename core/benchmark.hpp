@@ -32,6 +32,10 @@ namespace vks
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
 
+		/** @brief Named memory counters in bytes, sampled by getMemoryCounters once the benchmark has finished */
+		std::vector<std::pair<std::string, uint64_t>> memoryCounters;
+		std::function<std::vector<std::pair<std::string, uint64_t>>()> getMemoryCounters;
+
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
 			this->deviceProps = deviceProps;
@@ -69,6 +73,12 @@ namespace vks
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				if (getMemoryCounters) {
+					memoryCounters = getMemoryCounters();
+					for (auto& counter : memoryCounters) {
+						std::cout << "memory : " << counter.first << " " << (counter.second / (1024.0 * 1024.0)) << " MiB" << "\n";
+					}
+				}
 			}
 		}
 
@@ -94,6 +104,13 @@ namespace vks
 					std::cout << "\n";
 				}
 
+				if (!memoryCounters.empty()) {
+					result << "\n" << "memory,bytes" << "\n";
+					for (auto& counter : memoryCounters) {
+						result << counter.first << "," << counter.second << "\n";
+					}
+				}
+
 				result.flush();
 #if defined(_WIN32)
 				FreeConsole();
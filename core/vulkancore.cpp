@@ -16,6 +16,24 @@
 
 std::vector<const char*> VulkanExampleBase::args;
 
+namespace
+{
+	// Prepended to the serialized pipeline cache data, identifies the device and driver that produced it
+	struct PipelineCacheFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t dataHash;
+	};
+	const uint32_t pipelineCacheFileMagic = 0x43504b56; // "VKPC"
+	const uint32_t pipelineCacheFileVersion = 1;
+}
+
 VkResult VulkanExampleBase::createInstance(bool enableValidation)
 {
 	this->settings.validation = enableValidation;
@@ -31,28 +49,31 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	appInfo.pEngineName = name.c_str();
 	appInfo.apiVersion = apiVersion;
 
-	std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
+	std::vector<const char*> instanceExtensions;
 
-	// Enable surface extensions depending on os
+	// Enable surface extensions depending on os, offscreen rendering doesn't present to a surface
+	if (!settings.offscreen) {
+		instanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 #if defined(_WIN32)
-	instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
-	instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
 #elif defined(_DIRECT2DISPLAY)
-	instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_DIRECTFB_EXT)
-	instanceExtensions.push_back(VK_EXT_DIRECTFB_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_EXT_DIRECTFB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_IOS_MVK)
-	instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_MACOS_MVK)
-	instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_HEADLESS_EXT)
-	instanceExtensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
 #endif
+	}
 	
 	// Get extensions supported by the instance and store for later use
 	uint32_t extCount = 0;
@@ -91,6 +112,13 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 		}
 	}
 
+	// Needed by VK_KHR_timeline_semaphore on Vulkan 1.0 instances and to query heap budgets with VK_EXT_memory_budget
+	if ((std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != supportedInstanceExtensions.end()) &&
+		(std::find_if(instanceExtensions.begin(), instanceExtensions.end(), [](const char* extension) { return strcmp(extension, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0; }) == instanceExtensions.end()))
+	{
+		instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
 	VkInstanceCreateInfo instanceCreateInfo = {};
 	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	instanceCreateInfo.pNext = NULL;
@@ -105,13 +133,13 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	}
 #endif
 
+	if (settings.validation)
+	{
+		instanceExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);	// SRS - Dependency when VK_EXT_DEBUG_MARKER is enabled
+		instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	}
 	if (instanceExtensions.size() > 0)
 	{
-		if (settings.validation)
-		{
-			instanceExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);	// SRS - Dependency when VK_EXT_DEBUG_MARKER is enabled
-			instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-		}
 		instanceCreateInfo.enabledExtensionCount = (uint32_t)instanceExtensions.size();
 		instanceCreateInfo.ppEnabledExtensionNames = instanceExtensions.data();
 	}
@@ -145,10 +173,12 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 
 void VulkanExampleBase::renderFrame()
 {
-	VulkanExampleBase::prepareFrame();
+	if (!VulkanExampleBase::prepareFrame()) {
+		return;
+	}
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, frameSync[currentFrame].fence));
 	VulkanExampleBase::submitFrame();
 }
 
@@ -165,8 +195,8 @@ std::string VulkanExampleBase::getWindowTitle()
 
 void VulkanExampleBase::createCommandBuffers()
 {
-	// Create one command buffer for each swap chain image and reuse for rendering
-	drawCmdBuffers.resize(swapChain.imageCount);
+	// Create one command buffer for each swap chain image (or offscreen target) and reuse for rendering
+	drawCmdBuffers.resize(settings.offscreen ? offscreen.targets.size() : swapChain.imageCount);
 
 	VkCommandBufferAllocateInfo cmdBufAllocateInfo =
 		vks::initializers::commandBufferAllocateInfo(
@@ -175,6 +205,8 @@ void VulkanExampleBase::createCommandBuffers()
 			static_cast<uint32_t>(drawCmdBuffers.size()));
 
 	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, drawCmdBuffers.data()));
+	// The initial recording is done by the example
+	drawCmdBuffersDirty.assign(drawCmdBuffers.size(), false);
 }
 
 void VulkanExampleBase::destroyCommandBuffers()
@@ -189,9 +221,96 @@ std::string VulkanExampleBase::getShadersPath() const
 
 void VulkanExampleBase::createPipelineCache()
 {
+	// Try to seed the cache with the data stored by a previous run on the same device and driver
+	std::vector<uint8_t> cacheData;
+	if (!settings.pipelineCacheFile.empty() && vks::tools::fileExists(settings.pipelineCacheFile)) {
+		std::ifstream file(settings.pipelineCacheFile, std::ios::binary | std::ios::ate);
+		std::vector<uint8_t> fileData(static_cast<size_t>(std::max<std::streamoff>(file.tellg(), 0)));
+		file.seekg(0, std::ios::beg);
+		file.read(reinterpret_cast<char*>(fileData.data()), fileData.size());
+		std::string rejectReason;
+		PipelineCacheFileHeader header{};
+		if (!file || (fileData.size() < sizeof(header))) {
+			rejectReason = "file is truncated";
+		}
+		else {
+			memcpy(&header, fileData.data(), sizeof(header));
+			if ((header.magic != pipelineCacheFileMagic) || (header.version != pipelineCacheFileVersion)) {
+				rejectReason = "unknown file format";
+			}
+			else if ((header.vendorID != deviceProperties.vendorID) || (header.deviceID != deviceProperties.deviceID) || (header.driverVersion != deviceProperties.driverVersion) || (memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)) {
+				rejectReason = "created by a different device or driver";
+			}
+			else if ((header.dataSize != fileData.size() - sizeof(header)) || (vks::tools::hashData(fileData.data() + sizeof(header), static_cast<size_t>(header.dataSize)) != header.dataHash)) {
+				rejectReason = "data is corrupt";
+			}
+		}
+		if (rejectReason.empty()) {
+			cacheData.assign(fileData.begin() + sizeof(header), fileData.end());
+		}
+		else {
+			std::cout << "Ignoring pipeline cache \"" << settings.pipelineCacheFile << "\": " << rejectReason << "\n";
+		}
+	}
+
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+	pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+	pipelineCacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+	VkResult result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+	if ((result != VK_SUCCESS) && !cacheData.empty()) {
+		// Fall back to an empty cache if the driver refuses the stored data
+		std::cout << "Ignoring pipeline cache \"" << settings.pipelineCacheFile << "\": rejected by the driver" << "\n";
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = nullptr;
+		result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+	}
+	VK_CHECK_RESULT(result);
+}
+
+void VulkanExampleBase::savePipelineCache()
+{
+	if (settings.pipelineCacheFile.empty() || (pipelineCache == VK_NULL_HANDLE)) {
+		return;
+	}
+	size_t dataSize = 0;
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+	std::vector<uint8_t> fileData(sizeof(PipelineCacheFileHeader) + dataSize);
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, fileData.data() + sizeof(PipelineCacheFileHeader)));
+	fileData.resize(sizeof(PipelineCacheFileHeader) + dataSize);
+
+	PipelineCacheFileHeader header{};
+	header.magic = pipelineCacheFileMagic;
+	header.version = pipelineCacheFileVersion;
+	header.vendorID = deviceProperties.vendorID;
+	header.deviceID = deviceProperties.deviceID;
+	header.driverVersion = deviceProperties.driverVersion;
+	memcpy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = dataSize;
+	header.dataHash = vks::tools::hashData(fileData.data() + sizeof(header), dataSize);
+	memcpy(fileData.data(), &header, sizeof(header));
+
+	// Write to a unique temporary file first and move it into place, so concurrent runs and crashes never leave a partially written cache behind
+	const std::string tempFile = settings.pipelineCacheFile + "." + std::to_string(std::chrono::high_resolution_clock::now().time_since_epoch().count()) + ".tmp";
+	{
+		std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(fileData.data()), fileData.size());
+		if (!file) {
+			std::cerr << "Could not write pipeline cache \"" << tempFile << "\"" << "\n";
+			file.close();
+			std::remove(tempFile.c_str());
+			return;
+		}
+	}
+#if defined(_WIN32)
+	const bool moved = MoveFileExA(tempFile.c_str(), settings.pipelineCacheFile.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	const bool moved = std::rename(tempFile.c_str(), settings.pipelineCacheFile.c_str()) == 0;
+#endif
+	if (!moved) {
+		std::cerr << "Could not replace pipeline cache \"" << settings.pipelineCacheFile << "\"" << "\n";
+		std::remove(tempFile.c_str());
+	}
 }
 
 void VulkanExampleBase::prepare()
@@ -199,16 +318,29 @@ void VulkanExampleBase::prepare()
 	if (vulkanDevice->enableDebugMarkers) {
 		vks::debugmarker::setup(device);
 	}
-	initSwapchain();
+	if (settings.offscreen) {
+		createOffscreenTargets();
+	}
+	else {
+		initSwapchain();
+	}
 	createCommandPool();
-	setupSwapChain();
+	if (!settings.offscreen) {
+		setupSwapChain();
+	}
 	createCommandBuffers();
 	createSynchronizationPrimitives();
+	// One uniform slice per command buffer, as these are recorded once per image and reused
+	vulkanDevice->uniformAllocator.create(vulkanDevice, uniformFrameSize, static_cast<uint32_t>(drawCmdBuffers.size()), std::min<VkDeviceSize>(vulkanDevice->properties.limits.maxUniformBufferRange, 65536));
 	setupDepthStencil();
 	setupRenderPass();
 	createPipelineCache();
+	pipelineCompiler = new vks::PipelineCompiler(device, pipelineCache);
 	setupFrameBuffer();
-	settings.overlay = settings.overlay && (!benchmark.active);
+	settings.overlay = settings.overlay && (!benchmark.active) && (!settings.offscreen);
+	benchmark.getMemoryCounters = [this] { return getMemoryCounters(); };
+	// Measured or captured frames must not miss any draws
+	settings.asyncPipelines = settings.asyncPipelines && (!benchmark.active) && (!settings.offscreen);
 	if (settings.overlay) {
 		UIOverlay.device = vulkanDevice;
 		UIOverlay.queue = queue;
@@ -217,7 +349,9 @@ void VulkanExampleBase::prepare()
 			loadShader(getShadersPath() + "base/uioverlay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
 		};
 		UIOverlay.prepareResources();
-		UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat);
+		UIOverlay.setImageCount(static_cast<uint32_t>(drawCmdBuffers.size()));
+		// Without a compiler the overlay creates its pipeline right away, like the example's own pipelines with --syncpipelines
+		UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat, settings.asyncPipelines ? pipelineCompiler : nullptr);
 	}
 }
 
@@ -227,9 +361,15 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 	shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStage.stage = stage;
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
-	shaderStage.module = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
+	AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, fileName.c_str(), AASSET_MODE_STREAMING);
+	assert(asset);
+	std::vector<uint32_t> shaderCode(AAsset_getLength(asset) / sizeof(uint32_t));
+	AAsset_read(asset, shaderCode.data(), shaderCode.size() * sizeof(uint32_t));
+	AAsset_close(asset);
+	shaderStage.module = shaderModuleCache.acquire(shaderCode.data(), shaderCode.size() * sizeof(uint32_t), fileName);
 #else
-	shaderStage.module = vks::tools::loadShader(fileName.c_str(), device);
+	// Shaders shared by several pipelines are only loaded and created once
+	shaderStage.module = shaderModuleCache.acquireFile(fileName);
 #endif
 	shaderStage.pName = "main";
 	assert(shaderStage.module != VK_NULL_HANDLE);
@@ -237,6 +377,15 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 	return shaderStage;
 }
 
+void VulkanExampleBase::releaseShader(VkShaderModule module)
+{
+	auto loaded = std::find(shaderModules.begin(), shaderModules.end(), module);
+	if (loaded != shaderModules.end()) {
+		shaderModules.erase(loaded);
+		shaderModuleCache.release(module);
+	}
+}
+
 void VulkanExampleBase::nextFrame()
 {
 	auto tStart = std::chrono::high_resolution_clock::now();
@@ -275,7 +424,7 @@ void VulkanExampleBase::nextFrame()
 	{
 		lastFPS = static_cast<uint32_t>((float)frameCounter * (1000.0f / fpsTimer));
 #if defined(_WIN32)
-		if (!settings.overlay)	{
+		if (!settings.overlay && !settings.offscreen)	{
 			std::string windowTitle = getWindowTitle();
 			SetWindowText(window, windowTitle.c_str());
 		}
@@ -302,6 +451,28 @@ void VulkanExampleBase::renderLoop()
 		}
 		return;
 	}
+	if (settings.offscreen) {
+		// Render a fixed number of frames without any window system interaction
+		const bool writeEachFrame = (offscreen.outputFile.find("%d") != std::string::npos);
+		lastTimestamp = std::chrono::high_resolution_clock::now();
+		tPrevEnd = lastTimestamp;
+		auto tStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < offscreen.frameCount; i++) {
+			nextFrame();
+			if (writeEachFrame) {
+				std::string fileName = offscreen.outputFile;
+				fileName.replace(fileName.find("%d"), 2, std::to_string(i));
+				saveOffscreenImage(fileName);
+			}
+		}
+		vkDeviceWaitIdle(device);
+		auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		std::cout << "Rendered " << offscreen.frameCount << " offscreen frames in " << tDiff << " ms (" << tDiff / offscreen.frameCount << " ms/frame)" << "\n";
+		if (!offscreen.outputFile.empty() && !writeEachFrame) {
+			saveOffscreenImage(offscreen.outputFile);
+		}
+		return;
+	}
 #endif
 
 	destWidth = width;
@@ -690,6 +861,7 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PushItemWidth(110.0f * UIOverlay.scale);
 	OnUpdateUIOverlay(&UIOverlay);
 	ImGui::PopItemWidth();
+	drawMemoryStatistics();
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PopStyleVar();
 #endif
@@ -698,8 +870,9 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PopStyleVar();
 	ImGui::Render();
 
-	if (UIOverlay.update() || UIOverlay.updated) {
-		createCmdBufs();
+	// A changed setting may affect what the example records, the overlay geometry itself is uploaded per image in prepareFrame()
+	if (UIOverlay.updated) {
+		invalidateCmdBufs();
 		UIOverlay.updated = false;
 	}
 
@@ -710,38 +883,120 @@ void VulkanExampleBase::updateOverlay()
 #endif
 }
 
-void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
+void VulkanExampleBase::drawMemoryStatistics()
+{
+	// Collapsed by default, the statistics and budgets are only polled while they are shown
+	if (!ImGui::CollapsingHeader("Memory")) {
+		return;
+	}
+	vulkanDevice->updateMemoryBudget();
+	const vks::MemoryStatistics statistics = vulkanDevice->memoryAllocator.getStatistics();
+	const float MiB = 1024.0f * 1024.0f;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(vks::MemoryCategory::Count); i++) {
+		const vks::MemoryCategoryStats& stats = statistics.categories[i];
+		ImGui::Text("%-8s %4u: %7.2f MiB (peak %.2f)", vks::getMemoryCategoryName(static_cast<vks::MemoryCategory>(i)), stats.allocationCount, stats.allocatedBytes / MiB, stats.peakAllocatedBytes / MiB);
+	}
+	ImGui::Text("reserved %.2f MiB in %u blocks", statistics.total.reservedBytes / MiB, statistics.total.deviceMemoryCount);
+	for (size_t i = 0; i < vulkanDevice->heapBudgets.size(); i++) {
+		const vks::MemoryHeapBudget& heap = vulkanDevice->heapBudgets[i];
+		ImGui::Text("heap %u%s: %.1f / %.1f MiB", static_cast<uint32_t>(i), heap.deviceLocal ? " (local)" : "", heap.usage / MiB, heap.budget / MiB);
+	}
+	if (!vulkanDevice->memoryBudget) {
+		ImGui::TextUnformatted("VK_EXT_memory_budget not available");
+	}
+}
+
+std::vector<std::pair<std::string, uint64_t>> VulkanExampleBase::getMemoryCounters()
+{
+	std::vector<std::pair<std::string, uint64_t>> counters;
+	const vks::MemoryStatistics statistics = vulkanDevice->memoryAllocator.getStatistics();
+	for (uint32_t i = 0; i < static_cast<uint32_t>(vks::MemoryCategory::Count); i++) {
+		const std::string name = vks::getMemoryCategoryName(static_cast<vks::MemoryCategory>(i));
+		counters.push_back(std::make_pair(name, statistics.categories[i].allocatedBytes));
+		counters.push_back(std::make_pair(name + " peak", statistics.categories[i].peakAllocatedBytes));
+	}
+	counters.push_back(std::make_pair(std::string("reserved"), statistics.total.reservedBytes));
+	vulkanDevice->updateMemoryBudget();
+	for (size_t i = 0; i < vulkanDevice->heapBudgets.size(); i++) {
+		const std::string name = "heap " + std::to_string(i);
+		counters.push_back(std::make_pair(name + " usage", vulkanDevice->heapBudgets[i].usage));
+		counters.push_back(std::make_pair(name + " budget", vulkanDevice->heapBudgets[i].budget));
+	}
+	return counters;
+}
+
+void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer, uint32_t imageIndex)
 {
-	if (settings.overlay && UIOverlay.visible) {
+	// Visibility is checked by the overlay, which needs to keep track of what has been recorded
+	if (settings.overlay) {
 		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-		UIOverlay.draw(commandBuffer);
+		UIOverlay.draw(commandBuffer, imageIndex);
 	}
 }
 
-void VulkanExampleBase::prepareFrame()
+bool VulkanExampleBase::prepareFrame()
 {
-	// Acquire the next image from the swap chain
-	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
-	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
-	// SRS - If no longer optimal (VK_SUBOPTIMAL_KHR), wait until submitFrame() in case number of swapchain images will change on resize
-	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
+	FrameSync& frame = frameSync[currentFrame];
+	// Wait until the GPU has finished the previous submission of this frame in flight, so its semaphores and fence can be reused
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+	if (settings.offscreen) {
+		// Each frame in flight owns its offscreen target, so there is nothing to acquire
+		currentBuffer = currentFrame;
+	}
+	else {
+		// Acquire the next image from the swap chain
+		VkResult result = swapChain.acquireNextImage(frame.presentComplete, &currentBuffer);
+		// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
+		// SRS - If no longer optimal (VK_SUBOPTIMAL_KHR), wait until submitFrame() in case number of swapchain images will change on resize
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			windowResize();
+			return false;
+		}
+		if (result != VK_SUBOPTIMAL_KHR) {
+			VK_CHECK_RESULT(result);
+		}
+		// Images may be returned out of order, so the acquired image can still be in use by another frame in flight
+		if ((imageFences[currentBuffer] != VK_NULL_HANDLE) && (imageFences[currentBuffer] != frame.fence)) {
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &imageFences[currentBuffer], VK_TRUE, UINT64_MAX));
 		}
-		return;
 	}
-	else {
-		VK_CHECK_RESULT(result);
+	imageFences[currentBuffer] = frame.fence;
+	// The image's previous submission has finished, so its uniform slice can be rewritten
+	vulkanDevice->uniformAllocator.beginFrame(currentBuffer);
+	updateFrameUniforms(currentBuffer);
+	// Nothing reads the image's overlay buffers and command buffer anymore, so they can be updated in place
+	if (settings.overlay && UIOverlay.update(currentBuffer)) {
+		drawCmdBuffersDirty[currentBuffer] = true;
+	}
+	if (drawCmdBuffersDirty[currentBuffer]) {
+		recordCmdBuf(currentBuffer);
+		drawCmdBuffersDirty[currentBuffer] = false;
+	}
+	// Hand finished transfer queue uploads over to the graphics queue, then submit them along with the uploads recorded since the last frame (e.g. by loaders) ahead of the frame's command buffer
+	vulkanDevice->asyncTransfer.update();
+	vulkanDevice->stagingRing.submit();
+	// Only reset the fence once it's certain that work will be submitted with it
+	VK_CHECK_RESULT(vkResetFences(device, 1, &frame.fence));
+	if (!settings.offscreen) {
+		submitInfo.pWaitSemaphores = &frame.presentComplete;
+		submitInfo.pSignalSemaphores = &frame.renderComplete;
 	}
+	return true;
 }
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	if (settings.offscreen) {
+		offscreen.lastTarget = currentBuffer;
+		currentFrame = (currentFrame + 1) % static_cast<uint32_t>(frameSync.size());
+		return;
+	}
+	VkResult result = swapChain.queuePresent(queue, currentBuffer, frameSync[currentFrame].renderComplete);
+	currentFrame = (currentFrame + 1) % static_cast<uint32_t>(frameSync.size());
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -752,7 +1007,6 @@ void VulkanExampleBase::submitFrame()
 	else {
 		VK_CHECK_RESULT(result);
 	}
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -790,6 +1044,15 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("framesinflight", { "-fif", "--framesinflight" }, 1, "Set the number of frames in flight (1 - 3)");
+	commandLineParser.add("workerthreads", { "-wt", "--workerthreads" }, 1, "Set the number of job system worker threads (0 = automatic)");
+	commandLineParser.add("pipelinecachefile", { "-pcf", "--pipelinecachefile" }, 1, "Set the file the pipeline cache is persisted to");
+	commandLineParser.add("nopipelinecachefile", { "-npcf", "--nopipelinecachefile" }, 0, "Don't load or store the pipeline cache on disk");
+	commandLineParser.add("recordjobs", { "-rj", "--recordjobs" }, 1, "Record command buffers in parallel, split into the given number of jobs per image");
+	commandLineParser.add("syncpipelines", { "-sp", "--syncpipelines" }, 0, "Wait for all pipelines to be compiled before rendering the first frame");
+	commandLineParser.add("offscreen", { "-os", "--offscreen" }, 0, "Render to offscreen images without a window or swap chain");
+	commandLineParser.add("offscreenframes", { "-ofs", "--offscreenframes" }, 1, "Set the number of frames to render in offscreen mode");
+	commandLineParser.add("offscreenoutput", { "-oo", "--offscreenoutput" }, 1, "Write the offscreen result to a .png or .ppm file (%d in the name writes every frame)");
 
 	commandLineParser.parse(args);
 	if (commandLineParser.isSet("help")) {
@@ -843,6 +1106,38 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("framesinflight")) {
+		int32_t value = commandLineParser.getValueAsInt("framesinflight", settings.framesInFlight);
+		settings.framesInFlight = static_cast<uint32_t>(std::min(std::max(value, 1), 3));
+	}
+	if (commandLineParser.isSet("workerthreads")) {
+		// 0 selects the default worker count, more workers than hardware threads only add contention
+		const int32_t hardwareThreads = static_cast<int32_t>(std::max(std::thread::hardware_concurrency(), 1u));
+		int32_t value = commandLineParser.getValueAsInt("workerthreads", static_cast<int32_t>(vks::JobSystem::instance().getWorkerCount()));
+		vks::JobSystem::instance().setWorkerCount(static_cast<uint32_t>(std::min(std::max(value, 0), hardwareThreads)));
+	}
+	if (commandLineParser.isSet("pipelinecachefile")) {
+		settings.pipelineCacheFile = commandLineParser.getValueAsString("pipelinecachefile", settings.pipelineCacheFile);
+	}
+	if (commandLineParser.isSet("nopipelinecachefile")) {
+		settings.pipelineCacheFile.clear();
+	}
+	if (commandLineParser.isSet("recordjobs")) {
+		int32_t value = commandLineParser.getValueAsInt("recordjobs", static_cast<int32_t>(settings.recordJobs));
+		settings.recordJobs = static_cast<uint32_t>(std::max(value, 1));
+	}
+	if (commandLineParser.isSet("syncpipelines")) {
+		settings.asyncPipelines = false;
+	}
+	if (commandLineParser.isSet("offscreen")) {
+		settings.offscreen = true;
+	}
+	if (commandLineParser.isSet("offscreenframes")) {
+		offscreen.frameCount = commandLineParser.getValueAsInt("offscreenframes", offscreen.frameCount);
+	}
+	if (commandLineParser.isSet("offscreenoutput")) {
+		offscreen.outputFile = commandLineParser.getValueAsString("offscreenoutput", offscreen.outputFile);
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Vulkan library is loaded dynamically on Android
@@ -851,9 +1146,13 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 #elif defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	initWaylandConnection();
+	if (!settings.offscreen) {
+		initWaylandConnection();
+	}
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	initxcbConnection();
+	if (!settings.offscreen) {
+		initxcbConnection();
+	}
 #endif
 
 #if defined(_WIN32)
@@ -869,6 +1168,8 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 VulkanExampleBase::~VulkanExampleBase()
 {
 	// Clean up Vulkan resources
+	// Pipelines that are still being compiled may reference the objects destroyed below
+	delete pipelineCompiler;
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
 	{
@@ -886,21 +1187,22 @@ VulkanExampleBase::~VulkanExampleBase()
 
 	for (auto& shaderModule : shaderModules)
 	{
-		vkDestroyShaderModule(device, shaderModule, nullptr);
+		shaderModuleCache.release(shaderModule);
 	}
+	shaderModules.clear();
+	shaderModuleCache.clear();
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.mem, nullptr);
 
+	destroyOffscreenTargets();
+
+	savePipelineCache();
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
 	vkDestroyCommandPool(device, cmdPool, nullptr);
 
-	vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
-	for (auto& fence : waitFences) {
-		vkDestroyFence(device, fence, nullptr);
-	}
+	destroySynchronizationPrimitives();
 
 	if (settings.overlay) {
 		UIOverlay.freeResources();
@@ -929,24 +1231,28 @@ VulkanExampleBase::~VulkanExampleBase()
 	if (dfb)
 		dfb->Release(dfb);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	xdg_toplevel_destroy(xdg_toplevel);
-	xdg_surface_destroy(xdg_surface);
-	wl_surface_destroy(surface);
-	if (keyboard)
-		wl_keyboard_destroy(keyboard);
-	if (pointer)
-		wl_pointer_destroy(pointer);
-	if (seat)
-		wl_seat_destroy(seat);
-	xdg_wm_base_destroy(shell);
-	wl_compositor_destroy(compositor);
-	wl_registry_destroy(registry);
-	wl_display_disconnect(display);
+	if (display) {
+		xdg_toplevel_destroy(xdg_toplevel);
+		xdg_surface_destroy(xdg_surface);
+		wl_surface_destroy(surface);
+		if (keyboard)
+			wl_keyboard_destroy(keyboard);
+		if (pointer)
+			wl_pointer_destroy(pointer);
+		if (seat)
+			wl_seat_destroy(seat);
+		xdg_wm_base_destroy(shell);
+		wl_compositor_destroy(compositor);
+		wl_registry_destroy(registry);
+		wl_display_disconnect(display);
+	}
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// todo : android cleanup (if required)
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	xcb_destroy_window(connection, window);
-	xcb_disconnect(connection);
+	if (!settings.offscreen) {
+		xcb_destroy_window(connection, window);
+		xcb_disconnect(connection);
+	}
 #endif
 }
 
@@ -1033,16 +1339,21 @@ bool VulkanExampleBase::initVulkan()
 	// This is handled by a separate class that gets a logical device representation
 	// and encapsulates functions related to a device
 	vulkanDevice = new vks::VulkanDevice(physicalDevice);
+	// VK_KHR_get_physical_device_properties2 is enabled in createInstance() whenever it's supported
+	if (std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != supportedInstanceExtensions.end()) {
+		vulkanDevice->getPhysicalDeviceMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+	}
 
 	// Derived examples can enable extensions based on the list of supported extensions read from the physical device
 	getEnabledExtensions();
 
-	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain, !settings.offscreen);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
 		return false;
 	}
 	device = vulkanDevice->logicalDevice;
+	shaderModuleCache.setDevice(device);
 
 	// Get a graphics queue from the device
 	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
@@ -1053,24 +1364,14 @@ bool VulkanExampleBase::initVulkan()
 
 	swapChain.connect(instance, physicalDevice, device);
 
-	// Create synchronization objects
-	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-	// Create a semaphore used to synchronize image presentation
-	// Ensures that the image is displayed before we start submitting new commands to the queue
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.presentComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands have been submitted and executed
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.renderComplete));
-
 	// Set up submit info structure
-	// Semaphores will stay the same during application lifetime
+	// Semaphores are set for the current frame in flight by prepareFrame()
 	// Command buffer submission info is set by each example
 	submitInfo = vks::initializers::submitInfo();
 	submitInfo.pWaitDstStageMask = &submitPipelineStages;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &semaphores.presentComplete;
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &semaphores.renderComplete;
+	// Offscreen frames are neither acquired nor presented, so there are no semaphores to wait on or signal
+	submitInfo.waitSemaphoreCount = settings.offscreen ? 0 : 1;
+	submitInfo.signalSemaphoreCount = settings.offscreen ? 0 : 1;
 
 	return true;
 }
@@ -1110,6 +1411,10 @@ void VulkanExampleBase::setupDPIAwareness()
 HWND VulkanExampleBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 {
 	this->windowInstance = hinstance;
+	if (settings.offscreen) {
+		window = nullptr;
+		return window;
+	}
 
 	WNDCLASSEX wndClass;
 
@@ -2409,6 +2714,9 @@ static const struct xdg_toplevel_listener xdg_toplevel_listener = {
 
 struct xdg_surface *VulkanExampleBase::setupWindow()
 {
+	if (settings.offscreen) {
+		return nullptr;
+	}
 	surface = wl_compositor_create_surface(compositor);
 	xdg_surface = xdg_wm_base_get_xdg_surface(shell, surface);
 
@@ -2435,6 +2743,10 @@ xcb_window_t VulkanExampleBase::setupWindow()
 {
 	uint32_t value_mask, value_list[32];
 
+	if (settings.offscreen) {
+		return 0;
+	}
+
 	window = xcb_generate_id(connection);
 
 	value_mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
@@ -2658,21 +2970,59 @@ void VulkanExampleBase::mouseMoved(double x, double y, bool & handled) {}
 
 void VulkanExampleBase::createCmdBufs() {}
 
+void VulkanExampleBase::recordCmdBuf(uint32_t)
+{
+	// Examples that can only record all command buffers at once have to wait until none of them is in flight
+	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	if (settings.overlay) {
+		for (uint32_t i = 0; i < drawCmdBuffers.size(); i++) {
+			UIOverlay.update(i);
+		}
+	}
+	createCmdBufs();
+	std::fill(drawCmdBuffersDirty.begin(), drawCmdBuffersDirty.end(), false);
+}
+
+void VulkanExampleBase::invalidateCmdBufs()
+{
+	std::fill(drawCmdBuffersDirty.begin(), drawCmdBuffersDirty.end(), true);
+}
+
 void VulkanExampleBase::createSynchronizationPrimitives()
 {
-	// Wait fences to sync command buffer access
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	// Fences are created signaled, so the first wait for each frame in flight returns immediately
 	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-	waitFences.resize(drawCmdBuffers.size());
-	for (auto& fence : waitFences) {
-		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
+	frameSync.resize(settings.framesInFlight);
+	for (auto& frame : frameSync) {
+		// Ensures that the image is displayed before we start submitting new commands to the queue
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.presentComplete));
+		// Ensures that the image is not presented until all commands have been submitted and executed
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.renderComplete));
+		// Sync command buffer and uniform buffer access of this frame in flight
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &frame.fence));
+	}
+	currentFrame = 0;
+	// No swap chain image is in use by a frame in flight yet
+	imageFences.assign(drawCmdBuffers.size(), VK_NULL_HANDLE);
+}
+
+void VulkanExampleBase::destroySynchronizationPrimitives()
+{
+	for (auto& frame : frameSync) {
+		vkDestroySemaphore(device, frame.presentComplete, nullptr);
+		vkDestroySemaphore(device, frame.renderComplete, nullptr);
+		vkDestroyFence(device, frame.fence, nullptr);
 	}
+	frameSync.clear();
+	imageFences.clear();
 }
 
 void VulkanExampleBase::createCommandPool()
 {
 	VkCommandPoolCreateInfo cmdPoolInfo = {};
 	cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
+	cmdPoolInfo.queueFamilyIndex = settings.offscreen ? vulkanDevice->queueFamilyIndices.graphics : swapChain.queueNodeIndex;
 	cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &cmdPool));
 }
@@ -2735,11 +3085,11 @@ void VulkanExampleBase::setupFrameBuffer()
 	frameBufferCreateInfo.height = height;
 	frameBufferCreateInfo.layers = 1;
 
-	// Create frame buffers for every swap chain image
-	frameBuffers.resize(swapChain.imageCount);
+	// Create frame buffers for every swap chain image (or offscreen target)
+	frameBuffers.resize(settings.offscreen ? offscreen.targets.size() : swapChain.imageCount);
 	for (uint32_t i = 0; i < frameBuffers.size(); i++)
 	{
-		attachments[0] = swapChain.buffers[i].view;
+		attachments[0] = settings.offscreen ? offscreen.targets[i].view : swapChain.buffers[i].view;
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &frameBuffers[i]));
 	}
 }
@@ -2748,14 +3098,15 @@ void VulkanExampleBase::setupRenderPass()
 {
 	std::array<VkAttachmentDescription, 2> attachments = {};
 	// Color attachment
-	attachments[0].format = swapChain.colorFormat;
+	attachments[0].format = settings.offscreen ? offscreen.colorFormat : swapChain.colorFormat;
 	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
 	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	// Offscreen targets are left ready to be copied for readback
+	attachments[0].finalLayout = settings.offscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 	// Depth attachment
 	attachments[1].format = depthFormat;
 	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -2786,7 +3137,7 @@ void VulkanExampleBase::setupRenderPass()
 	subpassDescription.pResolveAttachments = nullptr;
 
 	// Subpass dependencies for layout transitions
-	std::array<VkSubpassDependency, 2> dependencies;
+	std::array<VkSubpassDependency, 3> dependencies;
 
 	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependencies[0].dstSubpass = 0;
@@ -2804,13 +3155,22 @@ void VulkanExampleBase::setupRenderPass()
 	dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
 	dependencies[1].dependencyFlags = 0;
 
+	// Offscreen only: make the color writes available to the readback copy
+	dependencies[2].srcSubpass = 0;
+	dependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[2].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[2].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	dependencies[2].dependencyFlags = 0;
+
 	VkRenderPassCreateInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
 	renderPassInfo.pAttachments = attachments.data();
 	renderPassInfo.subpassCount = 1;
 	renderPassInfo.pSubpasses = &subpassDescription;
-	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassInfo.dependencyCount = settings.offscreen ? 3 : 2;
 	renderPassInfo.pDependencies = dependencies.data();
 
 	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
@@ -2857,12 +3217,18 @@ void VulkanExampleBase::windowResize()
 	// references to the recreated frame buffer
 	destroyCommandBuffers();
 	createCommandBuffers();
+	// Uniform slices are kept per command buffer, a swap chain with more images needs a larger buffer, which the example's descriptors have to refer to
+	if (vulkanDevice->uniformAllocator.reserveFrames(static_cast<uint32_t>(drawCmdBuffers.size()))) {
+		uniformBufferRecreated();
+	}
+	if (settings.overlay) {
+		UIOverlay.setImageCount(static_cast<uint32_t>(drawCmdBuffers.size()));
+	}
 	createCmdBufs();
 	
-	// SRS - Recreate fences in case number of swapchain images has changed on resize
-	for (auto& fence : waitFences) {
-		vkDestroyFence(device, fence, nullptr);
-	}
+	// SRS - Recreate synchronization primitives in case number of swapchain images has changed on resize
+	// This also drops semaphores that may have been left signaled by an out of date acquire or present
+	destroySynchronizationPrimitives();
 	createSynchronizationPrimitives();
 
 	vkDeviceWaitIdle(device);
@@ -2913,6 +3279,10 @@ void VulkanExampleBase::handleMouseMove(int32_t x, int32_t y)
 
 void VulkanExampleBase::windowResized() {}
 
+void VulkanExampleBase::updateFrameUniforms(uint32_t) {}
+
+void VulkanExampleBase::uniformBufferRecreated() {}
+
 void VulkanExampleBase::initSwapchain()
 {
 #if defined(_WIN32)
@@ -2937,4 +3307,88 @@ void VulkanExampleBase::setupSwapChain()
 	swapChain.create(&width, &height, settings.vsync, settings.fullscreen);
 }
 
+void VulkanExampleBase::createOffscreenTargets()
+{
+	offscreen.targets.resize(settings.framesInFlight);
+	for (auto& target : offscreen.targets) {
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = offscreen.colorFormat;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &target.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, target.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &target.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, target.image, target.mem, 0));
+
+		VkImageViewCreateInfo imageViewCI = vks::initializers::imageViewCreateInfo();
+		imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewCI.image = target.image;
+		imageViewCI.format = offscreen.colorFormat;
+		imageViewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &target.view));
+	}
+
+	// Tightly packed RGBA8, kept mapped for the lifetime of the example
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&offscreen.readback,
+		(VkDeviceSize)width * height * 4));
+	VK_CHECK_RESULT(offscreen.readback.map());
+}
+
+void VulkanExampleBase::destroyOffscreenTargets()
+{
+	for (auto& target : offscreen.targets) {
+		vkDestroyImageView(device, target.view, nullptr);
+		vkDestroyImage(device, target.image, nullptr);
+		vkFreeMemory(device, target.mem, nullptr);
+	}
+	offscreen.targets.clear();
+	if (offscreen.readback.buffer != VK_NULL_HANDLE) {
+		offscreen.readback.destroy();
+	}
+}
+
+const uint8_t* VulkanExampleBase::readOffscreenImage()
+{
+	assert(settings.offscreen);
+	// The render pass' external dependency orders the copy after the color writes of earlier submissions
+	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, cmdPool, true);
+	VkBufferImageCopy region{};
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent = { width, height, 1 };
+	vkCmdCopyImageToBuffer(copyCmd, offscreen.targets[offscreen.lastTarget].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, offscreen.readback.buffer, 1, &region);
+	VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.buffer = offscreen.readback.buffer;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	// Waits for the copy to finish
+	vulkanDevice->flushCommandBuffer(copyCmd, queue, cmdPool);
+	return static_cast<const uint8_t*>(offscreen.readback.mapped);
+}
+
+bool VulkanExampleBase::saveOffscreenImage(const std::string &fileName)
+{
+	const uint8_t* pixels = readOffscreenImage();
+	const std::string extension = fileName.substr(fileName.find_last_of('.') + 1);
+	bool result = (extension == "ppm") ? vks::tools::savePPM(fileName, width, height, pixels) : vks::tools::savePNG(fileName, width, height, pixels);
+	if (result) {
+		std::cout << "Offscreen image written to \"" << fileName << "\"" << "\n";
+	}
+	return result;
+}
+
 void VulkanExampleBase::OnUpdateUIOverlay(vks::UIOverlay *overlay) {}
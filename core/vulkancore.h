@@ -68,6 +68,9 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "JobSystem.h"
+#include "VulkanPipelineCompiler.h"
+#include "VulkanShaderModuleCache.h"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
@@ -84,13 +87,19 @@ private:
 	void handleMouseMove(int32_t x, int32_t y);
 	void nextFrame();
 	void updateOverlay();
+	void drawMemoryStatistics();
+	std::vector<std::pair<std::string, uint64_t>> getMemoryCounters();
 	void createPipelineCache();
+	void savePipelineCache();
 	void createCommandPool();
 	void createSynchronizationPrimitives();
+	void destroySynchronizationPrimitives();
 	void initSwapchain();
 	void setupSwapChain();
 	void createCommandBuffers();
 	void destroyCommandBuffers();
+	void createOffscreenTargets();
+	void destroyOffscreenTargets();
 	std::string shaderDir = "glsl";
 protected:
 	// Returns the path to the root of the glsl or hlsl shader directory.
@@ -132,6 +141,8 @@ protected:
 	VkSubmitInfo submitInfo;
 	// Command buffers used for rendering
 	std::vector<VkCommandBuffer> drawCmdBuffers;
+	// Set for command buffers whose recorded commands are outdated, they're re-recorded when their image is acquired next
+	std::vector<bool> drawCmdBuffersDirty;
 	// Global render pass for frame buffer writes
 	VkRenderPass renderPass = VK_NULL_HANDLE;
 	// List of available frame buffers (same as number of swap chain images)
@@ -140,20 +151,48 @@ protected:
 	uint32_t currentBuffer = 0;
 	// Descriptor set pool
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-	// List of shader modules created (stored for cleanup)
+	// List of shader modules loaded by loadShader (references are released at cleanup)
 	std::vector<VkShaderModule> shaderModules;
+	// Shared, reference counted shader modules
+	vks::ShaderModuleCache shaderModuleCache;
 	// Pipeline cache object
-	VkPipelineCache pipelineCache;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	// Compiles pipelines against the pipeline cache on the job system
+	vks::PipelineCompiler *pipelineCompiler = nullptr;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
-	// Synchronization semaphores
-	struct {
+	// Synchronization primitives owned by a single frame in flight
+	struct FrameSync {
 		// Swap chain image presentation
 		VkSemaphore presentComplete;
 		// Command buffer submission and execution
 		VkSemaphore renderComplete;
-	} semaphores;
-	std::vector<VkFence> waitFences;
+		// Signaled once the GPU has finished executing the frame's submission
+		VkFence fence;
+	};
+	std::vector<FrameSync> frameSync;
+	// Index of the frame in flight that is currently being prepared (0 .. settings.framesInFlight - 1)
+	uint32_t currentFrame = 0;
+	// Fence of the frame in flight that last submitted work for each swap chain image
+	std::vector<VkFence> imageFences;
+	// Color image rendered to instead of a swap chain image in offscreen mode
+	struct OffscreenTarget {
+		VkImage image;
+		VkDeviceMemory mem;
+		VkImageView view;
+	};
+	// Swapchain-less rendering, one target per frame in flight that's read back through a persistently mapped buffer
+	struct {
+		VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+		std::vector<OffscreenTarget> targets;
+		vks::Buffer readback;
+		// Target rendered to by the most recent submission
+		uint32_t lastTarget = 0;
+		// Number of frames rendered by renderLoop() before exiting
+		uint32_t frameCount = 1;
+		// Image file (.png or .ppm) the result is written to, a "%d" in the name writes every frame
+		std::string outputFile;
+	} offscreen;
 public:
 	bool prepared = false;
 	bool resized = false;
@@ -182,6 +221,16 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Number of frames the CPU may prepare while the GPU is still busy with previous ones (1 - 3) */
+		uint32_t framesInFlight = 2;
+		/** @brief Render into offscreen images instead of a swap chain, no window system is required */
+		bool offscreen = false;
+		/** @brief File the pipeline cache is loaded from at startup and written to at exit (empty = don't persist the pipeline cache) */
+		std::string pipelineCacheFile = "pipelinecache.bin";
+		/** @brief Compile pipelines in the background and start rendering before all of them are ready (disabled for benchmarks and offscreen rendering) */
+		bool asyncPipelines = true;
+		/** @brief Number of jobs the command buffer of each image is recorded with by examples that support parallel recording (1 = record on the calling thread) */
+		uint32_t recordJobs = 1;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
@@ -201,6 +250,8 @@ public:
 	std::string title = "Vulkan Example";
 	std::string name = "vulkanExample";
 	uint32_t apiVersion = VK_API_VERSION_1_0;
+	/** @brief Uniform data available per frame through vulkanDevice->uniformAllocator */
+	VkDeviceSize uniformFrameSize = 1024 * 1024;
 
 	struct {
 		VkImage image;
@@ -359,6 +410,14 @@ public:
 	virtual void windowResized();
 	/** @brief (Virtual) Called when resources have been recreated that require a rebuild of the command buffers (e.g. frame buffer), to be implemented by the sample application */
 	virtual void createCmdBufs();
+	/** @brief (Virtual) Re-records the command buffer of a single image that is not in flight, the default implementation waits for the queue and calls createCmdBufs() */
+	virtual void recordCmdBuf(uint32_t imageIndex);
+	/** @brief Flags all command buffers as outdated, each one is re-recorded right before its image is rendered next */
+	void invalidateCmdBufs();
+	/** @brief (Virtual) Called by prepareFrame() once the uniform allocator has been reset for the acquired image and before its command buffer is re-recorded, used to write the frame's uniform data */
+	virtual void updateFrameUniforms(uint32_t imageIndex);
+	/** @brief (Virtual) Called when the uniform allocator's buffer has been recreated for a swap chain with more images, descriptors referring to it have to be written again before the command buffers are rebuilt */
+	virtual void uniformBufferRecreated();
 	/** @brief (Virtual) Setup default depth and stencil views */
 	virtual void setupDepthStencil();
 	/** @brief (Virtual) Setup default framebuffers for all requested swapchain images */
@@ -375,20 +434,27 @@ public:
 
 	/** @brief Loads a SPIR-V shader file for the given shader stage */
 	VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage);
+	/** @brief Releases a shader module returned by loadShader once no pipeline needs to be created from it anymore */
+	void releaseShader(VkShaderModule module);
 
 	/** @brief Entry point for the main render loop */
 	void renderLoop();
 
-	/** @brief Adds the drawing commands for the ImGui overlay to the given command buffer */
-	void drawUI(const VkCommandBuffer commandBuffer);
+	/** @brief Adds the drawing commands for the ImGui overlay to the command buffer of the given image */
+	void drawUI(const VkCommandBuffer commandBuffer, uint32_t imageIndex);
 
-	/** Prepare the next frame for workload submission by acquiring the next swap chain image */
-	void prepareFrame();
+	/** @brief Prepare the next frame for workload submission by waiting for its frame in flight and acquiring the next swap chain image, returns false if the frame has to be skipped */
+	bool prepareFrame();
 	/** @brief Presents the current image to the swap chain */
 	void submitFrame();
 	/** @brief (Virtual) Default image acquire + submission and command buffer submission function */
 	virtual void renderFrame();
 
+	/** @brief Copies the most recently rendered offscreen image into host memory and returns the tightly packed RGBA8 pixels */
+	const uint8_t* readOffscreenImage();
+	/** @brief Reads back the most recently rendered offscreen image and writes it to a .png or .ppm file */
+	bool saveOffscreenImage(const std::string &fileName);
+
 	/** @brief (Virtual) Called when the UI overlay is updating, can be used to add custom elements to the overlay */
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay);
 };
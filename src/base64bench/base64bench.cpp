@@ -0,0 +1,155 @@
+/*
+* Base64 decoding benchmark
+*
+* Compares tinygltf's base64 decoder with the implementations of vks::base64 on the buffer and image data URIs of glTF files
+*
+* Usage: base64bench [model.gltf ...], without arguments a random 16 MiB buffer is decoded
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Base64.h"
+#include "json.hpp"
+
+// Defined along with the tinygltf implementation in the base library, but only declared in its implementation section
+namespace tinygltf
+{
+	std::string base64_decode(std::string const &s);
+}
+
+namespace
+{
+	/** @brief Payload of a base64 data URI */
+	struct Payload
+	{
+		std::string name;
+		std::string text;
+	};
+
+	std::string encode(const std::vector<uint8_t> &data)
+	{
+		const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		std::string text;
+		text.reserve((data.size() + 2) / 3 * 4);
+		for (size_t i = 0; i < data.size(); i += 3) {
+			const size_t count = std::min<size_t>(3, data.size() - i);
+			uint32_t bits = data[i] << 16;
+			bits |= (count > 1) ? (data[i + 1] << 8) : 0;
+			bits |= (count > 2) ? data[i + 2] : 0;
+			for (size_t j = 0; j < 4; j++) {
+				text.push_back((j <= count) ? alphabet[(bits >> (18 - j * 6)) & 0x3F] : '=');
+			}
+		}
+		return text;
+	}
+
+	void addDataUri(const std::string &name, const std::string &uri, std::vector<Payload> &payloads)
+	{
+		const size_t comma = uri.find(',');
+		if ((uri.compare(0, 5, "data:") == 0) && (comma != std::string::npos) && (comma >= 7) && (uri.compare(comma - 7, 7, ";base64") == 0)) {
+			Payload payload;
+			payload.name = name;
+			payload.text = uri.substr(comma + 1);
+			payloads.push_back(payload);
+		}
+	}
+
+	bool readPayloads(const std::string &fileName, std::vector<Payload> &payloads)
+	{
+		std::ifstream file(fileName, std::ios::binary);
+		if (!file.is_open()) {
+			std::cerr << "Could not open " << fileName << "\n";
+			return false;
+		}
+		try {
+			const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			const nlohmann::json document = nlohmann::json::parse(text);
+			const char *arrays[] = { "buffers", "images" };
+			for (const char *array : arrays) {
+				if (!document.count(array)) {
+					continue;
+				}
+				for (size_t i = 0; i < document[array].size(); i++) {
+					const std::string uri = document[array][i].value("uri", std::string());
+					addDataUri(fileName + " " + array + "[" + std::to_string(i) + "]", uri, payloads);
+				}
+			}
+		}
+		catch (const std::exception &e) {
+			std::cerr << "Invalid glTF file " << fileName << ": " << e.what() << "\n";
+			return false;
+		}
+		return true;
+	}
+
+	/** @brief Runs the decoder until at least a quarter of a second has passed and returns the throughput of the encoded text in MB/s */
+	template<typename Decode>
+	double measure(const std::string &text, Decode decode)
+	{
+		typedef std::chrono::high_resolution_clock Clock;
+		const auto start = Clock::now();
+		double seconds = 0.0;
+		size_t iterations = 0;
+		do {
+			decode();
+			iterations++;
+			seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		} while (seconds < 0.25);
+		return static_cast<double>(text.size()) * iterations / seconds / 1000000.0;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<Payload> payloads;
+	for (int i = 1; i < argc; i++) {
+		if (!readPayloads(argv[i], payloads)) {
+			return 1;
+		}
+	}
+	if (argc < 2) {
+		std::vector<uint8_t> data(16 * 1024 * 1024);
+		std::mt19937 random(0);
+		std::generate(data.begin(), data.end(), [&random]() { return static_cast<uint8_t>(random()); });
+		Payload payload;
+		payload.name = "random 16 MiB";
+		payload.text = encode(data);
+		payloads.push_back(payload);
+	}
+
+	const vks::base64::Implementation implementations[] = { vks::base64::Implementation::Scalar, vks::base64::Implementation::SSSE3, vks::base64::Implementation::AVX2 };
+	int result = 0;
+	std::cout << std::fixed << std::setprecision(1);
+	for (const Payload &payload : payloads) {
+		std::cout << payload.name << " (" << payload.text.size() << " characters)\n";
+		std::string reference;
+		const double referenceThroughput = measure(payload.text, [&]() { reference = tinygltf::base64_decode(payload.text); });
+		std::cout << "  tinygltf: " << referenceThroughput << " MB/s\n";
+
+		std::vector<uint8_t> decoded(vks::base64::getDecodedSize(payload.text.data(), payload.text.size()));
+		for (vks::base64::Implementation implementation : implementations) {
+			if (!vks::base64::isSupported(implementation)) {
+				continue;
+			}
+			bool valid = true;
+			const double throughput = measure(payload.text, [&]() { valid = vks::base64::decode(payload.text.data(), payload.text.size(), decoded.data(), implementation); });
+			valid = valid && (decoded.size() == reference.size()) && std::equal(decoded.begin(), decoded.end(), reference.begin(), [](uint8_t a, char b) { return a == static_cast<uint8_t>(b); });
+			std::cout << "  " << vks::base64::getImplementationName(implementation) << ": " << throughput << " MB/s, " << throughput / referenceThroughput << "x";
+			std::cout << (valid ? "" : ", output differs from tinygltf") << "\n";
+			if (!valid) {
+				result = 1;
+			}
+		}
+	}
+	return result;
+}
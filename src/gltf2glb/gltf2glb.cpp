@@ -0,0 +1,37 @@
+/*
+* glTF to binary glTF converter
+*
+* Converts text glTF files with embedded or external buffers to .glb files that can be loaded in place
+*
+* Usage: gltf2glb model.gltf [model2.gltf ...], each file is written next to its source with the .glb extension
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <iostream>
+#include <string>
+
+#include "VulkanglTFBinary.h"
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " model.gltf [model2.gltf ...]" << "\n";
+		return 1;
+	}
+	int result = 0;
+	for (int i = 1; i < argc; i++) {
+		const std::string gltfFile = argv[i];
+		const size_t extension = gltfFile.find_last_of('.');
+		const std::string glbFile = ((extension == std::string::npos) ? gltfFile : gltfFile.substr(0, extension)) + ".glb";
+		std::string error;
+		if (vkglTF::convertGltfToGlb(gltfFile, glbFile, &error)) {
+			std::cout << gltfFile << " -> " << glbFile << "\n";
+		}
+		else {
+			std::cerr << "Error: " << error << "\n";
+			result = 1;
+		}
+	}
+	return result;
+}
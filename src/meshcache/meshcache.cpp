@@ -0,0 +1,134 @@
+/*
+* glTF mesh cache baker
+*
+* Writes the mesh caches loaded by vkglTF::Model with FileLoadingFlags::MeshCache, so the first start doesn't have to process the models
+*
+* Usage: meshcache [options] model.gltf [model2.gltf ...], each cache is written next to its model
+*
+* The options have to match the loading flags, scale and vertex layout passed to vkglTF::Model::loadFromFile:
+*   --pretransform      FileLoadingFlags::PreTransformVertices
+*   --premultiply       FileLoadingFlags::PreMultiplyVertexColors
+*   --flipy             FileLoadingFlags::FlipY
+*   --noimages          FileLoadingFlags::DontLoadImages
+*   --optimize          FileLoadingFlags::OptimizeMesh
+*   --meshlets          FileLoadingFlags::GenerateMeshlets
+*   --lods              FileLoadingFlags::GenerateLods
+*   --scale s           Scale
+*   --layout a,b,...    Vertex components (position, normal, uv, color, tangent, joint0, weight0), full vertex layout if omitted
+*   --deinterleaved     De-interleaved vertex layout
+*   --quantized         Quantized vertex layout
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "VulkanglTFModel.h"
+#include "VulkanglTFCache.h"
+
+namespace
+{
+	bool parseComponents(const std::string &list, std::vector<vkglTF::VertexComponent> &components)
+	{
+		const struct {
+			const char *name;
+			vkglTF::VertexComponent component;
+		} names[] = {
+			{ "position", vkglTF::VertexComponent::Position },
+			{ "normal", vkglTF::VertexComponent::Normal },
+			{ "uv", vkglTF::VertexComponent::UV },
+			{ "color", vkglTF::VertexComponent::Color },
+			{ "tangent", vkglTF::VertexComponent::Tangent },
+			{ "joint0", vkglTF::VertexComponent::Joint0 },
+			{ "weight0", vkglTF::VertexComponent::Weight0 },
+		};
+		std::stringstream stream(list);
+		std::string name;
+		while (std::getline(stream, name, ',')) {
+			bool found = false;
+			for (const auto &entry : names) {
+				if (name == entry.name) {
+					components.push_back(entry.component);
+					found = true;
+				}
+			}
+			if (!found) {
+				std::cerr << "Unknown vertex component " << name << "\n";
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None;
+	float scale = 1.0f;
+	vkglTF::VertexLayout vertexLayout;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++) {
+		const std::string argument = argv[i];
+		if (argument == "--pretransform") {
+			fileLoadingFlags |= vkglTF::FileLoadingFlags::PreTransformVertices;
+		}
+		else if (argument == "--premultiply") {
+			fileLoadingFlags |= vkglTF::FileLoadingFlags::PreMultiplyVertexColors;
+		}
+		else if (argument == "--flipy") {
+			fileLoadingFlags |= vkglTF::FileLoadingFlags::FlipY;
+		}
+		else if (argument == "--noimages") {
+			fileLoadingFlags |= vkglTF::FileLoadingFlags::DontLoadImages;
+		}
+		else if (argument == "--optimize") {
+			fileLoadingFlags |= vkglTF::FileLoadingFlags::OptimizeMesh;
+		}
+		else if (argument == "--meshlets") {
+			fileLoadingFlags |= vkglTF::FileLoadingFlags::GenerateMeshlets;
+		}
+		else if (argument == "--lods") {
+			fileLoadingFlags |= vkglTF::FileLoadingFlags::GenerateLods;
+		}
+		else if ((argument == "--scale") && (i + 1 < argc)) {
+			scale = std::stof(argv[++i]);
+		}
+		else if ((argument == "--layout") && (i + 1 < argc)) {
+			if (!parseComponents(argv[++i], vertexLayout.components)) {
+				return 1;
+			}
+		}
+		else if (argument == "--deinterleaved") {
+			vertexLayout.deinterleaved = true;
+		}
+		else if (argument == "--quantized") {
+			vertexLayout.quantized = true;
+		}
+		else if (argument.compare(0, 2, "--") == 0) {
+			std::cerr << "Unknown option " << argument << "\n";
+			return 1;
+		}
+		else {
+			files.push_back(argument);
+		}
+	}
+	if (files.empty()) {
+		std::cerr << "Usage: " << argv[0] << " [--pretransform] [--premultiply] [--flipy] [--noimages] [--optimize] [--meshlets] [--lods] [--scale s] [--layout position,normal,...] [--deinterleaved] [--quantized] model.gltf [model2.gltf ...]" << "\n";
+		return 1;
+	}
+	int result = 0;
+	for (const std::string &file : files) {
+		std::string error;
+		if (vkglTF::Model::bakeMeshCache(file, fileLoadingFlags, scale, vertexLayout, &error)) {
+			std::cout << file << " -> " << vkglTF::getMeshCacheFileName(file) << "\n";
+		}
+		else {
+			std::cerr << "Error: " << file << ": " << error << "\n";
+			result = 1;
+		}
+	}
+	return result;
+}
@@ -1,5 +1,6 @@
 #include "vulkancore.h"
 #include "VulkanglTFModel.h"
+#include <numeric>
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -30,13 +31,22 @@ class VulkanExample : public VulkanExampleBase
 public:
 	struct Meshes {
 		std::vector<vkglTF::Model> artefacts;
+		//models are loaded in the background, each one is drawn once it has been parsed and uploaded
+		std::vector<bool> ready;
 		int32_t artefactID = 0;
 	} meshes;
-
-	struct {
-		vks::Buffer artefact;
-		vks::Buffer props;
-	} uniBufs;
+	//the shaders only read position and normal, with quantized normals a vertex takes 16 instead of 96 bytes
+	vkglTF::VertexLayout vertexLayout = vkglTF::VertexLayout({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal }, false, true);
+
+	//uniform data is written to the uniform allocator's slice of every swap chain image, so the CPU never
+	//overwrites values that a command buffer of another frame in flight still reads
+	struct UniformOffsets {
+		uint32_t artefact = 0;
+		uint32_t props = 0;
+	};
+	//dynamic offsets of the uniform data per swap chain image, recorded into its command buffer
+	std::vector<UniformOffsets> uniOffsets;
+	VkDescriptorSet dSet;
 
 	struct UBMs {
 		glm::mat4 mapping;
@@ -50,9 +60,12 @@ public:
 	} ub_Props;
 
 	VkPipelineLayout pl_Layout;
-	VkPipeline pl;
+	//compiled in the background, the grid is left out of the command buffers until the pipeline is ready
+	vks::AsyncPipelineHandle plAsync;
+	VkPipeline pl = VK_NULL_HANDLE;
+	//shader modules of the pipeline, released once it has been compiled
+	std::vector<VkShaderModule> plShaders;
 	VkDescriptorSetLayout dSet_Layout;
-	VkDescriptorSet dSet;
 
 	//default materials to select from
 	std::vector<Material> materials;
@@ -61,6 +74,25 @@ public:
 	std::vector<std::string> material_Title;
 	std::vector<std::string> mesh_Title;
 
+	//distant cells are drawn with the simplified levels of detail generated by the loader
+	bool lodEnabled = true;
+	//levels selected for every cell and primitive at the last view change, the command buffers only change along with them
+	std::vector<uint32_t> selectedLods;
+
+	//multi-threaded recording: the grid is split into settings.recordJobs ranges per swap chain image, each recorded as a job
+	//on the shared job system into a secondary command buffer taken from the pool of the executing thread
+	struct RecordingPool {
+		VkCommandPool cmdPool;
+		std::vector<VkCommandBuffer> cmdBuffers;
+		uint32_t used = 0;
+	};
+	//indexed by swap chain image and job system thread index
+	std::vector<std::vector<RecordingPool>> recordingPools;
+	//secondary command buffers executed by the primary command buffer of each swap chain image
+	std::vector<std::vector<VkCommandBuffer>> secondaryCmdBufs;
+	//secondary command buffers for the UI overlay, recorded on the main thread
+	std::vector<VkCommandBuffer> uiCmdBuffers;
+
 	VulkanExample() : VulkanExampleBase()
 	{
 		title = "Physically Based Rendering";
@@ -92,17 +124,116 @@ public:
 
 	~VulkanExample()
 	{
-		vkDestroyPipeline(device, pl, nullptr);
+		destroyRecordingPools();
+
+		plAsync->destroy();
 
 		vkDestroyPipelineLayout(device, pl_Layout, nullptr);
 		vkDestroyDescriptorSetLayout(device, dSet_Layout, nullptr);
+	}
 
-		uniBufs.artefact.destroy();
-		uniBufs.props.destroy();
+	//records the draws for the grid cells [first, first + count) into the given command buffer
+	void recordArtefacts(VkCommandBuffer cmdBuf, uint32_t image, uint32_t first, uint32_t count)
+	{
+		VkViewport vp = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuf, 0, 1, &vp);
+
+		VkRect2D scis = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(cmdBuf, 0, 1, &scis);
+
+		if ((pl == VK_NULL_HANDLE) || !meshes.ready[meshes.artefactID]) {
+			return;
+		}
+
+		//objects
+		vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pl);
+		const uint32_t dynamicOffsets[2] = { uniOffsets[image].artefact, uniOffsets[image].props };
+		vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pl_Layout, 0, 1, &dSet, 2, dynamicOffsets);
+
+		Material material = materials[material_ID];
+
+		//draw materials
+		for (uint32_t cell = first; cell < first + count; cell++) {
+			uint32_t x = cell % FIELD;
+			uint32_t y = cell / FIELD;
+			glm::vec3 position = cellPosition(cell);
+			vkCmdPushConstants(cmdBuf, pl_Layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec3), &position);
+			material.props.metallic = glm::clamp((float)x / (float)(FIELD - 1), 0.1f, 1.0f);
+			material.props.roughness = glm::clamp((float)y / (float)(FIELD - 1), 0.05f, 1.0f);
+			vkCmdPushConstants(cmdBuf, pl_Layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::vec3), sizeof(Material::VulkanPC), &material);
+			if (lodEnabled) {
+				meshes.artefacts[meshes.artefactID].draw(cmdBuf, cellLodView(position));
+			}
+			else {
+				meshes.artefacts[meshes.artefactID].draw(cmdBuf);
+			}
+		}
+	}
+
+	glm::vec3 cellPosition(uint32_t cell)
+	{
+		uint32_t x = cell % FIELD;
+		uint32_t y = cell / FIELD;
+		return glm::vec3(float(x - (FIELD / 2.0f)) * 2.5f, 0.0f, float(y - (FIELD / 2.0f)) * 2.5f);
+	}
+
+	//the vertex shader rotates the mesh and moves it into its cell, so the camera is moved into the mesh's space instead
+	vkglTF::LodView cellLodView(const glm::vec3& position)
+	{
+		vkglTF::LodView lodView;
+		lodView.cameraPosition = glm::vec3(glm::inverse(ub_Ms.mesh) * glm::vec4(ub_Ms.camera - position, 1.0f));
+		//the projection's y scale is 1 / tan(fovy / 2), negated if the camera flips y
+		lodView.projectionScale = (float)height * 0.5f * fabs(camera.matrices.perspective[1][1]);
+		return lodView;
+	}
+
+	//re-records the command buffers if the level of detail of any cell has changed since the last call
+	void updateSelectedLods()
+	{
+		std::vector<uint32_t> lods;
+		if (lodEnabled && meshes.ready[meshes.artefactID]) {
+			vkglTF::Model& model = meshes.artefacts[meshes.artefactID];
+			for (uint32_t cell = 0; cell < FIELD * FIELD; cell++) {
+				const vkglTF::LodView lodView = cellLodView(cellPosition(cell));
+				for (auto node : model.linearNodes) {
+					if (node->mesh) {
+						for (auto primitive : node->mesh->primitives) {
+							lods.push_back(model.selectLod(node, primitive, lodView));
+						}
+					}
+				}
+			}
+		}
+		if (lods != selectedLods) {
+			selectedLods.swap(lods);
+			invalidateCmdBufs();
+		}
 	}
 
 	void createCmdBufs()
 	{
+		std::vector<uint32_t> images(drawCmdBuffers.size());
+		std::iota(images.begin(), images.end(), 0);
+		recordCmdBufs(images);
+	}
+
+	//only called for the image about to be submitted, once its previous submission has finished
+	virtual void recordCmdBuf(uint32_t imageIndex)
+	{
+		recordCmdBufs({ imageIndex });
+	}
+
+	//records the command buffers of the given swap chain images, none of which may be in flight
+	void recordCmdBufs(const std::vector<uint32_t>& images)
+	{
+		//uniform offsets are kept per swap chain image
+		uniOffsets.resize(drawCmdBuffers.size());
+
+		if (settings.recordJobs > 1) {
+			recordCmdBufsMultiThreaded(images);
+			return;
+		}
+
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkClearValue cl_Vals[2];
@@ -117,8 +248,8 @@ public:
 		rPB_Info.renderArea.extent.height = height;
 		rPB_Info.clearValueCount = 2;
 		rPB_Info.pClearValues = cl_Vals;
-		 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+
+		for (uint32_t i : images)
 		{
 			//set target frame buffer
 			rPB_Info.framebuffer = frameBuffers[i];
@@ -127,52 +258,195 @@ public:
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &rPB_Info, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkViewport vp = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &vp);
+			recordArtefacts(drawCmdBuffers[i], i, 0, FIELD * FIELD);
 
-			VkRect2D scis = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scis);
+			drawUI(drawCmdBuffers[i], i);
 
-			//objects
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pl);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pl_Layout, 0, 1, &dSet, 0, NULL);
+			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
-			Material material = materials[material_ID];
+			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+		}
+	}
 
-			//draw materials
-			for (uint32_t y = 0; y < FIELD; y++) {
-				for (uint32_t x = 0; x < FIELD; x++) {
-					glm::vec3 position = glm::vec3(float(x - (FIELD / 2.0f)) * 2.5f, 0.0f, float(y - (FIELD / 2.0f)) * 2.5f);
-					vkCmdPushConstants(drawCmdBuffers[i], pl_Layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec3), &position);
-					material.props.metallic = glm::clamp((float)x / (float)(FIELD - 1), 0.1f, 1.0f);
-					material.props.roughness = glm::clamp((float)y / (float)(FIELD - 1), 0.05f, 1.0f);
-					vkCmdPushConstants(drawCmdBuffers[i], pl_Layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::vec3), sizeof(Material::VulkanPC), &material);
-					meshes.artefacts[meshes.artefactID].draw(drawCmdBuffers[i]);
-				}
+	//(re)creates the per-thread command pools if the number of swap chain images has changed
+	void prepareRecordingPools()
+	{
+		const uint32_t imageCount = static_cast<uint32_t>(drawCmdBuffers.size());
+		if (recordingPools.size() == imageCount) {
+			return;
+		}
+		destroyRecordingPools();
+		//thread index 0 is used by the main thread when it helps out while waiting for the recording jobs
+		const uint32_t threadCount = vks::JobSystem::instance().getWorkerCount() + 1;
+		recordingPools.resize(imageCount);
+		for (auto& imagePools : recordingPools) {
+			imagePools.resize(threadCount);
+			for (auto& pool : imagePools) {
+				pool.cmdPool = vulkanDevice->createCommandPool(vulkanDevice->queueFamilyIndices.graphics, 0);
 			}
+		}
+		secondaryCmdBufs.resize(imageCount);
+		uiCmdBuffers.resize(imageCount);
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, imageCount);
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, uiCmdBuffers.data()));
+	}
 
-			drawUI(drawCmdBuffers[i]);
+	void destroyRecordingPools()
+	{
+		for (auto& imagePools : recordingPools) {
+			for (auto& pool : imagePools) {
+				vkDestroyCommandPool(device, pool.cmdPool, nullptr);
+			}
+		}
+		recordingPools.clear();
+		if (!uiCmdBuffers.empty()) {
+			vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(uiCmdBuffers.size()), uiCmdBuffers.data());
+			uiCmdBuffers.clear();
+		}
+	}
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+	//returns a secondary command buffer from the pool owned by the calling thread
+	VkCommandBuffer getSecondaryCmdBuf(uint32_t image)
+	{
+		RecordingPool& pool = recordingPools[image][vks::JobSystem::threadIndex()];
+		if (pool.used == pool.cmdBuffers.size()) {
+			VkCommandBuffer cmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY, pool.cmdPool);
+			pool.cmdBuffers.push_back(cmdBuffer);
+		}
+		return pool.cmdBuffers[pool.used++];
+	}
 
+	VkCommandBufferBeginInfo secondaryBeginInfo(VkCommandBufferInheritanceInfo& inheritanceInfo, uint32_t image)
+	{
+		inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.framebuffer = frameBuffers[image];
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		cmdBufInfo.pInheritanceInfo = &inheritanceInfo;
+		return cmdBufInfo;
+	}
+
+	void recordCmdBufsMultiThreaded(const std::vector<uint32_t>& images)
+	{
+		prepareRecordingPools();
+
+		const uint32_t imageCount = static_cast<uint32_t>(images.size());
+		const uint32_t drawCount = FIELD * FIELD;
+		const uint32_t rangeCount = std::min(settings.recordJobs, drawCount);
+		const uint32_t drawsPerRange = (drawCount + rangeCount - 1) / rangeCount;
+
+		//the command buffers of these images are not in flight, so their pools can be recycled
+		for (uint32_t i : images) {
+			for (auto& pool : recordingPools[i]) {
+				VK_CHECK_RESULT(vkResetCommandPool(device, pool.cmdPool, 0));
+				pool.used = 0;
+			}
+			secondaryCmdBufs[i].assign(rangeCount + 1, VK_NULL_HANDLE);
+		}
+
+		vks::JobSystem& jobSystem = vks::JobSystem::instance();
+		vks::JobHandle recording = jobSystem.parallelFor(imageCount * rangeCount, 1, [=](uint32_t firstJob, uint32_t lastJob) {
+			for (uint32_t job = firstJob; job < lastJob; job++) {
+				const uint32_t image = images[job / rangeCount];
+				const uint32_t range = job % rangeCount;
+				const uint32_t first = range * drawsPerRange;
+				const uint32_t count = (first < drawCount) ? std::min(drawsPerRange, drawCount - first) : 0;
+
+				VkCommandBuffer cmdBuffer = getSecondaryCmdBuf(image);
+				VkCommandBufferInheritanceInfo inheritanceInfo;
+				VkCommandBufferBeginInfo cmdBufInfo = secondaryBeginInfo(inheritanceInfo, image);
+				VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+				recordArtefacts(cmdBuffer, image, first, count);
+				VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+				secondaryCmdBufs[image][range] = cmdBuffer;
+			}
+		});
+
+		//the UI overlay is recorded on the main thread while the jobs are running
+		for (uint32_t i : images) {
+			VkCommandBufferInheritanceInfo inheritanceInfo;
+			VkCommandBufferBeginInfo cmdBufInfo = secondaryBeginInfo(inheritanceInfo, i);
+			VK_CHECK_RESULT(vkBeginCommandBuffer(uiCmdBuffers[i], &cmdBufInfo));
+			drawUI(uiCmdBuffers[i], i);
+			VK_CHECK_RESULT(vkEndCommandBuffer(uiCmdBuffers[i]));
+			secondaryCmdBufs[i][rangeCount] = uiCmdBuffers[i];
+		}
+
+		jobSystem.wait(recording);
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		VkClearValue cl_Vals[2];
+		cl_Vals[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+		cl_Vals[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo rPB_Info = vks::initializers::renderPassBeginInfo();
+		rPB_Info.renderPass = renderPass;
+		rPB_Info.renderArea.extent.width = width;
+		rPB_Info.renderArea.extent.height = height;
+		rPB_Info.clearValueCount = 2;
+		rPB_Info.pClearValues = cl_Vals;
+
+		for (uint32_t i : images) {
+			rPB_Info.framebuffer = frameBuffers[i];
+
+			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			//the render pass contents are provided by the secondary command buffers only
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &rPB_Info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			vkCmdExecuteCommands(drawCmdBuffers[i], static_cast<uint32_t>(secondaryCmdBufs[i].size()), secondaryCmdBufs[i].data());
+			vkCmdEndRenderPass(drawCmdBuffers[i]);
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
-	
+
 	void loadAssets()
 	{
 		std::vector<std::string> files = { "sphere.gltf", "teapot.gltf", "suzanne.gltf", "deer.gltf" };
+		//the vector must not be resized while the models are loading, as the loading jobs reference them
 		meshes.artefacts.resize(files.size());
-		for (size_t i = 0; i < files.size(); i++) {			
-			meshes.artefacts[i].loadFromFile(getAssetPath() + "models/" + files[i], vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY);
+		meshes.ready.assign(files.size(), false);
+		//measured or captured frames must not miss any draws, so the models are finished before the first frame in these modes
+		const bool streamed = !benchmark.active && !settings.offscreen;
+		uint32_t loadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::OptimizeMesh | vkglTF::FileLoadingFlags::GenerateLods | vkglTF::FileLoadingFlags::MeshCache;
+		if (streamed) {
+			loadingFlags |= vkglTF::FileLoadingFlags::AsyncUpload;
+		}
+		//jobs are scheduled in list order, beginning with the initially selected sphere
+		std::vector<vks::JobHandle> loadJobs;
+		for (size_t i = 0; i < files.size(); i++) {
+			loadJobs.push_back(meshes.artefacts[i].loadFromFileAsync(getAssetPath() + "models/" + files[i], vulkanDevice, queue, loadingFlags, 1.0f, vertexLayout));
+		}
+		if (!streamed) {
+			vks::JobSystem::instance().wait(loadJobs);
+			for (size_t i = 0; i < files.size(); i++) {
+				//uploads go through the staging ring and are ready right away
+				meshes.ready[i] = meshes.artefacts[i].pollLoad();
+				assert(meshes.ready[i]);
+			}
+		}
+	}
+
+	//finishes the models whose background loading is done, the grid is re-recorded once the selected one can be drawn
+	void pollAssets()
+	{
+		for (size_t i = 0; i < meshes.artefacts.size(); i++) {
+			if (!meshes.ready[i] && meshes.artefacts[i].pollLoad()) {
+				meshes.ready[i] = true;
+				if (i == static_cast<size_t>(meshes.artefactID)) {
+					updateSelectedLods();
+					invalidateCmdBufs();
+				}
+			}
 		}
 	}
 
 	void setupDescriptorSetLayout()
 	{
 		std::vector<VkDescriptorSetLayoutBinding> dsl_Binding = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
 		};
 
 		VkDescriptorSetLayoutCreateInfo dsl_Info =
@@ -198,11 +472,11 @@ public:
 	{
 		//Descriptor Pool
 		std::vector<VkDescriptorPoolSize> pool_Size = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2),
 		};
 
 		VkDescriptorPoolCreateInfo dP_Info =
-			vks::initializers::descriptorPoolCreateInfo(pool_Size, 2);
+			vks::initializers::descriptorPoolCreateInfo(pool_Size, 1);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &dP_Info, nullptr, &descriptorPool));
 
@@ -211,16 +485,34 @@ public:
 		VkDescriptorSetAllocateInfo dSA_Info =
 			vks::initializers::descriptorSetAllocateInfo(descriptorPool, &dSet_Layout, 1);
 
-		//3D object descriptor set
+		//3D object descriptor set, the uniform data of each image is selected with dynamic offsets
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &dSA_Info, &dSet));
+		updateDescriptorSets();
+	}
 
+	//points the descriptors at the uniform allocator's current buffer
+	void updateDescriptorSets()
+	{
+		VkDescriptorBufferInfo artefact_Desc = vulkanDevice->uniformAllocator.getDescriptor(sizeof(ub_Ms));
+		VkDescriptorBufferInfo props_Desc = vulkanDevice->uniformAllocator.getDescriptor(sizeof(ub_Props));
 		std::vector<VkWriteDescriptorSet> write_DSet = {
-			vks::initializers::writeDescriptorSet(dSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniBufs.artefact.descriptor),
-			vks::initializers::writeDescriptorSet(dSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &uniBufs.props.descriptor),
+			vks::initializers::writeDescriptorSet(dSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &artefact_Desc),
+			vks::initializers::writeDescriptorSet(dSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &props_Desc),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(write_DSet.size()), write_DSet.data(), 0, NULL);
 	}
 
+	//the swap chain got more images, so the uniform allocator's buffer has been replaced by a larger one
+	virtual void uniformBufferRecreated()
+	{
+		updateDescriptorSets();
+		//models still loading write their descriptor once they are finished
+		for (auto& model : meshes.artefacts) {
+			model.updateUniformDescriptor();
+		}
+		uniOffsets.resize(drawCmdBuffers.size());
+	}
+
 	void preparePipelines()
 	{
 		VkPipelineInputAssemblyStateCreateInfo iA_State =  vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
@@ -244,7 +536,7 @@ public:
 		plC_Info.pDynamicState = &dynamicState;
 		plC_Info.stageCount = static_cast<uint32_t>(shaderStages.size());
 		plC_Info.pStages = shaderStages.data();
-		plC_Info.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal });
+		plC_Info.pVertexInputState = vertexLayout.getPipelineVertexInputState();
 
 		//PBR pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "pbrbasic/pbr.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
@@ -252,34 +544,44 @@ public:
 		//Enable depth test and write
 		depSten_State.depthWriteEnable = VK_TRUE;
 		depSten_State.depthTestEnable = VK_TRUE;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &plC_Info, nullptr, &pl));
+		plAsync = pipelineCompiler->compile(plC_Info);
+		plShaders = { shaderStages[0].module, shaderStages[1].module };
+		if (!settings.asyncPipelines) {
+			pl = plAsync->wait();
+			releasePipelineShaders();
+		}
 	}
 
-	//Prepare and initialize uniform buffer containing shader uniforms
-	void prepareUniformBuffers()
+	void releasePipelineShaders()
 	{
-		//Object vertex shader uniform buffer
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniBufs.artefact,
-			sizeof(ub_Ms)));
-
-		//Shared parameter uniform buffer
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniBufs.props,
-			sizeof(ub_Props)));
-
-		//Map persistent
-		VK_CHECK_RESULT(uniBufs.artefact.map());
-		VK_CHECK_RESULT(uniBufs.props.map());
+		for (auto module : plShaders) {
+			releaseShader(module);
+		}
+		plShaders.clear();
+	}
 
+	//Initialize the shader uniforms, these are written to the device's uniform allocator every frame
+	void prepareUniformBuffers()
+	{
+		uniOffsets.resize(drawCmdBuffers.size());
 		updateUniformBuffers();
 		updateLights();
 	}
 
+	//the previous submission for the acquired image has finished, so its slice of the uniform allocator can be written
+	virtual void updateFrameUniforms(uint32_t imageIndex)
+	{
+		UniformOffsets offsets;
+		offsets.artefact = vulkanDevice->uniformAllocator.push(ub_Ms);
+		offsets.props = vulkanDevice->uniformAllocator.push(ub_Props);
+		//the offsets are recorded into the command buffer, so it has to be re-recorded if they moved
+		if ((offsets.artefact != uniOffsets[imageIndex].artefact) || (offsets.props != uniOffsets[imageIndex].props)) {
+			uniOffsets[imageIndex] = offsets;
+			drawCmdBuffersDirty[imageIndex] = true;
+		}
+	}
+
+	//uniform values are only stored on the host here, updateFrameUniforms() copies them into the slice of the acquired image
 	void updateUniformBuffers()
 	{
 		//3D object
@@ -287,7 +589,6 @@ public:
 		ub_Ms.view = camera.matrices.view;
 		ub_Ms.mesh = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f + (meshes.artefactID == 1 ? 45.0f : 0.0f)), glm::vec3(0.0f, 1.0f, 0.0f));
 		ub_Ms.camera = camera.position * -1.0f;
-		memcpy(uniBufs.artefact.mapped, &ub_Ms, sizeof(ub_Ms));
 	}
 
 	void updateLights()
@@ -306,17 +607,16 @@ public:
 			ub_Props.lightSource[0].z = cos(glm::radians(timer * 360.0f)) * 20.0f;
 			ub_Props.lightSource[1].y = sin(glm::radians(timer * 360.0f)) * 20.0f;
 		}
-
-		memcpy(uniBufs.props.mapped, &ub_Props, sizeof(ub_Props));
 	}
 
 	void draw()
 	{
-		VulkanExampleBase::prepareFrame();
+		if (!VulkanExampleBase::prepareFrame())
+			return;
 
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, frameSync[currentFrame].fence));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -337,6 +637,13 @@ public:
 	{
 		if (!prepared)
 			return;
+		//pick up the pipeline once its background compilation has finished
+		if ((pl == VK_NULL_HANDLE) && plAsync->ready()) {
+			pl = plAsync->pipeline;
+			releasePipelineShaders();
+			invalidateCmdBufs();
+		}
+		pollAssets();
 		draw();
 		if (!paused)
 			updateLights();
@@ -345,17 +652,20 @@ public:
 	virtual void viewChanged()
 	{
 		updateUniformBuffers();
+		updateSelectedLods();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Setup")) {
-			if (overlay->comboBox("Selected Material", &material_ID, material_Title)) {
-				createCmdBufs();
-			}
+			//changing a selection flags the overlay as updated, which makes the base class re-record each command buffer before its next use
+			overlay->comboBox("Selected Material", &material_ID, material_Title);
 			if (overlay->comboBox("Selected Mesh", &meshes.artefactID, mesh_Title)) {
 				updateUniformBuffers();
-				createCmdBufs();
+				updateSelectedLods();
+			}
+			if (overlay->checkBox("Levels of detail", &lodEnabled)) {
+				updateSelectedLods();
 			}
 		}
 	}